@@ -0,0 +1,47 @@
+#if !defined(EXPRPARSER_BENCHMARK_HEADER)
+#define EXPRPARSER_BENCHMARK_HEADER
+
+#include "functions.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "tokenizer.h"
+
+#include <chrono>           // std::chrono::steady_clock
+#include <cstddef>          // std::size_t
+#include <utility>          // std::move
+
+namespace benchmark {
+    inline expr::parser_result parse(
+        const char *text,
+        const expr::function_table& functions
+    ) {
+        auto tokens = expr::tokenize(text);
+        if (!tokens)
+            return std::move(tokens.error());
+        auto parsed = expr::parse(std::move(*tokens));
+        if (!parsed)
+            return std::move(parsed.error());
+        return expr::optimize(*parsed, functions);
+    }
+
+    // Calls the function the given number of times, and gives the number of
+    // calls per second.
+    template <typename Function>
+    double measure(std::size_t count, Function&& function) {
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < count; ++i)
+            function(i);
+        const auto elapsed = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start
+        );
+        return double(count) / elapsed.count();
+    }
+
+    // Keeps the compiler from dropping a result nobody reads.
+    template <typename T>
+    void keep(const T& value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+}
+
+#endif
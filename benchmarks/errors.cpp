@@ -0,0 +1,56 @@
+// Evaluates expressions that fail for every row, as validation workloads
+// mostly do, with the tree evaluator and the compiled interpreter, and prints
+// the throughput of each. Takes the number of evaluations per expression
+// (1000000 by default).
+
+#include "benchmark.h"
+#include "compiler.h"
+#include "evaluator.h"
+#include "interpreter.h"
+
+#include <cstddef>          // std::size_t
+#include <cstdio>           // std::printf
+#include <cstdlib>          // std::strtoul, EXIT_SUCCESS, EXIT_FAILURE
+#include <iostream>         // std::cerr
+
+// An undefined variable deep in the tree, a division by zero, a wrong
+// argument type and mismatched units, each wrapped by the enclosing nodes.
+static constexpr const char *expressions[] = {
+    "((x + 1) * 2 - sensor_temperature_reading_inlet_b) / 3",
+    "(x + 1) / (x - x) + 2",
+    "sin(x) * 2 + 1",
+    "(x m + x) * 2",
+};
+
+int main(int argc, char **argv) {
+    const auto count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    const auto& functions = expr::functions();
+    std::printf("%-58s %14s %14s\n", "expression", "tree/s", "compiled/s");
+    for (const auto *text : expressions) {
+        auto parsed = benchmark::parse(text, functions);
+        if (!parsed) {
+            std::cerr << "Failed to parse: " << parsed.error().description << '\n';
+            return EXIT_FAILURE;
+        }
+
+        auto symbols = expr::symbol_table{{"x", expr::make_scalar(2)}};
+        const auto tree = benchmark::measure(count, [&](std::size_t) {
+            benchmark::keep(expr::evaluate(*parsed, symbols, functions));
+        });
+
+        auto compiled = expr::compile(*parsed, functions);
+        double interpreted = 0;
+        if (compiled) {
+            auto context = expr::make_context(*compiled);
+            expr::bind(context, *compiled, "x", expr::make_scalar(2));
+            interpreted = benchmark::measure(count, [&](std::size_t) {
+                benchmark::keep(expr::evaluate(*compiled, context));
+            });
+        }
+
+        std::printf("%-58s %14.0f %14.0f\n", text, tree, interpreted);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+// Evaluates one compiled expression from a growing number of threads, each
+// with its own evaluation context, and prints the throughput and the speedup
+// over a single thread. Takes the largest number of threads (the number of
+// hardware threads by default) and the number of evaluations in total
+// (4000000 by default), which are split evenly between the threads.
+
+#include "benchmark.h"
+#include "compiler.h"
+#include "context.h"
+#include "interpreter.h"
+
+#include <algorithm>        // std::max
+#include <chrono>           // std::chrono::steady_clock
+#include <cstddef>          // std::size_t
+#include <cstdio>           // std::printf
+#include <cstdlib>          // std::strtoul, EXIT_SUCCESS, EXIT_FAILURE
+#include <iostream>         // std::cerr
+#include <thread>           // std::thread
+#include <vector>           // std::vector
+
+static constexpr const char *expression =
+    "x ^ 2 + sin(y rad) * cos(y rad) - ln(z) + abs(x - y) * round(z)";
+
+int main(int argc, char **argv) {
+    const auto hardware = std::max(1u, std::thread::hardware_concurrency());
+    const auto max_threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : hardware;
+    const auto total = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4000000;
+
+    const auto& functions = expr::functions();
+    auto parsed = benchmark::parse(expression, functions);
+    auto compiled = parsed ? expr::compile(*parsed, functions)
+                           : expr::compiler_result(parsed.error());
+    if (!compiled) {
+        std::cerr << "Failed to compile: " << compiled.error().description << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%8s %16s %8s\n", "threads", "evaluations/s", "speedup");
+    double single = 0;
+    for (std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+        const auto share = total / threads;
+        const auto start = std::chrono::steady_clock::now();
+        auto workers = std::vector<std::thread>{};
+        for (std::size_t thread = 0; thread < threads; ++thread) {
+            workers.emplace_back([&, thread] {
+                auto context = expr::make_context(*compiled);
+                for (std::size_t i = 0; i < share; ++i) {
+                    const auto value = double((thread + i) % 1024) / 16.0 + 1.0;
+                    expr::bind(context, *compiled, "x", expr::make_scalar(value));
+                    expr::bind(context, *compiled, "y", expr::make_scalar(value + 1));
+                    expr::bind(context, *compiled, "z", expr::make_scalar(value + 2));
+                    benchmark::keep(expr::evaluate(*compiled, context));
+                }
+            });
+        }
+        for (auto& worker : workers)
+            worker.join();
+
+        const auto elapsed = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start
+        );
+        const auto throughput = double(share * threads) / elapsed.count();
+        if (threads == 1)
+            single = throughput;
+        std::printf("%8zu %16.0f %7.2fx\n", threads, throughput, throughput / single);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+// Evaluates the same expression with the tree evaluator in every value type it
+// is instantiated for, and prints the throughput of each. Takes the number of
+// evaluations per type (1000000 by default).
+
+#include "benchmark.h"
+#include "evaluator.h"
+
+#include <cstddef>          // std::size_t
+#include <cstdio>           // std::printf
+#include <cstdlib>          // std::strtoul, EXIT_SUCCESS, EXIT_FAILURE
+#include <iostream>         // std::cerr
+
+static constexpr const char *expression =
+    "(x m + 2 m) * (y m - 1 m) / (x m * 1 m) + sin(y rad) * 3 - ln(x) ^ 2"
+    " + abs(y - x)";
+
+template <typename T>
+static bool run(
+    const char *name,
+    const expr::node_ptr& tree,
+    const expr::function_table& functions,
+    std::size_t count
+) {
+    auto symbols = expr::basic_symbol_table<T>{};
+    auto result = expr::basic_evaluator_result<T>(expr::basic_quantity<T>{});
+    const auto throughput = benchmark::measure(count, [&](std::size_t i) {
+        const auto x = T(1) + T(i % 1024) / T(64);
+        symbols.insert_or_assign("x", expr::make_scalar<T>(x));
+        symbols.insert_or_assign("y", expr::make_scalar<T>(x + T(1)));
+        result = expr::evaluate(tree, symbols, functions);
+        benchmark::keep(result);
+    });
+
+    if (!result) {
+        std::cerr << "Failed to evaluate: " << result.error().description << '\n';
+        return false;
+    }
+
+    std::printf("%-12s %14.0f\n", name, throughput);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const auto count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    const auto& functions = expr::functions();
+    auto parsed = benchmark::parse(expression, functions);
+    if (!parsed) {
+        std::cerr << "Failed to parse: " << parsed.error().description << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%-12s %14s\n", "type", "evaluations/s");
+    const bool succeeded = run<float>("float", *parsed, functions, count)
+                        && run<double>("double", *parsed, functions, count)
+                        && run<long double>("long double", *parsed, functions, count);
+    return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
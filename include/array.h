@@ -0,0 +1,53 @@
+#if !defined(EXPRPARSER_ARRAY_HEADER)
+#define EXPRPARSER_ARRAY_HEADER
+
+#include "column.h"
+#include "evaluator.h"
+#include "functions.h"
+#include "node.h"
+#include "quantity.h"
+#include "result.h"
+
+#include <span>             // std::span
+#include <string>           // std::string
+#include <string_view>      // std::string_view
+#include <unordered_map>    // std::unordered_map
+
+namespace expr {
+    // An array bound from memory of the caller, which is read in place, and
+    // has to outlive the evaluation.
+    struct array_view {
+        measurement_unit unit;
+        std::span<const double> values;
+    };
+
+    using array_table = std::unordered_map<std::string, array_view>;
+    using array_result = result<quantity_column, error>;
+
+    // Reductions give a single value from arrays: sum(), prod(), min(), max()
+    // and mean() of one array, and dot() of two arrays of the same size. They
+    // are not part of the function tables, functions of the same name hide
+    // them.
+    bool is_reduction(std::string_view name);
+
+    // The error of the evaluators which only compute single values, for array
+    // literals and reductions.
+    error make_unsupported_array_error(const node_ptr& node);
+
+    // Evaluates an expression whose values are arrays: array literals, arrays
+    // of the table, and single values, which are arrays of one value.
+    // Operators and functions are applied to every value of their operands,
+    // which have to have the same size, except for single values, which are
+    // combined with every value of the other operands. Arrays of the table
+    // hide the variables of the symbol table, and only single values can be
+    // assigned. Calls to user functions are inlined first. The optimizer may
+    // turn an array of equal values outside of reductions into a single value.
+    array_result evaluate_array(
+        const node_ptr& node,
+        symbol_table& symbols,
+        const array_table& arrays,
+        const function_table& functions
+    );
+}
+
+#endif
@@ -0,0 +1,76 @@
+#if !defined(EXPRPARSER_AUTODIFF_HEADER)
+#define EXPRPARSER_AUTODIFF_HEADER
+
+#include "compiler.h"
+#include "context.h"
+#include "evaluator.h"
+#include "functions.h"
+#include "node.h"
+#include "quantity.h"
+#include "result.h"
+
+#include <cstdint>          // std::uint8_t, std::uint32_t
+#include <string_view>      // std::string_view
+#include <vector>           // std::vector
+
+namespace expr {
+    // The value of an expression, and its derivative with respect to one of
+    // its variables. The unit of the derivative is the unit of the value
+    // divided by the unit of the variable.
+    struct differential_t {
+        quantity value;
+        quantity derivative;
+    };
+
+    using differential_result = result<differential_t, error>;
+
+    // Computes the value and the derivative in a single evaluation of the
+    // tree, on dual numbers, using the rules of derive() without building a
+    // derived tree. The value, and the errors, are the ones of evaluate().
+    differential_result differentiate(
+        const node_ptr& node,
+        symbol_table& symbols,
+        const function_table& functions,
+        std::string_view variable
+    );
+
+    struct tape_entry_t {
+        std::uint32_t first;
+        std::uint32_t count;
+        bool dependent;
+    };
+
+    // The record of one evaluation of a compiled expression, for computing
+    // the derivatives of its value with respect to all of its variables. Every
+    // instruction leaves an entry, which has the partial derivatives of its
+    // value with respect to the entries it was computed from, if they depend
+    // on a variable at all. A tape is cleared, not freed, by every evaluation,
+    // so reusing one for the same expression does not allocate.
+    struct gradient_tape {
+        std::vector<tape_entry_t> entries;
+        std::vector<std::uint32_t> operands;
+        std::vector<double> partials;
+        std::vector<double> adjoints;
+        std::vector<std::uint32_t> stack;
+
+        // The entry of the value every variable had when it was first read,
+        // and of the value last assigned to it.
+        std::vector<std::uint32_t> inputs;
+        std::vector<std::uint32_t> assigned;
+        std::vector<measurement_unit> input_units;
+
+        // The derivative with respect to every variable, by slot. Variables
+        // that are never read before they are assigned have none.
+        std::vector<quantity> gradient;
+    };
+
+    // Evaluates the expression like evaluate() does, recording the tape, then
+    // computes the whole gradient in one sweep backwards over it.
+    evaluator_result gradient(
+        const compiled_expression& expression,
+        evaluation_context& context,
+        gradient_tape& tape
+    );
+}
+
+#endif
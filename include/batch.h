@@ -0,0 +1,30 @@
+#if !defined(EXPRPARSER_BATCH_HEADER)
+#define EXPRPARSER_BATCH_HEADER
+
+#include "column.h"
+#include "functions.h"
+#include "node.h"
+#include "quantity.h"
+
+#include <cstddef>          // std::size_t
+#include <string>           // std::string
+#include <unordered_map>    // std::unordered_map
+
+namespace expr {
+    using batch_result = result<quantity_column, error>;
+    using batch_symbol_table = std::unordered_map<std::string, quantity_column>;
+
+    static constexpr std::size_t batch_block_size = 256;
+
+    // Evaluates the expression once for every row of the columns of the
+    // variables, which have to have the same number of rows. Units are checked
+    // once per column, so every row of the result, and of assigned variables,
+    // has to have the same unit.
+    batch_result evaluate_batch(
+        const node_ptr& node,
+        batch_symbol_table& symbols,
+        const function_table& functions
+    );
+}
+
+#endif
@@ -0,0 +1,25 @@
+#if !defined(EXPRPARSER_BOUNDS_HEADER)
+#define EXPRPARSER_BOUNDS_HEADER
+
+#include "functions.h"
+#include "interval.h"
+#include "node.h"
+
+#include <string>           // std::string
+#include <unordered_map>    // std::unordered_map
+
+namespace expr {
+    using interval_table = std::unordered_map<std::string, interval_quantity>;
+
+    // Evaluates a tree over ranges of its variables, giving bounds every point
+    // evaluation with variables within their ranges stays within. Errors are
+    // the ones of the point evaluation, for errors it would give for every
+    // point. Functions need an interval implementation.
+    interval_result evaluate(
+        const node_ptr& node,
+        interval_table& symbols,
+        const function_table& functions
+    );
+}
+
+#endif
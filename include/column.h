@@ -0,0 +1,106 @@
+#if !defined(EXPRPARSER_COLUMN_HEADER)
+#define EXPRPARSER_COLUMN_HEADER
+
+#include "quantity.h"
+#include "result.h"
+
+#include <cstddef>          // std::size_t
+#include <optional>         // std::optional
+#include <vector>           // std::vector
+
+namespace expr {
+    // Many quantities of the same unit. The unit is stored once, so the values
+    // are a plain array of doubles.
+    struct quantity_column {
+        measurement_unit unit;
+        std::vector<double> values;
+
+        std::size_t size() const {
+            return values.size();
+        }
+
+        quantity operator[](std::size_t row) const {
+            return quantity{.unit = unit, .value = values[row]};
+        }
+    };
+
+    using column_error = std::optional<error>;
+}
+
+namespace expr::columns {
+    // The column counterparts of the operators in quantity.h. Units are
+    // checked once for the pair of columns, and the values are then computed
+    // by a single loop, which reports errors of values after it is done. Both
+    // operands have to have the same size, or one of them a single value,
+    // which is combined with every value of the other, and other sizes give
+    // EVALUATOR_MISMATCHED_ARRAY_SIZES. The output may be
+    // either of them, and has an unspecified value if the operation fails.
+    // Errors are the ones the operators on single quantities give for the
+    // first failing row, and raising a column with a unit to different
+    // exponents, which would give values of different units, is an error.
+    column_error add(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+    column_error subtract(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+    column_error multiply(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+    column_error divide(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+    column_error modulo(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+    column_error power(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+
+    // Comparisons give scalar columns of ones where they hold, and zeros
+    // elsewhere.
+    column_error less(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+    column_error less_equal(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+    column_error greater(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+    column_error greater_equal(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+    column_error equal(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+    column_error not_equal(
+        const quantity_column& lhs,
+        const quantity_column& rhs,
+        quantity_column& output
+    );
+}
+
+#endif
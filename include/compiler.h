@@ -0,0 +1,83 @@
+#if !defined(EXPRPARSER_COMPILER_HEADER)
+#define EXPRPARSER_COMPILER_HEADER
+
+#include "functions.h"
+#include "node.h"
+#include "quantity.h"
+#include "result.h"
+
+#include <cstddef>          // std::size_t
+#include <cstdint>          // std::uint8_t, std::uint32_t
+#include <optional>         // std::optional
+#include <string>           // std::string
+#include <vector>           // std::vector
+
+namespace expr {
+    struct instruction_t {
+        enum class opcode_t : std::uint8_t {
+            CONSTANT,
+            LOAD,
+            STORE,
+            NEGATE,
+            ADD,
+            SUBTRACT,
+            MULTIPLY,
+            DIVIDE,
+            MODULO,
+            POWER,
+            LESS,
+            LESS_EQUAL,
+            GREATER,
+            GREATER_EQUAL,
+            EQUAL,
+            NOT_EQUAL,
+            APPLY_UNIT,
+            CALL,
+
+            // Jumps go to the instruction at their operand. The conditional
+            // one pops its condition, and jumps if it is zero.
+            JUMP,
+            JUMP_IF_FALSE,
+        };
+
+        opcode_t opcode;
+        std::uint32_t operand;
+        location_t location;
+    };
+
+    struct call_site_t {
+        std::string name;
+        const function_definition_t *definition;
+        std::uint32_t arity;
+        bool validated;
+    };
+
+    // A syntax tree flattened into postfix instructions for a stack machine,
+    // with number literals and units folded into constants, and functions
+    // resolved, their arity and (where it is known at compile time) the units
+    // of their arguments validated. Call sites refer to the function table
+    // the expression was compiled with, so it has to outlive the expression.
+    struct compiled_expression {
+        std::vector<instruction_t> instructions;
+        std::vector<quantity> constants;
+        std::vector<std::string> variables;
+        std::vector<call_site_t> calls;
+        std::size_t stack_size;
+
+        // The tree evaluator reports failures of subexpressions through the
+        // error of the outermost node. The instruction of that node, and the
+        // unit applications around it, which follow it, report their own
+        // errors, every other instruction reports `failure`.
+        std::size_t root;
+        std::optional<error> failure;
+    };
+
+    using compiler_result = result<compiled_expression, error>;
+
+    compiler_result compile(
+        const node_ptr& root,
+        const function_table& functions
+    );
+}
+
+#endif
@@ -0,0 +1,98 @@
+#if !defined(EXPRPARSER_CONTEXT_HEADER)
+#define EXPRPARSER_CONTEXT_HEADER
+
+#include "compiler.h"
+#include "quantity.h"
+
+#include <cstddef>          // std::size_t
+#include <cstdint>          // std::int64_t, std::uint8_t
+#include <new>              // ::operator new, std::align_val_t
+#include <optional>         // std::optional
+#include <string_view>      // std::string_view
+#include <vector>           // std::vector
+
+namespace expr {
+    static constexpr std::size_t cache_line_size = 64;
+
+    // Allocates whole cache lines, so buffers of contexts used by different
+    // threads never share one.
+    template <typename T>
+    struct cache_aligned_allocator {
+        using value_type = T;
+
+        cache_aligned_allocator() = default;
+
+        template <typename U>
+        cache_aligned_allocator(const cache_aligned_allocator<U>&) noexcept {
+        }
+
+        T * allocate(std::size_t count) {
+            return static_cast<T *>(
+                ::operator new(padded_size(count), std::align_val_t{cache_line_size})
+            );
+        }
+
+        void deallocate(T *pointer, std::size_t) noexcept {
+            ::operator delete(pointer, std::align_val_t{cache_line_size});
+        }
+
+        template <typename U>
+        bool operator==(const cache_aligned_allocator<U>&) const noexcept {
+            return true;
+        }
+
+    private:
+        static std::size_t padded_size(std::size_t count) {
+            const auto bytes = count * sizeof(T);
+            return (bytes + cache_line_size - 1) / cache_line_size * cache_line_size;
+        }
+    };
+
+    template <typename T>
+    using cache_aligned_vector = std::vector<T, cache_aligned_allocator<T>>;
+
+    // The mutable state of evaluating a compiled expression: one slot for
+    // every variable it references or assigns, and the value stack. Compiled
+    // expressions are never modified by evaluation, so one can be shared by
+    // any number of threads, as long as each of them uses its own context.
+    // The integer values of the stack are kept exactly next to it.
+    struct alignas(cache_line_size) evaluation_context {
+        cache_aligned_vector<quantity> slots;
+        cache_aligned_vector<std::uint8_t> bound;
+        cache_aligned_vector<quantity> stack;
+        cache_aligned_vector<std::int64_t> exact;
+    };
+
+    evaluation_context make_context(const compiled_expression& expression);
+
+    // Grows a context made for another expression to fit this one.
+    void prepare(evaluation_context& context, const compiled_expression& expression);
+
+    std::optional<std::size_t> find_slot(
+        const compiled_expression& expression,
+        std::string_view name
+    );
+
+    // The slots of the variables the expression reads, in order. Variables
+    // it only assigns are left out, so these are the inputs to fetch before
+    // evaluating it.
+    std::vector<std::size_t> referenced_slots(const compiled_expression& expression);
+
+    bool bind(
+        evaluation_context& context,
+        const compiled_expression& expression,
+        std::string_view name,
+        quantity value
+    );
+
+    void bind(evaluation_context& context, std::size_t slot, quantity value);
+    void unbind_all(evaluation_context& context);
+
+    std::optional<quantity> lookup(
+        const evaluation_context& context,
+        const compiled_expression& expression,
+        std::string_view name
+    );
+}
+
+#endif
@@ -12,4 +12,22 @@ namespace expr {
     derivator_result derive(const node_ptr& node, std::string_view variable);
 }
 
+namespace expr::derivatives {
+    // The rules give the derivative of a function call with respect to its
+    // first argument. Builtins refer to their rule in their definition, see
+    // function_definition_t.
+    using derivative_rule_t = derivator_result (*)(
+        const node_ptr&,
+        std::string_view
+    );
+
+    derivator_result sin(const node_ptr& call, std::string_view variable);
+    derivator_result cos(const node_ptr& call, std::string_view variable);
+    derivator_result tan(const node_ptr& call, std::string_view variable);
+    derivator_result ctg(const node_ptr& call, std::string_view variable);
+    derivator_result sec(const node_ptr& call, std::string_view variable);
+    derivator_result csc(const node_ptr& call, std::string_view variable);
+    derivator_result logarithm(const node_ptr& call, std::string_view variable);
+}
+
 #endif
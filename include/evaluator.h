@@ -5,17 +5,83 @@
 #include "node.h"
 #include "quantity.h"
 
+#include <functional>       // std::function
+#include <optional>         // std::optional
+#include <string_view>      // std::string_view
+
 namespace expr {
-    using evaluator_result = function_result;
-    using symbol_table = std::unordered_map<std::string, quantity>;
+    template <typename T>
+    using basic_evaluator_result = basic_function_result<T>;
+
+    template <typename T>
+    using basic_symbol_table = std::unordered_map<std::string, basic_quantity<T>>;
+
+    using evaluator_result = basic_evaluator_result<double>;
+    using symbol_table = basic_symbol_table<double>;
+
+    // Evaluates in the value type of the symbol table. Number literals and
+    // units are converted to it as they are read, and functions without a
+    // builtin for it are evaluated in double. Instantiated for float, double
+    // and long double.
+    //
+    // In double, operators on integers from 2^53 up are computed exactly in
+    // 64 bits, and the result is rounded once, when it leaves the operators,
+    // the same way the compiled interpreter does. The other evaluators (the
+    // memoizing, parallel, batch, array, typed and interval ones) compute
+    // every operator in double, so they may round such integers
+    // differently.
+    template <typename T>
+    basic_evaluator_result<T> evaluate(
+        const node_ptr& node,
+        basic_symbol_table<T>& symbols,
+        const function_table& functions
+    );
 
+    // Gives the value of a variable kept outside of a symbol table, or
+    // nothing if there is no such variable. It is called by the thread
+    // evaluating the expression.
+    using variable_resolver = std::function<
+        std::optional<quantity>(std::string_view name)
+    >;
+
+    // Variables missing from the symbol table are resolved when the
+    // expression first reads them, and added to the table, so the variables
+    // of branches not taken are never resolved, and later evaluations with
+    // the same table reuse the values. The bodies of user functions, series
+    // and reductions resolve their variables the same way.
     evaluator_result evaluate(
         const node_ptr& node,
         symbol_table& symbols,
-        const function_table& functions
+        const function_table& functions,
+        const variable_resolver& resolver
+    );
+
+    // Looks a variable up for evaluators evaluating parts of a tree on their
+    // own. On a miss, the resolver of the tree evaluation in progress on the
+    // thread, if any, is asked, and the value is added to the table.
+    std::optional<quantity> find_variable(
+        const std::string& name,
+        symbol_table& symbols
     );
 
     evaluator_result evaluate_parse_time(const node_ptr& node);
+
+    // The code evaluators report a failed operator on quantities with.
+    // Operands of different units, like those of `1 m < 2` or `1 m + 2`, are
+    // mismatched, units with exponents out of range, like the one of
+    // `(1 m) ^ 200`, are reported as such, and so are columns of mismatched
+    // sizes, every other failure is reported as a division by zero.
+    error_code operator_error_code(error_code code);
+
+    // Combines the already evaluated operands of a binary operator node, the
+    // same way evaluate() does, for evaluators evaluating operands on their
+    // own.
+    template <typename T>
+    basic_evaluator_result<T> apply_binary_operator(
+        const node_t& node,
+        const basic_evaluator_result<T>& left,
+        const basic_evaluator_result<T>& right
+    );
 }
 
 #endif
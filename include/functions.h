@@ -1,30 +1,164 @@
 #if !defined(EXPRPARSER_FUNCTIONS_HEADER)
 #define EXPRPARSER_FUNCTIONS_HEADER
 
+#include "derivator.h"
+#include "interval.h"
+#include "kernels.h"
 #include "location.h"
+#include "node.h"
 #include "quantity.h"
 #include "result.h"
 
+#include <cstddef>          // std::size_t
+#include <memory>           // std::shared_ptr
+#include <optional>         // std::optional
+#include <span>             // std::span
+#include <string>           // std::string
+#include <type_traits>      // std::is_same_v
 #include <unordered_map>    // std::unordered_map
 #include <vector>           // std::vector
 
 namespace expr {
-    using function_result = result<quantity, error>;
+    template <typename T>
+    using basic_function_result = result<basic_quantity<T>, error>;
+
+    using function_result = basic_function_result<double>;
 
     using function_t = function_result (*)(
         const std::vector<quantity>&,
         const location_t&
     );
 
+    // Builtins take their arguments from a buffer owned by the caller, and
+    // rely on the caller to validate the arguments against the parameter list
+    // of their definition, see validate_arguments().
+    template <typename T>
+    using basic_builtin_t = basic_function_result<T> (*)(
+        std::span<const basic_quantity<T>>,
+        const location_t&
+    );
+
+    using builtin_t = basic_builtin_t<double>;
+
+    // Functions loaded from plugins, see plugin.h, take the values of their
+    // arguments in the base unit of their dimension, and give a scalar.
+    using native_function_t = double (*)(const double *arguments);
+
+    static constexpr std::size_t max_builtin_arity = 8;
+
+    struct parameter_t {
+        const char *type;
+        bool (measurement_unit::*accepts)() const;
+    };
+
+    // A function defined in the expression language, like `f(x, y) = x^2 + y`.
+    // Its parameters are variables of its body, its other variables are the
+    // ones of the caller.
+    struct user_function_t {
+        std::string name;
+        std::vector<std::string> parameters;
+        node_ptr body;
+    };
+
+    // Calls to user functions are nested at most this deep.
+    static constexpr std::size_t max_call_depth = 256;
+
     struct function_definition_t {
         function_t implementation;
         std::string signature;
+        kernels::kernel_t batch_implementation = nullptr;
+        intervals::interval_function_t interval_implementation = nullptr;
+        builtin_t builtin = nullptr;
+
+        // The builtin for the other value types, see builtin_for().
+        basic_builtin_t<float> float_builtin = nullptr;
+        basic_builtin_t<long double> long_double_builtin = nullptr;
+
+        native_function_t native_function = nullptr;
+
+        std::vector<parameter_t> parameters = {};
+
+        // Pure functions always give the same result for the same arguments,
+        // so their results may be reused.
+        bool is_pure = false;
+
+        // Estimated cost of a call, relative to that of an arithmetic
+        // operator, for passes weighing subexpressions against each other.
+        std::size_t cost = 1;
+
+        // The rule the derivator applies to calls. Functions without one
+        // can't be derived.
+        derivatives::derivative_rule_t derivative = nullptr;
+
+        // Set for functions defined in the expression language, which have
+        // neither an implementation nor builtins. Only the tree evaluator
+        // calls them, everything else has to inline them first.
+        std::shared_ptr<const user_function_t> user_function = nullptr;
     };
 
     using function_table =
         std::unordered_map<std::string, function_definition_t>;
 
     const function_table& functions();
+
+    // Adds a function definition node to the table, replacing the previous
+    // definition of the same user function. Builtins can't be redefined.
+    std::optional<error> define_function(
+        function_table& functions,
+        node_ptr&& definition
+    );
+
+    template <typename T>
+    basic_builtin_t<T> builtin_for(const function_definition_t& definition) {
+        if constexpr (std::is_same_v<T, float>)
+            return definition.float_builtin;
+        else if constexpr (std::is_same_v<T, long double>)
+            return definition.long_double_builtin;
+        else
+            return definition.builtin;
+    }
+
+    std::optional<error> validate_argument_count(
+        const function_definition_t& definition,
+        std::size_t count,
+        const location_t& location
+    );
+
+    std::optional<error> validate_argument(
+        const function_definition_t& definition,
+        std::size_t position,
+        measurement_unit unit,
+        const location_t& location
+    );
+
+    // Instantiated for float, double and long double.
+    template <typename T>
+    std::optional<error> validate_arguments(
+        const function_definition_t& definition,
+        std::span<const basic_quantity<T>> arguments,
+        const location_t& location
+    );
+
+    std::optional<error> validate_arguments(
+        const function_definition_t& definition,
+        std::span<const quantity> arguments,
+        const location_t& location
+    );
+
+    // Functions without a builtin for the value type of the arguments are
+    // invoked in double. Instantiated for float, double and long double.
+    template <typename T>
+    basic_function_result<T> invoke(
+        const function_definition_t& definition,
+        std::span<const basic_quantity<T>> arguments,
+        const location_t& location
+    );
+
+    function_result invoke(
+        const function_definition_t& definition,
+        std::span<const quantity> arguments,
+        const location_t& location
+    );
 }
 
 #endif
@@ -0,0 +1,46 @@
+#if !defined(EXPRPARSER_INTERPRETER_HEADER)
+#define EXPRPARSER_INTERPRETER_HEADER
+
+#include "compiler.h"
+#include "context.h"
+#include "evaluator.h"
+#include "policy.h"
+#include "quantity.h"
+
+namespace expr {
+    // Instantiated for the checked and the IEEE policy. Integers from 2^53 up
+    // are kept exactly while they are operands, like in the tree evaluator,
+    // see evaluator.h.
+    template <evaluation_policy Policy = checked_policy>
+    evaluator_result evaluate(
+        const compiled_expression& expression,
+        symbol_table& symbols
+    );
+
+    template <evaluation_policy Policy = checked_policy>
+    evaluator_result evaluate(
+        const compiled_expression& expression,
+        evaluation_context& context
+    );
+
+    // Variables not bound in the context are resolved when the expression
+    // first reads them, and bound, so the variables of branches not taken are
+    // never resolved, and the context caches the values until they are
+    // unbound. Values bound beforehand, like those prefetched for the
+    // referenced slots, are not resolved again.
+    template <evaluation_policy Policy = checked_policy>
+    evaluator_result evaluate(
+        const compiled_expression& expression,
+        evaluation_context& context,
+        const variable_resolver& resolver
+    );
+
+    // Resolves every variable read at most once, for this evaluation only.
+    template <evaluation_policy Policy = checked_policy>
+    evaluator_result evaluate(
+        const compiled_expression& expression,
+        const variable_resolver& resolver
+    );
+}
+
+#endif
@@ -0,0 +1,88 @@
+#if !defined(EXPRPARSER_INTERVAL_HEADER)
+#define EXPRPARSER_INTERVAL_HEADER
+
+#include "quantity.h"
+#include "result.h"
+
+#include <iosfwd>           // std::ostream
+#include <span>             // std::span
+
+namespace expr {
+    // A closed range containing every value a computation can give for inputs
+    // within the ranges of its operands. Bounds are rounded outwards. Both
+    // bounds are NaN if the computation is outside of the domain of a function
+    // everywhere, which makes the interval empty.
+    struct interval_t {
+        double lower;
+        double upper;
+
+        bool is_empty() const;
+        bool contains(double value) const;
+    };
+
+    struct interval_quantity {
+        measurement_unit unit;
+        interval_t value;
+    };
+
+    using interval_result = result<interval_quantity, error>;
+
+    inline interval_quantity make_interval(
+        double lower,
+        double upper,
+        measurement_unit unit = {0, 0}
+    ) {
+        return interval_quantity{unit, interval_t{lower, upper}};
+    }
+
+    inline interval_quantity make_interval(quantity point) {
+        return interval_quantity{point.unit, interval_t{point.value, point.value}};
+    }
+}
+
+namespace expr::intervals {
+    // The operators check units, and report the errors, the same way their
+    // counterparts in quantity.h do. Every point within the operands that the
+    // point operator would reject is left out of the result, so dividing by an
+    // interval around zero gives bounds of the quotients of the remaining
+    // divisors.
+    interval_result identity(interval_quantity operand);
+    interval_result negate(interval_quantity operand);
+    interval_result add(interval_quantity lhs, interval_quantity rhs);
+    interval_result subtract(interval_quantity lhs, interval_quantity rhs);
+    interval_result multiply(interval_quantity lhs, interval_quantity rhs);
+    interval_result divide(interval_quantity lhs, interval_quantity rhs);
+    interval_result modulo(interval_quantity lhs, interval_quantity rhs);
+    interval_result power(interval_quantity lhs, interval_quantity rhs);
+
+    // Comparisons give [1, 1] if they hold for every pair of values of the
+    // operands, [0, 0] if they hold for none, and [0, 1] otherwise.
+    interval_result less(interval_quantity lhs, interval_quantity rhs);
+    interval_result less_equal(interval_quantity lhs, interval_quantity rhs);
+    interval_result greater(interval_quantity lhs, interval_quantity rhs);
+    interval_result greater_equal(interval_quantity lhs, interval_quantity rhs);
+    interval_result equal(interval_quantity lhs, interval_quantity rhs);
+    interval_result not_equal(interval_quantity lhs, interval_quantity rhs);
+
+    // Interval versions of the builtins. They expect arguments validated
+    // against the parameters of the builtin, like the builtins do.
+    using interval_function_t = interval_quantity (*)(
+        std::span<const interval_quantity>
+    );
+
+    interval_quantity sin(std::span<const interval_quantity> arguments);
+    interval_quantity cos(std::span<const interval_quantity> arguments);
+    interval_quantity round(std::span<const interval_quantity> arguments);
+    interval_quantity floor(std::span<const interval_quantity> arguments);
+    interval_quantity ceil(std::span<const interval_quantity> arguments);
+    interval_quantity abs(std::span<const interval_quantity> arguments);
+    interval_quantity ln(std::span<const interval_quantity> arguments);
+    interval_quantity log2(std::span<const interval_quantity> arguments);
+    interval_quantity log10(std::span<const interval_quantity> arguments);
+    interval_quantity log(std::span<const interval_quantity> arguments);
+    interval_quantity sgn(std::span<const interval_quantity> arguments);
+}
+
+std::ostream& operator<<(std::ostream& stream, const expr::interval_quantity& interval);
+
+#endif
@@ -0,0 +1,40 @@
+#if !defined(EXPRPARSER_KERNELS_HEADER)
+#define EXPRPARSER_KERNELS_HEADER
+
+#include <cstddef>          // std::size_t
+
+namespace expr::kernels {
+    // Every kernel reads `count` values from each of its argument arrays and
+    // writes `count` results to `output`. Kernels do not check units, the
+    // caller is expected to do so once per block.
+    using kernel_t = void (*)(
+        const double * const *arguments,
+        double *output,
+        std::size_t count
+    );
+
+    // Error bounds, measured against the C library over normal inputs:
+    //   sin, cos: <= 1 ulp for |x| <= 4, <= 2 ulp for |x| <= 2^20 * pi/2
+    //             (larger inputs, infinities and NaNs are forwarded to
+    //             std::sin and std::cos),
+    //   ln:       <= 1 ulp,
+    //   log2:     <= 2 ulp,
+    //   log10:    <= 2 ulp,
+    //   log:      <= 4 ulp (quotient of two ln results, the scalar version
+    //             divides two log10 results).
+    // Non-positive, subnormal, infinite and NaN inputs of the logarithms are
+    // forwarded to the C library. The remaining kernels are exact.
+    void sin(const double * const *arguments, double *output, std::size_t count);
+    void cos(const double * const *arguments, double *output, std::size_t count);
+    void round(const double * const *arguments, double *output, std::size_t count);
+    void floor(const double * const *arguments, double *output, std::size_t count);
+    void ceil(const double * const *arguments, double *output, std::size_t count);
+    void abs(const double * const *arguments, double *output, std::size_t count);
+    void ln(const double * const *arguments, double *output, std::size_t count);
+    void log2(const double * const *arguments, double *output, std::size_t count);
+    void log10(const double * const *arguments, double *output, std::size_t count);
+    void log(const double * const *arguments, double *output, std::size_t count);
+    void sgn(const double * const *arguments, double *output, std::size_t count);
+}
+
+#endif
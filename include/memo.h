@@ -0,0 +1,154 @@
+#if !defined(EXPRPARSER_MEMO_HEADER)
+#define EXPRPARSER_MEMO_HEADER
+
+#include "evaluator.h"
+#include "functions.h"
+#include "node.h"
+#include "quantity.h"
+
+#include <cstddef>          // std::size_t
+#include <cstdint>          // std::uint32_t
+#include <list>             // std::list
+#include <optional>         // std::optional
+#include <span>             // std::span
+#include <string>           // std::string
+#include <unordered_map>    // std::unordered_map
+#include <vector>           // std::vector
+
+namespace expr {
+    struct memo_statistics {
+        std::size_t subtree_hits = 0;
+        std::size_t subtree_misses = 0;
+        std::size_t call_hits = 0;
+        std::size_t call_misses = 0;
+        std::size_t call_evictions = 0;
+    };
+
+    // Remembers the values of subexpressions, and the results of calls of
+    // pure functions. Structurally equal subtrees share their entries, even
+    // across trees and evaluations. An entry is reused as long as every
+    // variable its subtree refers to has the same value as when it was
+    // computed. A cache must only be used with a single function table.
+    // Results of calls are kept for the most recently used arguments only.
+    class memo_cache final {
+    public:
+        using subtree_id = std::uint32_t;
+
+        static constexpr std::size_t default_call_capacity = 65536;
+
+        explicit memo_cache(std::size_t call_capacity = default_call_capacity);
+
+        // Gives structurally equal subtrees the same identifier, made from
+        // the node and the identifiers of its children.
+        subtree_id intern(const node_t& node, std::span<const subtree_id> children);
+
+        std::optional<quantity> find(subtree_id id, const symbol_table& symbols);
+        void insert(subtree_id id, quantity value, const symbol_table& symbols);
+
+        std::optional<quantity> find_call(
+            const function_definition_t& definition,
+            std::span<const quantity> arguments
+        );
+
+        void insert_call(
+            const function_definition_t& definition,
+            std::span<const quantity> arguments,
+            quantity value
+        );
+
+        const memo_statistics& statistics() const noexcept;
+
+        // Expressions memoized with the cache have to be memoized again after
+        // it is cleared.
+        void clear();
+
+    private:
+        struct subtree_key {
+            node_t::type_t type;
+            std::string content;
+            std::vector<subtree_id> children;
+
+            bool operator==(const subtree_key&) const = default;
+        };
+
+        struct subtree_key_hash {
+            std::size_t operator()(const subtree_key& key) const noexcept;
+        };
+
+        struct subtree_t {
+            std::vector<std::string> variables;
+            std::optional<quantity> value;
+            std::vector<quantity> inputs;
+        };
+
+        struct call_t {
+            const function_definition_t *definition;
+            std::vector<quantity> arguments;
+            quantity value;
+        };
+
+        // Keys of the calls refer to the arguments of the entries, so calls
+        // are looked up by the arguments of the caller, without a copy.
+        struct call_key {
+            const function_definition_t *definition;
+            std::span<const quantity> arguments;
+
+            bool operator==(const call_key& other) const noexcept;
+        };
+
+        struct call_key_hash {
+            std::size_t operator()(const call_key& key) const noexcept;
+        };
+
+        using call_list = std::list<call_t>;
+
+    private:
+        std::unordered_map<subtree_key, subtree_id, subtree_key_hash> _ids;
+        std::vector<subtree_t> _subtrees;
+
+        // Calls from the most to the least recently used one.
+        call_list _calls;
+        std::unordered_map<call_key, call_list::iterator, call_key_hash> _call_index;
+        std::size_t _call_capacity;
+
+        memo_statistics _statistics;
+    };
+
+    // The subtree identifiers of a tree, made once, so the tree can be
+    // evaluated any number of times with the cache they were made with. It
+    // refers to the tree, which has to outlive it.
+    struct memoized_expression {
+        struct node_info_t {
+            memo_cache::subtree_id id;
+            std::uint32_t size;
+            bool is_cacheable;
+        };
+
+        const node_ptr *root;
+        const function_table *functions;
+
+        // The nodes of the tree in pre-order.
+        std::vector<node_info_t> nodes;
+    };
+
+    memoized_expression memoize(
+        const node_ptr& root,
+        const function_table& functions,
+        memo_cache& cache
+    );
+
+    evaluator_result evaluate(
+        const memoized_expression& expression,
+        symbol_table& symbols,
+        memo_cache& cache
+    );
+
+    evaluator_result evaluate(
+        const node_ptr& node,
+        symbol_table& symbols,
+        const function_table& functions,
+        memo_cache& cache
+    );
+}
+
+#endif
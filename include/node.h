@@ -5,6 +5,7 @@
 
 #include <memory>           // std::unique_ptr
 #include <string>           // std::string
+#include <string_view>      // std::string_view
 #include <vector>           // std::vector
 
 namespace expr {
@@ -22,6 +23,9 @@ namespace expr {
             ASSIGNMENT,
             UNIT,
             UNIT_APPLICATION,
+            FUNCTION_DEFINITION,
+            ARRAY,
+            CONDITIONAL,
         };
 
         type_t type;
@@ -78,6 +82,34 @@ namespace expr {
         const location_t& location
     );
 
+    // The children of a function definition are its parameters, as variable
+    // nodes, followed by its body.
+    node_ptr make_function_definition_node(
+        std::string name,
+        std::vector<node_ptr>&& parameters,
+        node_ptr&& body,
+        const location_t& location
+    );
+
+    // The children of an array are its elements.
+    node_ptr make_array_node(
+        std::vector<node_ptr>&& elements,
+        const location_t& location
+    );
+
+    // The children of a conditional are its condition, and the branches taken
+    // if it holds, and if it does not.
+    node_ptr make_conditional_node(
+        node_ptr&& condition,
+        node_ptr&& then_branch,
+        node_ptr&& else_branch,
+        const location_t& location
+    );
+
+    // Binary operators comparing their operands, which give 1 if the
+    // comparison holds, and 0 otherwise.
+    bool is_comparison(std::string_view operation);
+
     std::string to_expression_string(const node_ptr& root);
 }
 
@@ -1,13 +1,37 @@
 #if !defined(EXPRPARSER_OPTIMIZER_HEADER)
 #define EXPRPARSER_OPTIMIZER_HEADER
 
+#include "functions.h"
 #include "node.h"
 #include "result.h"
 
+#include <cstddef>          // std::size_t
+
 namespace expr {
     using optimizer_result = result<node_ptr, error>;
 
+    // User functions with at most this many nodes in their body are inlined
+    // by the optimizer.
+    static constexpr std::size_t max_inline_size = 32;
+
+    // Calls of pure builtins with constant arguments are folded.
     optimizer_result optimize(const node_ptr& root);
+
+    // Inlines the calls to small user functions before optimizing, so the
+    // bodies are optimized together with the arguments. Calls of pure
+    // functions of the table with constant arguments are folded.
+    optimizer_result optimize(const node_ptr& root, const function_table& functions);
+
+    // Replaces the calls to user functions with at most `max_size` nodes in
+    // their body by the body, in which the parameters are replaced by the
+    // arguments. The nodes of the body get the location of the call. Calls
+    // with the wrong number of arguments, and recursive calls are kept.
+    // Function definitions are kept as they are.
+    node_ptr inline_functions(
+        const node_ptr& root,
+        const function_table& functions,
+        std::size_t max_size = max_inline_size
+    );
 }
 
 #endif
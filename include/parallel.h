@@ -0,0 +1,55 @@
+#if !defined(EXPRPARSER_PARALLEL_HEADER)
+#define EXPRPARSER_PARALLEL_HEADER
+
+#include "evaluator.h"
+#include "functions.h"
+#include "thread_pool.h"
+
+#include <cstddef>          // std::size_t
+#include <span>             // std::span
+#include <string>           // std::string
+#include <vector>           // std::vector
+
+namespace expr {
+    struct parallel_settings {
+        // The number of expressions a worker takes (or steals) at once.
+        std::size_t chunk_size = 16;
+    };
+
+    struct expression_item {
+        std::string expression;
+        symbol_table symbols;
+    };
+
+    using expression_results = std::vector<evaluator_result>;
+
+    // Tokenizes, parses, optimizes, compiles and evaluates every expression on
+    // its own, in parallel on the workers of the pool. The symbol tables of
+    // the items are not modified, assignments only affect the evaluation of
+    // their own expression.
+    expression_results evaluate_all(
+        std::span<const expression_item> items,
+        const function_table& functions,
+        thread_pool& pool,
+        const parallel_settings& settings = {}
+    );
+
+    // Subtrees with fewer nodes than this are not worth a task of their own.
+    // Function calls count as many nodes as their estimated cost.
+    static constexpr std::size_t default_sequential_cutoff = 512;
+
+    // Evaluates a single expression, forking the operands of chains of binary
+    // operators and the arguments of function calls as tasks on the pool, if
+    // they are large enough. Subtrees containing assignments are evaluated in
+    // order, so a variable is never read and assigned at the same time. The
+    // result is the same as that of the sequential evaluator.
+    evaluator_result evaluate_parallel(
+        const node_ptr& root,
+        symbol_table& symbols,
+        const function_table& functions,
+        thread_pool& pool,
+        std::size_t sequential_cutoff = default_sequential_cutoff
+    );
+}
+
+#endif
@@ -0,0 +1,23 @@
+#if !defined(EXPRPARSER_PLUGIN_HEADER)
+#define EXPRPARSER_PLUGIN_HEADER
+
+#include "functions.h"
+#include "plugin_abi.h"
+#include "result.h"
+
+#include <optional>         // std::optional
+#include <string>           // std::string
+
+namespace expr {
+    // Opens the shared object at `path`, and adds the functions it exports
+    // through its entry point to the table, see plugin_abi.h. Either every
+    // function of the plugin is added, or none of them are. Functions of the
+    // table can't be redefined by plugins. Plugins stay loaded until the
+    // program exits, as the table refers to their code.
+    std::optional<error> load_plugin(
+        function_table& functions,
+        const std::string& path
+    );
+}
+
+#endif
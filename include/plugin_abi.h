@@ -0,0 +1,88 @@
+#if !defined(EXPRPARSER_PLUGIN_ABI_HEADER)
+#define EXPRPARSER_PLUGIN_ABI_HEADER
+
+/* The interface between exprparser and the shared objects adding functions
+ * to it. It is plain C, so plugins can be built with any compiler, and only
+ * changes together with EXPRPARSER_PLUGIN_ABI_VERSION. */
+
+#include <stddef.h>         /* size_t */
+#include <stdint.h>         /* uint32_t */
+
+#define EXPRPARSER_PLUGIN_ABI_VERSION 1u
+
+/* The name of the function every plugin exports, of exprparser_plugin_entry_t
+ * type. */
+#define EXPRPARSER_PLUGIN_ENTRY_POINT "exprparser_plugin_entry"
+
+#if defined(_WIN32)
+#define EXPRPARSER_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define EXPRPARSER_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* Arguments are given in the base unit of their dimension, that is meters,
+ * radians, kilograms, seconds and kelvins, and the result is a scalar.
+ * Failures are reported as NaN. */
+typedef double (*exprparser_scalar_function_t)(const double *arguments);
+
+/* Reads `count` values from each of the argument arrays, and writes `count`
+ * results to `output`, which may be one of the argument arrays. */
+typedef void (*exprparser_batch_function_t)(
+    const double * const *arguments,
+    double *output,
+    size_t count
+);
+
+typedef struct exprparser_plugin_function {
+    const char *name;
+
+    /* Shown to users, like "j0(x: scalar) -> scalar". Made up from the
+     * parameter types if NULL. */
+    const char *signature;
+
+    /* At most 8 parameters, whose types are "scalar", "length", "area",
+     * "volume", "angle", "mass", "time", "temperature", "currency" or "any".
+     * All of them are scalars if the types are NULL. */
+    uint32_t arity;
+    const char * const *parameter_types;
+
+    exprparser_scalar_function_t scalar;
+
+    /* Optional, functions without one are evaluated one row at a time. */
+    exprparser_batch_function_t batch;
+
+    /* Non-zero if the function always gives the same result for the same
+     * arguments, so calls to it may be folded and cached. */
+    uint32_t is_pure;
+
+    /* The estimated cost of a call, relative to an arithmetic operator, or 0
+     * if unknown. */
+    uint32_t cost;
+} exprparser_plugin_function;
+
+typedef struct exprparser_plugin {
+    /* EXPRPARSER_PLUGIN_ABI_VERSION of the headers the plugin was built
+     * with. */
+    uint32_t abi_version;
+
+    uint32_t function_count;
+    const exprparser_plugin_function *functions;
+} exprparser_plugin;
+
+/* Called once, with the ABI version of the host. The result has to stay
+ * valid as long as the plugin is loaded. Plugins supporting more than one
+ * version of the ABI describe themselves for the version of the host, others
+ * give their own version and are rejected by a host of a different one. */
+typedef const exprparser_plugin *(*exprparser_plugin_entry_t)(
+    uint32_t host_abi_version
+);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
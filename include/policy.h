@@ -0,0 +1,25 @@
+#if !defined(EXPRPARSER_POLICY_HEADER)
+#define EXPRPARSER_POLICY_HEADER
+
+#include <concepts>         // std::convertible_to
+
+namespace expr {
+    // Evaluation policies are chosen at compile time. The checked policy
+    // reports values operations can not represent as errors. The IEEE policy
+    // lets infinities and NaNs propagate instead, so they are checked once,
+    // on the result. Units are checked either way.
+    struct checked_policy {
+        static constexpr bool is_checked = true;
+    };
+
+    struct ieee_policy {
+        static constexpr bool is_checked = false;
+    };
+
+    template <typename Policy>
+    concept evaluation_policy = requires {
+        { Policy::is_checked } -> std::convertible_to<bool>;
+    };
+}
+
+#endif
@@ -3,24 +3,135 @@
 
 #include "result.h"
 
+#include <cstdint>          // std::int8_t, std::uint8_t, std::uint64_t
+#include <iosfwd>           // std::ostream
+#include <optional>         // std::optional
+#include <string_view>      // std::string_view
+#include <type_traits>      // std::type_identity_t
+
 namespace expr {
+    // The base dimensions a unit can have an exponent of. There is room for
+    // eight of them.
+    enum class dimension_t : unsigned {
+        LENGTH,
+        ANGLE,
+        MASS,
+        TIME,
+        TEMPERATURE,
+        CURRENCY,
+    };
+
+    inline constexpr unsigned max_dimensions = 8;
+
+    // The exponents of the dimensions are signed 8-bit lanes of a single word,
+    // the one of dimension i at bits 8i to 8i + 7. Units are multiplied and
+    // divided by adding and subtracting all the lanes at once, and compared as
+    // one integer. Units with an exponent outside of [-128, 127] can't be
+    // represented, so their products, quotients and powers give nothing.
     struct measurement_unit {
-        int length_dimension;
-        int angle_dimension;
+        std::uint64_t exponents = 0;
+
+        constexpr measurement_unit() = default;
+
+        constexpr measurement_unit(int length, int angle)
+            : exponents(lane(dimension_t::LENGTH, length) |
+                        lane(dimension_t::ANGLE, angle)) {}
+
+        static constexpr measurement_unit of(dimension_t dimension, int exponent) {
+            auto unit = measurement_unit{};
+            unit.exponents = lane(dimension, exponent);
+            return unit;
+        }
+
+        constexpr int exponent(dimension_t dimension) const {
+            return std::int8_t(exponents >> shift(dimension));
+        }
+
+        constexpr int length_dimension() const {
+            return exponent(dimension_t::LENGTH);
+        }
+
+        constexpr int angle_dimension() const {
+            return exponent(dimension_t::ANGLE);
+        }
+
+        // The high bit of each lane is left out of the sum, so carries stay
+        // within their lane, and added back without carry. A lane overflows
+        // if its operands have the same sign, and its sum the other one.
+        constexpr std::optional<measurement_unit> multiply(measurement_unit rhs) const {
+            auto unit = measurement_unit{};
+            unit.exponents = ((exponents & ~high_bits) + (rhs.exponents & ~high_bits)) ^
+                             ((exponents ^ rhs.exponents) & high_bits);
+            if (~(exponents ^ rhs.exponents) & (exponents ^ unit.exponents) & high_bits)
+                return std::nullopt;
+            return unit;
+        }
+
+        // The high bit of each lane of the minuend is set, so borrows stay
+        // within their lane, and corrected afterwards. A lane overflows if its
+        // operands have different signs, and its difference the one of the
+        // subtrahend.
+        constexpr std::optional<measurement_unit> divide(measurement_unit rhs) const {
+            auto unit = measurement_unit{};
+            unit.exponents = ((exponents | high_bits) - (rhs.exponents & ~high_bits)) ^
+                             ((exponents ^ ~rhs.exponents) & high_bits);
+            if ((exponents ^ rhs.exponents) & (exponents ^ unit.exponents) & high_bits)
+                return std::nullopt;
+            return unit;
+        }
+
+        // The exponent has to be an integer.
+        constexpr std::optional<measurement_unit> power(double exponent) const {
+            auto unit = measurement_unit{};
+            for (unsigned i = 0; i < max_dimensions; ++i) {
+                const auto dimension = dimension_t(i);
+                const auto base = this->exponent(dimension);
+                if (base == 0)
+                    continue;
+
+                const auto product = double(base) * exponent;
+                if (!(product >= min_exponent && product <= max_exponent))
+                    return std::nullopt;
+                unit.exponents |= lane(dimension, int(product));
+            }
+            return unit;
+        }
 
         bool is_scalar() const;
         bool is_length() const;
         bool is_area() const;
         bool is_volume() const;
         bool is_angle() const;
+        bool is_mass() const;
+        bool is_time() const;
+        bool is_temperature() const;
+        bool is_currency() const;
         bool is_mixed() const;
 
         bool operator==(const measurement_unit&) const = default;
+
+        static constexpr int min_exponent = -128;
+        static constexpr int max_exponent = 127;
+
+    private:
+        static constexpr std::uint64_t high_bits = 0x8080808080808080;
+
+        static constexpr unsigned shift(dimension_t dimension) {
+            return 8 * unsigned(dimension);
+        }
+
+        static constexpr std::uint64_t lane(dimension_t dimension, int exponent) {
+            return std::uint64_t(std::uint8_t(exponent)) << shift(dimension);
+        }
     };
 
-    struct quantity {
+    // The value type is a template parameter, so the same evaluation can be
+    // done in float, double or long double. The functions of quantities are
+    // instantiated for these three.
+    template <typename T>
+    struct basic_quantity {
         measurement_unit unit;
-        double value;
+        T value;
 
         bool is_scalar() const {
             return unit.is_scalar();
@@ -42,35 +153,116 @@ namespace expr {
             return unit.is_angle();
         }
 
+        bool is_mass() const {
+            return unit.is_mass();
+        }
+
+        bool is_time() const {
+            return unit.is_time();
+        }
+
+        bool is_temperature() const {
+            return unit.is_temperature();
+        }
+
+        bool is_currency() const {
+            return unit.is_currency();
+        }
+
         bool is_mixed() const {
             return unit.is_mixed();
         }
     };
 
-    using arithmetic_result = result<quantity, error>;
+    using quantity = basic_quantity<double>;
 
-    inline quantity make_scalar(double value) {
-        return quantity{{0, 0}, value};
+    template <typename T>
+    using basic_arithmetic_result = result<basic_quantity<T>, error>;
+
+    using arithmetic_result = basic_arithmetic_result<double>;
+
+    template <typename T = double>
+    inline basic_quantity<T> make_scalar(std::type_identity_t<T> value) {
+        return basic_quantity<T>{{0, 0}, value};
     }
 
-    inline quantity make_length(double value) {
-        return quantity{{1, 0}, value};
+    template <typename T = double>
+    inline basic_quantity<T> make_length(std::type_identity_t<T> value) {
+        return basic_quantity<T>{{1, 0}, value};
     }
 
-    inline quantity make_angle(double value) {
-        return quantity{{0, 1}, value};
+    template <typename T = double>
+    inline basic_quantity<T> make_angle(std::type_identity_t<T> value) {
+        return basic_quantity<T>{{0, 1}, value};
     }
 
-    arithmetic_result identity(quantity operand);
-    arithmetic_result negate(quantity operand);
-    arithmetic_result add(quantity lhs, quantity rhs);
-    arithmetic_result subtract(quantity lhs, quantity rhs);
-    arithmetic_result multiply(quantity lhs, quantity rhs);
-    arithmetic_result divide(quantity lhs, quantity rhs);
-    arithmetic_result modulo(quantity lhs, quantity rhs);
-    arithmetic_result power(quantity lhs, quantity rhs);
+    template <typename T = double>
+    basic_arithmetic_result<T> make_unit(std::string_view symbol);
+
+    using unit_result = result<measurement_unit, error>;
+
+    // The units of products, quotients and integral powers of quantities, for
+    // evaluators combining units on their own. An exponent leaving
+    // [-128, 127] is an error.
+    unit_result multiply_unit(measurement_unit lhs, measurement_unit rhs);
+    unit_result divide_unit(measurement_unit lhs, measurement_unit rhs);
+    unit_result power_unit(measurement_unit base, double exponent);
+
+    template <typename T>
+    basic_arithmetic_result<T> identity(basic_quantity<T> operand);
+
+    template <typename T>
+    basic_arithmetic_result<T> negate(basic_quantity<T> operand);
+
+    template <typename T>
+    basic_arithmetic_result<T> add(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    template <typename T>
+    basic_arithmetic_result<T> subtract(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    template <typename T>
+    basic_arithmetic_result<T> multiply(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    template <typename T>
+    basic_arithmetic_result<T> divide(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    template <typename T>
+    basic_arithmetic_result<T> modulo(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    template <typename T>
+    basic_arithmetic_result<T> power(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    // Comparisons give a scalar 1 if they hold, 0 otherwise. Only quantities
+    // of the same unit can be compared.
+    template <typename T>
+    basic_arithmetic_result<T> less(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    template <typename T>
+    basic_arithmetic_result<T> less_equal(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    template <typename T>
+    basic_arithmetic_result<T> greater(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    template <typename T>
+    basic_arithmetic_result<T> greater_equal(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    template <typename T>
+    basic_arithmetic_result<T> equal(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    template <typename T>
+    basic_arithmetic_result<T> not_equal(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    // Like divide() and power(), but values they can not represent are left
+    // to IEEE 754. Dividing by zero gives an infinity, powers of scalars may
+    // have any scalar exponent and give a NaN where they are not defined.
+    template <typename T>
+    basic_arithmetic_result<T> ieee_divide(basic_quantity<T> lhs, basic_quantity<T> rhs);
+
+    template <typename T>
+    basic_arithmetic_result<T> ieee_power(basic_quantity<T> lhs, basic_quantity<T> rhs);
 }
 
-std::ostream& operator<<(std::ostream& stream, const expr::quantity& token);
+template <typename T>
+std::ostream& operator<<(std::ostream& stream, const expr::basic_quantity<T>& quantity);
 
 #endif
@@ -3,10 +3,14 @@
 
 #include "location.h"
 
+#include <cstddef>          // std::size_t
+#include <cstdint>          // std::uint8_t
+#include <iosfwd>           // std::ostream
+#include <memory>           // std::construct_at, std::destroy_at, std::shared_ptr
 #include <string>           // std::string
-#include <type_traits>      // std::is_convertible_v
-#include <utility>          // std::forward
-#include <variant>          // std::variant, std::get_if
+#include <string_view>      // std::string_view
+#include <type_traits>      // std::is_convertible_v, std::is_trivially_copyable_v
+#include <utility>          // std::forward, std::move
 
 namespace expr {
     enum error_code : unsigned {
@@ -20,6 +24,8 @@ namespace expr {
         PARSER_UNEXPECTED_TOKEN = 2003,
         PARSER_UNCLOSED_PARENTHESES = 2004,
         PARSER_NON_VARIABLE_ASSIGNMENT = 2005,
+        PARSER_INVALID_FUNCTION_DEFINITION = 2006,
+        PARSER_INVALID_CONDITIONAL = 2007,
 
         OPTIMIZER_CODES_BEGIN = 3000,
         OPTIMIZER_FAILED_TO_OPTIMIZE_CHILD = 3001,
@@ -34,6 +40,19 @@ namespace expr {
         EVALUATOR_DIVISION_BY_ZERO = 4007,
         EVALUATOR_INVALID_NUMBER_LITERAL = 4008,
         EVALUATOR_WRONG_ARGUMENT_TYPE = 4009,
+        EVALUATOR_MISMATCHED_BATCH_SIZES = 4010,
+        EVALUATOR_CALL_DEPTH_EXCEEDED = 4011,
+        EVALUATOR_NOT_INLINED_FUNCTION = 4012,
+        EVALUATOR_UNREGISTERED_FUNCTION_DEFINITION = 4013,
+        EVALUATOR_BUILTIN_REDEFINITION = 4014,
+        EVALUATOR_UNSUPPORTED_ARRAY = 4015,
+        EVALUATOR_MISMATCHED_ARRAY_SIZES = 4016,
+        EVALUATOR_ARRAY_AS_SINGLE_VALUE = 4017,
+        EVALUATOR_EMPTY_REDUCTION = 4018,
+        EVALUATOR_UNSUPPORTED_SERIES = 4019,
+        EVALUATOR_INVALID_SERIES = 4020,
+        EVALUATOR_MISMATCHED_UNITS = 4021,
+        EVALUATOR_UNIT_OUT_OF_RANGE = 4022,
 
         DERIVATOR_CODES_BEGIN = 5000,
         DERIVATOR_GENERAL_ERROR = 5001,
@@ -46,12 +65,98 @@ namespace expr {
         QUANTITY_SCALAR_INTEGER_EXPECTED_AS_POWER = 6002,
         QUANTITY_EXPECTED_SAME_UNIT = 6003,
         QUANTITY_DIVISION_BY_ZERO = 6004,
+        QUANTITY_UNKNOWN_UNIT = 6005,
+        QUANTITY_UNEXPECTED_UNIT = 6006,
+        QUANTITY_NON_UNIFORM_UNIT = 6007,
+        QUANTITY_UNIT_OUT_OF_RANGE = 6008,
+
+        WORKSHEET_CODES_BEGIN = 7000,
+        WORKSHEET_NOT_AN_ASSIGNMENT = 7001,
+        WORKSHEET_CIRCULAR_DEPENDENCY = 7002,
+
+        TYPECHECKER_CODES_BEGIN = 8000,
+        TYPECHECKER_NON_CONSTANT_POWER = 8001,
+
+        INTERVAL_CODES_BEGIN = 9000,
+        INTERVAL_UNSUPPORTED_FUNCTION = 9001,
+
+        PLUGIN_CODES_BEGIN = 10000,
+        PLUGIN_FAILED_TO_LOAD = 10001,
+        PLUGIN_MISSING_ENTRY_POINT = 10002,
+        PLUGIN_INCOMPATIBLE_VERSION = 10003,
+        PLUGIN_INVALID_FUNCTION = 10004,
+    };
+
+    // Descriptions are formatted only when they are read, as most errors are
+    // wrapped or dropped before anyone does. The format has to be a string
+    // literal, in which "{0}", "{1}" and "{2}" stand for the arguments. Texts given
+    // as arguments are copied into the description, so descriptions never
+    // refer to the trees or tokens they were made from. Texts of up to 48
+    // bytes in total are kept within the description, longer ones in a
+    // buffer shared by its copies.
+    class description_t {
+    public:
+        static constexpr std::size_t max_arguments = 3;
+        static constexpr std::size_t max_text_length = 48;
+
+        class argument_t {
+        public:
+            argument_t(std::string_view text) noexcept;
+            argument_t(std::size_t number) noexcept;
+
+        private:
+            friend class description_t;
+
+            union {
+                std::string_view _text;
+                std::size_t _number;
+            };
+            bool _is_text;
+        };
+
+    public:
+        description_t(const char *format) noexcept :
+            _format(format),
+            _arguments{},
+            _texts{},
+            _long_texts(nullptr),
+            _text_arguments(0),
+            _argument_count(0)
+        {}
+
+        template <typename... Arguments>
+            requires (sizeof...(Arguments) > 0 && sizeof...(Arguments) <= max_arguments)
+        description_t(const char *format, const Arguments&... arguments) :
+            description_t(format)
+        {
+            const argument_t list[] = {argument_t(arguments)...};
+            store(list, sizeof...(Arguments));
+        }
+
+        std::string str() const;
+
+    private:
+        void store(const argument_t *arguments, std::size_t count);
+
+    private:
+        const char *_format;
+        union {
+            struct {
+                std::uint32_t offset;
+                std::uint32_t length;
+            } text;
+            std::size_t number;
+        } _arguments[max_arguments];
+        char _texts[max_text_length];
+        std::shared_ptr<const char[]> _long_texts;
+        std::uint8_t _text_arguments;
+        std::uint8_t _argument_count;
     };
 
     struct error {
         error_code code;
         location_t location;
-        std::string description;
+        description_t description;
     };
 
     template <typename Expected, typename Error>
@@ -62,17 +167,90 @@ namespace expr {
 
         static_assert(!std::is_convertible_v<value_type, error_type>);
 
+    private:
+        template <typename Other>
+        static constexpr bool is_error_v =
+            std::is_same_v<std::remove_cvref_t<Other>, error_type> ||
+            (std::is_convertible_v<Other, error_type> &&
+             !std::is_convertible_v<Other, value_type>);
+
+        static constexpr bool is_trivially_copyable_v =
+            std::is_trivially_copyable_v<value_type> &&
+            std::is_trivially_copyable_v<error_type>;
+
+        static constexpr bool is_copyable_v =
+            std::is_copy_constructible_v<value_type> &&
+            std::is_copy_constructible_v<error_type>;
+
+        static constexpr bool is_trivially_destructible_v =
+            std::is_trivially_destructible_v<value_type> &&
+            std::is_trivially_destructible_v<error_type>;
+
     public:
         template <typename Other>
-        result(Other&& other) : contents(std::forward<Other>(other)) {
+            requires (!std::is_same_v<std::remove_cvref_t<Other>, result>)
+        result(Other&& other) {
+            if constexpr (is_error_v<Other>) {
+                std::construct_at(&_error, std::forward<Other>(other));
+                _has_value = false;
+            } else {
+                std::construct_at(&_value, std::forward<Other>(other));
+                _has_value = true;
+            }
+        }
+
+        // Results of trivially copyable values and errors are copied as they
+        // are, everything else is copied by the alternative it holds.
+
+        result(const result&) requires is_trivially_copyable_v = default;
+        result(result&&) requires is_trivially_copyable_v = default;
+        result& operator=(const result&) requires is_trivially_copyable_v = default;
+        result& operator=(result&&) requires is_trivially_copyable_v = default;
+
+        result(const result& other)
+            requires (!is_trivially_copyable_v && is_copyable_v)
+        {
+            construct_from(other);
+        }
+
+        result(result&& other)
+            requires (!is_trivially_copyable_v)
+        {
+            construct_from(std::move(other));
+        }
+
+        result& operator=(const result& other)
+            requires (!is_trivially_copyable_v && is_copyable_v)
+        {
+            if (this != &other) {
+                destroy();
+                construct_from(other);
+            }
+            return *this;
+        }
+
+        result& operator=(result&& other)
+            requires (!is_trivially_copyable_v)
+        {
+            if (this != &other) {
+                destroy();
+                construct_from(std::move(other));
+            }
+            return *this;
+        }
+
+        ~result() requires is_trivially_destructible_v = default;
+
+        ~result() requires (!is_trivially_destructible_v) {
+            destroy();
         }
 
         bool has_value() const {
-            return value_ptr() != nullptr;
+            return _has_value;
         }
 
         bool has_error() const {
-            return error_ptr() != nullptr;
+            return !_has_value;
         }
 
         operator bool() const {
@@ -80,19 +258,19 @@ namespace expr {
         }
 
         value_type& value() {
-            return *value_ptr();
+            return _value;
         }
 
         const value_type& value() const {
-            return *value_ptr();
+            return _value;
         }
 
         error_type& error() {
-            return *error_ptr();
+            return _error;
         }
 
         const error_type& error() const {
-            return *error_ptr();
+            return _error;
         }
 
         value_type& operator*() {
@@ -104,33 +282,39 @@ namespace expr {
         }
 
         value_type * operator->() {
-            return value_ptr();
+            return &_value;
         }
 
         const value_type * operator->() const {
-            return value_ptr();
+            return &_value;
         }
 
     private:
-        const value_type * value_ptr() const {
-            return std::get_if<value_type>(&contents);
-        }
-
-        value_type * value_ptr() {
-            return std::get_if<value_type>(&contents);
-        }
-
-        const error_type * error_ptr() const {
-            return std::get_if<error_type>(&contents);
+        template <typename Other>
+        void construct_from(Other&& other) {
+            if (other._has_value)
+                std::construct_at(&_value, std::forward<Other>(other)._value);
+            else
+                std::construct_at(&_error, std::forward<Other>(other)._error);
+            _has_value = other._has_value;
         }
 
-        error_type * error_ptr() {
-            return std::get_if<error_type>(&contents);
+        void destroy() {
+            if (_has_value)
+                std::destroy_at(&_value);
+            else
+                std::destroy_at(&_error);
         }
 
     private:
-        std::variant<value_type, error_type> contents;
+        union {
+            value_type _value;
+            error_type _error;
+        };
+        bool _has_value;
     };
 }
 
+std::ostream& operator<<(std::ostream& stream, const expr::description_t& description);
+
 #endif
@@ -0,0 +1,69 @@
+#if !defined(EXPRPARSER_SERIES_HEADER)
+#define EXPRPARSER_SERIES_HEADER
+
+#include "evaluator.h"
+#include "functions.h"
+#include "node.h"
+#include "result.h"
+
+#include <cstddef>          // std::size_t
+#include <cstdint>          // std::int64_t
+
+namespace expr {
+    // Sums and products of a body over a range of integers, like
+    // `sum(k, 1, 10, k ^ 2)`, are calls of sum() or prod() with four
+    // arguments: the index variable, the first and the last index, and the
+    // body. Like the reductions, they are not part of the function tables,
+    // functions of the same name hide them.
+    bool is_series(const node_t& node);
+
+    // The error of the evaluators which only evaluate expressions without
+    // series.
+    error make_unsupported_series_error(const node_ptr& node);
+
+    struct series_range {
+        std::int64_t first;
+        std::int64_t last;
+    };
+
+    using series_range_result = result<series_range, error>;
+
+    // Series of more indices than this are rejected, rather than evaluated for
+    // hours.
+    static constexpr std::int64_t series_max_length = std::int64_t(1) << 32;
+
+    // Validates the index of a series, and evaluates its bounds, which have
+    // to be scalar integers at most series_max_length indices apart.
+    series_range_result evaluate_series_range(
+        const node_ptr& node,
+        symbol_table& symbols,
+        const function_table& functions
+    );
+
+    // Terms are accumulated in chunks of this many indices, and the chunks
+    // are combined in order as they are done, so the result does not depend
+    // on how many threads the chunks were split across.
+    static constexpr std::size_t series_chunk_size = 4096;
+
+    // Ranges with fewer indices than this are not worth splitting across
+    // threads.
+    static constexpr std::size_t series_parallel_threshold = 16 * series_chunk_size;
+
+    // Evaluates a series as the sum or product of the body for every index,
+    // in order, so the units of the terms are checked the way they would be
+    // if the series was written out. An empty range gives 0 or 1. The index
+    // hides the variable of the same name while the body is evaluated, and
+    // the body never modifies the symbol table.
+    //
+    // The body is compiled once, with the index bound to a slot of its
+    // context. Subexpressions of the body which do not depend on the index are
+    // evaluated once before the loop. Bodies calling only pure functions have
+    // large ranges split across threads.
+    evaluator_result evaluate_series(
+        const node_ptr& node,
+        symbol_table& symbols,
+        const function_table& functions
+    );
+}
+
+#endif
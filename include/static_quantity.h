@@ -0,0 +1,188 @@
+#if !defined(EXPRPARSER_STATIC_QUANTITY_HEADER)
+#define EXPRPARSER_STATIC_QUANTITY_HEADER
+
+#include "quantity.h"
+#include "result.h"
+
+#include <cmath>            // std::fmod
+#include <compare>          // std::partial_ordering
+
+namespace expr {
+    // A quantity whose unit is part of its type, for code around the
+    // evaluation: operators combine units at compile time, and adding
+    // quantities of different units does not compile. It holds nothing but
+    // its value, so it costs as much as a plain number. Units are only checked
+    // where it is converted from a quantity.
+    template <measurement_unit Unit, typename T = double>
+    struct static_quantity {
+        static constexpr int length_dimension = Unit.length_dimension();
+        static constexpr int angle_dimension = Unit.angle_dimension();
+
+        T value;
+
+        constexpr static_quantity() = default;
+
+        constexpr explicit static_quantity(T value) :
+            value(value)
+        {}
+
+        // Scalars are plain numbers.
+        constexpr operator T() const
+            requires (Unit == measurement_unit{})
+        {
+            return value;
+        }
+
+        static constexpr measurement_unit unit() {
+            return Unit;
+        }
+
+        static constexpr int exponent(dimension_t dimension) {
+            return Unit.exponent(dimension);
+        }
+
+        constexpr basic_quantity<T> to_quantity() const {
+            return basic_quantity<T>{unit(), value};
+        }
+
+        static result<static_quantity, error> from_quantity(basic_quantity<T> quantity) {
+            if (quantity.unit != unit()) {
+                return error{
+                    .code = error_code::QUANTITY_UNEXPECTED_UNIT,
+                    .location = {},
+                    .description = "Unexpected unit."
+                };
+            }
+            return static_quantity(quantity.value);
+        }
+
+        constexpr static_quantity operator+() const {
+            return *this;
+        }
+
+        constexpr static_quantity operator-() const {
+            return static_quantity(-value);
+        }
+
+        constexpr static_quantity& operator+=(static_quantity other) {
+            value += other.value;
+            return *this;
+        }
+
+        constexpr static_quantity& operator-=(static_quantity other) {
+            value -= other.value;
+            return *this;
+        }
+
+        constexpr static_quantity& operator*=(T factor) {
+            value *= factor;
+            return *this;
+        }
+
+        constexpr static_quantity& operator/=(T divisor) {
+            value /= divisor;
+            return *this;
+        }
+
+        friend constexpr static_quantity operator+(static_quantity lhs, static_quantity rhs) {
+            return static_quantity(lhs.value + rhs.value);
+        }
+
+        friend constexpr static_quantity operator-(static_quantity lhs, static_quantity rhs) {
+            return static_quantity(lhs.value - rhs.value);
+        }
+
+        friend constexpr static_quantity operator%(static_quantity lhs, static_quantity rhs) {
+            return static_quantity(std::fmod(lhs.value, rhs.value));
+        }
+
+        friend constexpr bool operator==(static_quantity, static_quantity) = default;
+
+        friend constexpr std::partial_ordering operator<=>(
+            static_quantity lhs,
+            static_quantity rhs
+        ) {
+            return lhs.value <=> rhs.value;
+        }
+    };
+
+    // Products and quotients, with their units. Like the IEEE policy, dividing
+    // by zero gives an infinity rather than an error. Units with an exponent
+    // out of [-128, 127] do not compile.
+    template <measurement_unit U1, measurement_unit U2, typename T>
+        requires (U1.multiply(U2).has_value())
+    constexpr auto operator*(static_quantity<U1, T> lhs, static_quantity<U2, T> rhs) {
+        return static_quantity<*U1.multiply(U2), T>(lhs.value * rhs.value);
+    }
+
+    template <measurement_unit U1, measurement_unit U2, typename T>
+        requires (U1.divide(U2).has_value())
+    constexpr auto operator/(static_quantity<U1, T> lhs, static_quantity<U2, T> rhs) {
+        return static_quantity<*U1.divide(U2), T>(lhs.value / rhs.value);
+    }
+
+    template <measurement_unit U, typename T>
+    constexpr auto operator*(static_quantity<U, T> lhs, T factor) {
+        return static_quantity<U, T>(lhs.value * factor);
+    }
+
+    template <measurement_unit U, typename T>
+    constexpr auto operator*(T factor, static_quantity<U, T> rhs) {
+        return static_quantity<U, T>(factor * rhs.value);
+    }
+
+    template <measurement_unit U, typename T>
+    constexpr auto operator/(static_quantity<U, T> lhs, T divisor) {
+        return static_quantity<U, T>(lhs.value / divisor);
+    }
+
+    template <measurement_unit U, typename T>
+        requires (measurement_unit{}.divide(U).has_value())
+    constexpr auto operator/(T dividend, static_quantity<U, T> rhs) {
+        return static_quantity<*measurement_unit{}.divide(U), T>(dividend / rhs.value);
+    }
+
+    // Powers need their exponent at compile time, as the unit of the result
+    // depends on it.
+    template <int Exponent, measurement_unit U, typename T>
+        requires (U.power(Exponent).has_value())
+    constexpr auto pow(static_quantity<U, T> base) {
+        T value = 1;
+        for (int i = 0; i < (Exponent < 0 ? -Exponent : Exponent); ++i)
+            value *= base.value;
+        if constexpr (Exponent < 0)
+            value = 1 / value;
+        return static_quantity<*U.power(Exponent), T>(value);
+    }
+
+    template <typename T = double>
+    using static_scalar = static_quantity<measurement_unit{}, T>;
+
+    template <typename T = double>
+    using static_length = static_quantity<measurement_unit{1, 0}, T>;
+
+    template <typename T = double>
+    using static_area = static_quantity<measurement_unit{2, 0}, T>;
+
+    template <typename T = double>
+    using static_volume = static_quantity<measurement_unit{3, 0}, T>;
+
+    template <typename T = double>
+    using static_angle = static_quantity<measurement_unit{0, 1}, T>;
+
+    template <typename T = double>
+    using static_mass = static_quantity<measurement_unit::of(dimension_t::MASS, 1), T>;
+
+    template <typename T = double>
+    using static_time = static_quantity<measurement_unit::of(dimension_t::TIME, 1), T>;
+
+    template <typename T = double>
+    using static_temperature =
+        static_quantity<measurement_unit::of(dimension_t::TEMPERATURE, 1), T>;
+
+    template <typename T = double>
+    using static_currency =
+        static_quantity<measurement_unit::of(dimension_t::CURRENCY, 1), T>;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#if !defined(EXPRPARSER_THREAD_POOL_HEADER)
+#define EXPRPARSER_THREAD_POOL_HEADER
+
+#include "context.h"
+
+#include <atomic>           // std::atomic
+#include <condition_variable> // std::condition_variable
+#include <cstddef>          // std::size_t
+#include <deque>            // std::deque
+#include <functional>       // std::function
+#include <memory>           // std::unique_ptr
+#include <mutex>            // std::mutex
+#include <thread>           // std::thread
+#include <vector>           // std::vector
+
+namespace expr {
+    // A work-stealing thread pool. Every worker has its own queue: tasks
+    // submitted by a worker go to the back of its own queue, and it takes
+    // its next task from the back as well, so related tasks stay on the same
+    // core. Idle workers steal from the front of the other queues.
+    class thread_pool final {
+    public:
+        using task_t = std::function<void()>;
+
+        static constexpr std::size_t no_worker = std::size_t(-1);
+
+        explicit thread_pool(std::size_t threads = 0);
+        ~thread_pool();
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        std::size_t size() const noexcept;
+        std::size_t current_worker() const noexcept;
+
+        void submit(task_t task);
+        bool run_pending_task();
+
+    private:
+        struct alignas(cache_line_size) worker_queue {
+            std::mutex mutex;
+            std::deque<task_t> tasks;
+        };
+
+    private:
+        void work(std::size_t index);
+        bool take(std::size_t index, task_t& task);
+        bool steal(std::size_t thief, task_t& task);
+
+    private:
+        std::vector<std::unique_ptr<worker_queue>> _queues;
+        std::vector<std::thread> _threads;
+        std::atomic<std::size_t> _queued;
+        std::atomic<std::size_t> _next_queue;
+        std::mutex _sleep_mutex;
+        std::condition_variable _wakeup;
+        bool _stopping;
+    };
+
+    // Tracks a set of tasks submitted to a pool. Waiting for them does not
+    // block a worker: it keeps executing pending tasks of the pool meanwhile,
+    // so task groups can be nested.
+    class task_group final {
+    public:
+        explicit task_group(thread_pool& pool);
+        ~task_group();
+
+        task_group(const task_group&) = delete;
+        task_group& operator=(const task_group&) = delete;
+
+        void run(thread_pool::task_t task);
+        void wait();
+
+    private:
+        thread_pool& _pool;
+        std::atomic<std::size_t> _pending;
+    };
+}
+
+#endif
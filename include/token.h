@@ -20,8 +20,16 @@ namespace expr {
             CARET,
             OPENING_PARENTHESIS,
             CLOSING_PARENTHESIS,
+            OPENING_BRACKET,
+            CLOSING_BRACKET,
             COMMA,
             EQUAL_SIGN,
+            LESS_THAN,
+            LESS_THAN_OR_EQUAL,
+            GREATER_THAN,
+            GREATER_THAN_OR_EQUAL,
+            DOUBLE_EQUAL_SIGN,
+            NOT_EQUAL_SIGN,
             UNIT
         };
 
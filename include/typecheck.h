@@ -0,0 +1,74 @@
+#if !defined(EXPRPARSER_TYPECHECK_HEADER)
+#define EXPRPARSER_TYPECHECK_HEADER
+
+#include "compiler.h"
+#include "evaluator.h"
+#include "functions.h"
+#include "policy.h"
+#include "quantity.h"
+#include "result.h"
+
+#include <cstddef>          // std::size_t
+#include <cstdint>          // std::uint32_t
+#include <optional>         // std::optional
+#include <span>             // std::span
+#include <string>           // std::string
+#include <unordered_map>    // std::unordered_map
+#include <vector>           // std::vector
+
+namespace expr {
+    using dimension_table = std::unordered_map<std::string, measurement_unit>;
+
+    struct typed_call_t {
+        const function_definition_t *definition;
+        std::uint32_t arity;
+        std::vector<measurement_unit> units;
+    };
+
+    // A compiled expression whose units are all known before it is evaluated,
+    // so it is evaluated on plain numbers. Values are given in the base unit
+    // of their dimension, that is meters and radians. Its instructions are the
+    // ones of the compiled expression, with call sites replaced by typed call
+    // sites, which keep the units of their arguments for the functions.
+    struct typed_expression {
+        std::vector<instruction_t> instructions;
+        std::vector<double> constants;
+        std::vector<std::string> variables;
+        std::vector<measurement_unit> units;
+        std::vector<typed_call_t> calls;
+        std::size_t stack_size;
+        std::size_t root;
+        std::optional<error> failure;
+
+        // The unit of the result.
+        measurement_unit unit;
+    };
+
+    using typecheck_result = result<typed_expression, error>;
+
+    dimension_table dimensions_of(const symbol_table& symbols);
+
+    // Infers the unit of every instruction, and reports the errors the
+    // evaluation would run into because of units. Variables read before they
+    // are assigned have to be declared with their unit. Expressions checked
+    // with the IEEE policy are meant to be evaluated with it, as they may
+    // contain powers the checked policy rejects. Instantiated for the checked
+    // and the IEEE policy.
+    template <evaluation_policy Policy = checked_policy>
+    typecheck_result typecheck(
+        const compiled_expression& expression,
+        const dimension_table& dimensions
+    );
+
+    // The variables are given by their slot, in the order of the variables of
+    // the expression. Only division by zero, non-integer powers and failures
+    // of functions are left to be reported, and with the IEEE policy only the
+    // failures of functions. Instantiated for the checked and the IEEE policy.
+    template <evaluation_policy Policy = checked_policy>
+    evaluator_result evaluate(
+        const typed_expression& expression,
+        std::span<double> variables
+    );
+}
+
+#endif
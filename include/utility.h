@@ -2,12 +2,101 @@
 #define EXPRPARSER_UTILITY_HEADER
 
 #include <cfloat>           // DBL_EPSILON
-#include <cmath>            // std::fabs
+#include <cmath>            // std::fabs, std::pow
+#include <cstdint>          // std::int64_t, INT64_MIN
+#include <optional>         // std::optional
 
 namespace expr {
     inline bool is_near(double lhs, double rhs) noexcept {
         return std::fabs(lhs - rhs) <= DBL_EPSILON;
     }
+
+    // Integers up to 2^53 are exactly representable by a double, so a double
+    // in that range is taken to be exact, if it is integral.
+    static constexpr double max_exact_integer = 9007199254740992.0;
+
+    template <typename T>
+    inline std::optional<std::int64_t> exact_integer(T value) noexcept {
+        if (!(std::fabs(value) <= max_exact_integer))
+            return std::nullopt;
+        const auto integer = std::int64_t(value);
+        if (T(integer) != value)
+            return std::nullopt;
+        return integer;
+    }
+
+    // Computes the power by squaring, if it fits into 64 bits.
+    inline std::optional<std::int64_t> checked_power(
+        std::int64_t base,
+        std::int64_t exponent
+    ) noexcept {
+        if (exponent < 0)
+            return std::nullopt;
+
+        std::int64_t result = 1;
+        while (true) {
+            if ((exponent & 1) && __builtin_mul_overflow(result, base, &result))
+                return std::nullopt;
+            exponent >>= 1;
+            if (exponent == 0)
+                return result;
+            if (__builtin_mul_overflow(base, base, &base))
+                return std::nullopt;
+        }
+    }
+
+    // The result of an arithmetic operator (one of "+-*/%^") on integers, if
+    // it is an integer that fits into 64 bits.
+    inline std::optional<std::int64_t> exact_operation(
+        char operation,
+        std::int64_t lhs,
+        std::int64_t rhs
+    ) noexcept {
+        std::int64_t result;
+        switch (operation) {
+            case '+':
+                if (__builtin_add_overflow(lhs, rhs, &result))
+                    return std::nullopt;
+                return result;
+            case '-':
+                if (__builtin_sub_overflow(lhs, rhs, &result))
+                    return std::nullopt;
+                return result;
+            case '*':
+                if (__builtin_mul_overflow(lhs, rhs, &result))
+                    return std::nullopt;
+                return result;
+            case '/':
+                if (rhs == 0 || (lhs == INT64_MIN && rhs == -1) || lhs % rhs != 0)
+                    return std::nullopt;
+                return lhs / rhs;
+            case '%':
+                if (rhs == 0 || rhs == -1)
+                    return std::nullopt;
+                return lhs % rhs;
+            case '^':
+                return checked_power(lhs, rhs);
+            default:
+                return std::nullopt;
+        }
+    }
+
+    // Integer powers of integers are computed exactly, by squaring, as long
+    // as they fit into 64 bits. Squares are a single multiplication, which is
+    // rounded once. Any other power is left to std::pow(), which is more
+    // precise than repeated multiplication.
+    template <typename T>
+    inline T raise(T base, T exponent) noexcept {
+        if (auto integral_exponent = exact_integer(exponent)) {
+            if (auto integral_base = exact_integer(base)) {
+                if (auto result = checked_power(*integral_base, *integral_exponent))
+                    return T(*result);
+            }
+            if (*integral_exponent == 2)
+                return base * base;
+        }
+        return std::pow(base, exponent);
+    }
 }
 
 #endif
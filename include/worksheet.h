@@ -0,0 +1,107 @@
+#if !defined(EXPRPARSER_WORKSHEET_HEADER)
+#define EXPRPARSER_WORKSHEET_HEADER
+
+#include "evaluator.h"
+#include "functions.h"
+#include "node.h"
+#include "quantity.h"
+#include "result.h"
+
+#include <optional>         // std::optional
+#include <string>           // std::string
+#include <unordered_map>    // std::unordered_map
+#include <utility>          // std::pair
+#include <vector>           // std::vector
+
+namespace expr {
+    struct worksheet_update {
+        // The variables whose value changed, in the order they were computed.
+        std::vector<std::string> changed;
+
+        // The formulas that failed to evaluate. Their variables are undefined
+        // until they can be evaluated again.
+        std::vector<std::pair<std::string, error>> failures;
+    };
+
+    using worksheet_result = result<worksheet_update, error>;
+
+    // Keeps assignments as formulas, like the cells of a spreadsheet. When a
+    // variable changes, only the formulas depending on it, directly or
+    // indirectly, are evaluated again, in topological order. A formula whose
+    // value did not change does not cause its dependents to be evaluated.
+    // Formulas depend on the variables read by the user functions they call
+    // as well, since those are the variables of the caller. Variables neither
+    // set nor defined are asked from the resolver, if any, when a formula
+    // first reads them, and are kept as constants from then on.
+    class worksheet final {
+    public:
+        explicit worksheet(
+            const function_table& functions,
+            symbol_table inputs = {},
+            variable_resolver resolver = {}
+        );
+
+        // Sets a variable to a constant value, replacing its formula if any.
+        worksheet_result set(const std::string& name, quantity value);
+
+        // Sets a variable to the value of an expression, which is kept up to
+        // date from now on. A formula referring to its own variable is only
+        // evaluated once, using the previous value, like in `x = x + 1`.
+        worksheet_result define(const std::string& name, node_ptr&& expression);
+
+        // Defines a formula from an assignment tree.
+        worksheet_result assign(node_ptr&& assignment);
+
+        // Evaluates the formulas calling a user function again, directly or
+        // through other functions, after the function was (re)defined in the
+        // function table of the worksheet.
+        worksheet_result redefine(const std::string& function);
+
+        const symbol_table& symbols() const noexcept;
+        bool is_formula(const std::string& name) const;
+
+    private:
+        struct formula_t {
+            node_ptr expression;
+            std::vector<std::string> dependencies;
+        };
+
+    private:
+        std::vector<std::string> dependencies_of(const node_ptr& expression) const;
+        bool is_self_referencing(
+            const std::string& name,
+            const std::vector<std::string>& dependencies
+        ) const;
+        std::optional<error> find_cycle(
+            const std::string& name,
+            const std::vector<std::string>& dependencies,
+            const location_t& location
+        ) const;
+
+        void link(
+            const std::string& name,
+            const std::vector<std::string>& dependencies
+        );
+        void unlink(const std::string& name);
+        bool depends_on(
+            const std::string& name,
+            const std::string& dependency
+        ) const;
+
+        bool store(
+            const std::string& name,
+            evaluator_result&& value,
+            worksheet_update& update
+        );
+        void propagate(const std::string& origin, worksheet_update& update);
+
+    private:
+        const function_table& _functions;
+        variable_resolver _resolver;
+        symbol_table _values;
+        std::unordered_map<std::string, formula_t> _formulas;
+        std::unordered_map<std::string, std::vector<std::string>> _dependents;
+    };
+}
+
+#endif
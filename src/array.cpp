@@ -0,0 +1,683 @@
+#include "array.h"
+#include "optimizer.h"
+#include "series.h"
+
+#include <algorithm>        // std::count_if
+#include <array>            // std::array
+#include <cstdint>          // SIZE_MAX
+#include <limits>           // std::numeric_limits
+#include <optional>         // std::optional
+#include <vector>           // std::vector
+
+// Partial results are kept in independent lanes, so the loops can be
+// vectorized without the compiler having to reorder floating-point operations
+// on its own.
+static constexpr std::size_t reduction_lanes = 8;
+
+template <typename Step>
+static double reduce(std::span<const double> values, double initial, Step step) {
+    std::array<double, reduction_lanes> lanes;
+    lanes.fill(initial);
+
+    const auto count = values.size();
+    const auto whole = count - count % reduction_lanes;
+    const double *data = values.data();
+    for (std::size_t i = 0; i < whole; i += reduction_lanes) {
+        for (std::size_t j = 0; j < reduction_lanes; ++j)
+            lanes[j] = step(lanes[j], data[i + j]);
+    }
+    for (std::size_t i = whole; i < count; ++i)
+        lanes[0] = step(lanes[0], data[i]);
+
+    auto result = initial;
+    for (const auto lane : lanes)
+        result = step(result, lane);
+    return result;
+}
+
+static constexpr auto add = [](double lhs, double rhs) {
+    return lhs + rhs;
+};
+
+static constexpr auto multiply = [](double lhs, double rhs) {
+    return lhs * rhs;
+};
+
+static constexpr auto minimum = [](double lhs, double rhs) {
+    return rhs < lhs ? rhs : lhs;
+};
+
+static constexpr auto maximum = [](double lhs, double rhs) {
+    return rhs > lhs ? rhs : lhs;
+};
+
+static expr::error empty_reduction(const char *name) {
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_EMPTY_REDUCTION,
+        .location = {},
+        .description = {"Reduction '{0}()' of an empty array.", name}
+    };
+}
+
+using reduction_t = expr::arithmetic_result (*)(std::span<const expr::array_view>);
+
+static expr::arithmetic_result reduce_sum(std::span<const expr::array_view> arguments) {
+    const auto& values = arguments[0].values;
+    return expr::quantity{arguments[0].unit, reduce(values, 0.0, add)};
+}
+
+static expr::arithmetic_result reduce_product(std::span<const expr::array_view> arguments) {
+    const auto& values = arguments[0].values;
+    const auto unit = expr::power_unit(arguments[0].unit, double(values.size()));
+    if (!unit)
+        return unit.error();
+    return expr::quantity{*unit, reduce(values, 1.0, multiply)};
+}
+
+static expr::arithmetic_result reduce_minimum(std::span<const expr::array_view> arguments) {
+    const auto& values = arguments[0].values;
+    if (values.empty())
+        return empty_reduction("min");
+    const auto infinity = std::numeric_limits<double>::infinity();
+    return expr::quantity{arguments[0].unit, reduce(values, infinity, minimum)};
+}
+
+static expr::arithmetic_result reduce_maximum(std::span<const expr::array_view> arguments) {
+    const auto& values = arguments[0].values;
+    if (values.empty())
+        return empty_reduction("max");
+    const auto infinity = std::numeric_limits<double>::infinity();
+    return expr::quantity{arguments[0].unit, reduce(values, -infinity, maximum)};
+}
+
+static expr::arithmetic_result reduce_mean(std::span<const expr::array_view> arguments) {
+    const auto& values = arguments[0].values;
+    if (values.empty())
+        return empty_reduction("mean");
+    const auto sum = reduce(values, 0.0, add);
+    return expr::quantity{arguments[0].unit, sum / double(values.size())};
+}
+
+static expr::arithmetic_result reduce_dot(std::span<const expr::array_view> arguments) {
+    const auto& lhs = arguments[0].values;
+    const auto& rhs = arguments[1].values;
+    const auto product = expr::multiply_unit(arguments[0].unit, arguments[1].unit);
+    if (!product)
+        return product.error();
+    const auto unit = *product;
+
+    // A single value multiplies every value of the other array.
+    if (lhs.size() == 1 && rhs.size() != 1)
+        return expr::quantity{unit, lhs[0] * reduce(rhs, 0.0, add)};
+    if (rhs.size() == 1 && lhs.size() != 1)
+        return expr::quantity{unit, rhs[0] * reduce(lhs, 0.0, add)};
+
+    std::array<double, reduction_lanes> lanes = {};
+    const auto count = lhs.size();
+    const auto whole = count - count % reduction_lanes;
+    const double *left = lhs.data();
+    const double *right = rhs.data();
+    for (std::size_t i = 0; i < whole; i += reduction_lanes) {
+        for (std::size_t j = 0; j < reduction_lanes; ++j)
+            lanes[j] += left[i + j] * right[i + j];
+    }
+    for (std::size_t i = whole; i < count; ++i)
+        lanes[0] += left[i] * right[i];
+
+    auto result = 0.0;
+    for (const auto lane : lanes)
+        result += lane;
+    return expr::quantity{unit, result};
+}
+
+struct reduction_definition_t {
+    reduction_t reduction;
+    std::size_t arity;
+};
+
+static const std::unordered_map<std::string_view, reduction_definition_t>& reductions() {
+    static const auto table = std::unordered_map<std::string_view, reduction_definition_t>{
+        {"sum", {reduce_sum, 1}},
+        {"prod", {reduce_product, 1}},
+        {"min", {reduce_minimum, 1}},
+        {"max", {reduce_maximum, 1}},
+        {"mean", {reduce_mean, 1}},
+        {"dot", {reduce_dot, 2}},
+    };
+    return table;
+}
+
+bool expr::is_reduction(std::string_view name) {
+    return reductions().contains(name);
+}
+
+expr::error expr::make_unsupported_array_error(const expr::node_ptr& node) {
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_UNSUPPORTED_ARRAY,
+        .location = node->location,
+        .description = "Arrays are only supported by the tree and array "
+                       "evaluators."
+    };
+}
+
+class array_evaluator_impl final {
+public:
+    array_evaluator_impl(
+        expr::symbol_table& symbols,
+        const expr::array_table& arrays,
+        const expr::function_table& functions
+    );
+
+    expr::array_result evaluate(const expr::node_ptr& node);
+
+private:
+    using array_t = expr::quantity_column;
+    using view_result = expr::result<expr::array_view, expr::error>;
+
+private:
+    expr::array_result evaluate_binary_operator(const expr::node_ptr& node);
+    expr::array_result evaluate_unary_operator(const expr::node_ptr& node);
+    expr::array_result evaluate_number_literal(const expr::node_ptr& node);
+    expr::array_result evaluate_unit_application(const expr::node_ptr& node);
+    expr::array_result evaluate_variable_reference(const expr::node_ptr& node);
+    expr::array_result evaluate_function_call(const expr::node_ptr& node);
+    expr::array_result evaluate_reduction(const expr::node_ptr& node);
+    expr::array_result evaluate_assignment(const expr::node_ptr& node);
+    expr::array_result evaluate_array_literal(const expr::node_ptr& node);
+    expr::array_result evaluate_conditional(const expr::node_ptr& node);
+
+    // Arrays of the table are read in place, instead of being copied into an
+    // array of their own first.
+    view_result evaluate_view(const expr::node_ptr& node, array_t& storage);
+
+private:
+    expr::symbol_table& _symbols;
+    const expr::array_table& _arrays;
+    const expr::function_table& _functions;
+};
+
+static expr::quantity_column make_single(expr::quantity value) {
+    return expr::quantity_column{value.unit, std::vector<double>{value.value}};
+}
+
+static expr::error failed_arguments(const expr::node_ptr& node) {
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+        .location = node->location,
+        .description = {
+            "Failed to evaluate function arguments for '{0}()'.",
+            node->content
+        }
+    };
+}
+
+static expr::error single_value_expected(
+    const expr::location_t& location,
+    std::size_t size
+) {
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_ARRAY_AS_SINGLE_VALUE,
+        .location = location,
+        .description = {"An array of {0} values can't be used as a single value.", size}
+    };
+}
+
+// Operands of the same size are combined value by value, and single values
+// with every value of the other operands. Gives the size of the result, if
+// the sizes fit.
+static std::optional<std::size_t> combined_size(std::size_t lhs, std::size_t rhs) {
+    if (lhs == rhs || rhs == 1)
+        return lhs;
+    if (lhs == 1)
+        return rhs;
+    return std::nullopt;
+}
+
+static expr::error mismatched_sizes(
+    const expr::location_t& location,
+    std::size_t lhs,
+    std::size_t rhs
+) {
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_MISMATCHED_ARRAY_SIZES,
+        .location = location,
+        .description = {"Arrays of {0} and {1} values can't be combined.", lhs, rhs}
+    };
+}
+
+array_evaluator_impl::array_evaluator_impl(
+    expr::symbol_table& symbols,
+    const expr::array_table& arrays,
+    const expr::function_table& functions
+) :
+    _symbols(symbols),
+    _arrays(arrays),
+    _functions(functions)
+{}
+
+expr::array_result array_evaluator_impl::evaluate_binary_operator(
+    const expr::node_ptr& node
+) {
+    using binary_operator = expr::column_error (*)(
+        const expr::quantity_column&,
+        const expr::quantity_column&,
+        expr::quantity_column&
+    );
+    static const std::unordered_map<std::string, binary_operator> binary = {
+        {"+", expr::columns::add},
+        {"-", expr::columns::subtract},
+        {"*", expr::columns::multiply},
+        {"/", expr::columns::divide},
+        {"%", expr::columns::modulo},
+        {"^", expr::columns::power},
+        {"<", expr::columns::less},
+        {"<=", expr::columns::less_equal},
+        {">", expr::columns::greater},
+        {">=", expr::columns::greater_equal},
+        {"==", expr::columns::equal},
+        {"!=", expr::columns::not_equal},
+    };
+
+    auto left = evaluate(node->children[0]);
+    auto right = evaluate(node->children[1]);
+    if (!left || !right) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+            .location = node->location,
+            .description = "Failed to evaluate operand."
+        };
+    }
+
+    if (!combined_size(left->size(), right->size()))
+        return mismatched_sizes(node->location, left->size(), right->size());
+
+    const auto operator_fn = binary.at(node->content);
+    if (auto error = operator_fn(*left, *right, *left)) {
+        // HACK: The quantity class dictates the error, but the evaluator has
+        //       source location.
+        error->code = expr::operator_error_code(error->code);
+        error->location = node->children[1]->location;
+        return std::move(*error);
+    }
+    return left;
+}
+
+expr::array_result array_evaluator_impl::evaluate_unary_operator(
+    const expr::node_ptr& node
+) {
+    auto operand = evaluate(node->children[0]);
+    if (!operand) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+            .location = node->location,
+            .description = "Failed to evaluate operand."
+        };
+    }
+
+    if (node->content == "-") {
+        for (auto& value : operand->values)
+            value = -value;
+    }
+    return operand;
+}
+
+expr::array_result array_evaluator_impl::evaluate_number_literal(
+    const expr::node_ptr& node
+) {
+    const auto value = expr::evaluate_parse_time(node);
+    if (!value)
+        return value.error();
+    return make_single(*value);
+}
+
+expr::array_result array_evaluator_impl::evaluate_unit_application(
+    const expr::node_ptr& node
+) {
+    auto subexpression = evaluate(node->children[0]);
+    if (!subexpression)
+        return subexpression;
+
+    const auto factor = expr::make_unit(node->children[1]->content);
+    if (!factor)
+        return factor.error();
+
+    const auto unit = expr::multiply_unit(subexpression->unit, factor->unit);
+    if (!unit)
+        return unit.error();
+
+    subexpression->unit = *unit;
+    for (auto& value : subexpression->values)
+        value *= factor->value;
+    return subexpression;
+}
+
+expr::array_result array_evaluator_impl::evaluate_variable_reference(
+    const expr::node_ptr& node
+) {
+    if (auto where = _arrays.find(node->content); where != _arrays.end()) {
+        const auto& array = where->second;
+        return array_t{
+            array.unit,
+            std::vector<double>(array.values.begin(), array.values.end())
+        };
+    }
+
+    if (auto value = expr::find_variable(node->content, _symbols))
+        return make_single(*value);
+
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_UNDEFINED_VARIABLE,
+        .location = node->location,
+        .description = {"Undefined variable '{0}'.", node->content}
+    };
+}
+
+expr::array_result array_evaluator_impl::evaluate_function_call(
+    const expr::node_ptr& node
+) {
+    auto where = _functions.find(node->content);
+    if (where == _functions.end()) {
+        // The terms of a series are single values, so they can't refer to
+        // the arrays of the table.
+        if (expr::is_series(*node)) {
+            auto result = expr::evaluate_series(node, _symbols, _functions);
+            if (!result)
+                return std::move(result.error());
+            return make_single(*result);
+        }
+        if (expr::is_reduction(node->content))
+            return evaluate_reduction(node);
+
+        const auto& location = node->location.begin;
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_UNDEFINED_FUNCTION,
+            .location = expr::location_t{
+                .begin = location,
+                .end = location + node->content.length() - 1
+            },
+            .description = {"Undefined function '{0}'.", node->content}
+        };
+    }
+
+    const auto& definition = where->second;
+    const auto count = node->children.size();
+    if (auto error = expr::validate_argument_count(definition, count, node->location))
+        return std::move(*error);
+
+    std::vector<array_t> arguments;
+    arguments.reserve(count);
+    std::size_t size = 1;
+    for (const auto& child : node->children) {
+        auto argument = evaluate(child);
+        if (!argument)
+            return failed_arguments(node);
+
+        const auto combined = combined_size(size, argument->size());
+        if (!combined)
+            return mismatched_sizes(node->location, size, argument->size());
+        size = *combined;
+        arguments.push_back(std::move(*argument));
+    }
+
+    // Functions decide the unit of their result, and whether the call is
+    // valid, from the units of their arguments only, so the first row checks
+    // every row. Empty arrays are checked with values of one.
+    std::vector<expr::quantity> row(count);
+    auto fetch_row = [&](std::size_t i) {
+        for (std::size_t j = 0; j < count; ++j) {
+            const auto& argument = arguments[j];
+            const auto value = argument.values.empty() ? 1.0
+                             : argument.values[argument.size() == 1 ? 0 : i];
+            row[j] = expr::quantity{argument.unit, value};
+        }
+    };
+
+    fetch_row(0);
+    const auto first = expr::invoke(definition, row, node->location);
+    if (!first)
+        return first.error();
+
+    auto result = array_t{first->unit, std::vector<double>(size)};
+    if (size == 0)
+        return result;
+
+    if (definition.batch_implementation != nullptr) {
+        // Kernels read every argument value by value, so single values are
+        // repeated first.
+        std::vector<const double *> pointers;
+        pointers.reserve(count);
+        for (auto& argument : arguments) {
+            if (argument.size() != size)
+                argument.values.resize(size, argument.values[0]);
+            pointers.push_back(argument.values.data());
+        }
+
+        definition.batch_implementation(pointers.data(), result.values.data(), size);
+        return result;
+    }
+
+    result.values[0] = first->value;
+    for (std::size_t i = 1; i < size; ++i) {
+        fetch_row(i);
+        const auto value = expr::invoke(definition, row, node->location);
+        if (!value)
+            return value.error();
+        result.values[i] = value->value;
+    }
+    return result;
+}
+
+expr::array_result array_evaluator_impl::evaluate_reduction(
+    const expr::node_ptr& node
+) {
+    const auto& definition = reductions().at(node->content);
+    const auto count = node->children.size();
+    if (count != definition.arity) {
+        return expr::error{
+            expr::error_code::EVALUATOR_WRONG_ARGUMENT_COUNT,
+            node->location,
+            {"{0} argument(s) expected.", definition.arity}
+        };
+    }
+
+    std::array<array_t, 2> storage;
+    std::array<expr::array_view, 2> arguments;
+    for (std::size_t i = 0; i < count; ++i) {
+        auto argument = evaluate_view(node->children[i], storage[i]);
+        if (!argument)
+            return failed_arguments(node);
+        arguments[i] = *argument;
+    }
+
+    if (count == 2) {
+        const auto lhs = arguments[0].values.size();
+        const auto rhs = arguments[1].values.size();
+        if (!combined_size(lhs, rhs))
+            return mismatched_sizes(node->location, lhs, rhs);
+    }
+
+    auto result = definition.reduction(std::span(arguments).first(count));
+    if (!result) {
+        result.error().location = node->location;
+        return std::move(result.error());
+    }
+    return make_single(*result);
+}
+
+expr::array_result array_evaluator_impl::evaluate_assignment(
+    const expr::node_ptr& node
+) {
+    auto result = evaluate(node->children[1]);
+    if (!result) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+            .location = node->location,
+            .description = "Failed to evaluate function right-hand side for "
+                           "variable assignment."
+        };
+    }
+
+    if (result->size() != 1)
+        return single_value_expected(node->location, result->size());
+
+    _symbols[node->children[0]->content] = (*result)[0];
+    return result;
+}
+
+expr::array_result array_evaluator_impl::evaluate_array_literal(
+    const expr::node_ptr& node
+) {
+    auto result = array_t{};
+    result.values.reserve(node->children.size());
+    for (const auto& child : node->children) {
+        auto element = evaluate(child);
+        if (!element)
+            return element;
+
+        if (element->size() != 1)
+            return single_value_expected(child->location, element->size());
+
+        if (result.values.empty()) {
+            result.unit = element->unit;
+        } else if (element->unit != result.unit) {
+            return expr::error{
+                .code = expr::error_code::QUANTITY_NON_UNIFORM_UNIT,
+                .location = child->location,
+                .description = "Elements of an array have different units."
+            };
+        }
+        result.values.push_back(element->values[0]);
+    }
+    return result;
+}
+
+// A single condition, or one that is the same for every value, only evaluates
+// the branch it takes. Other conditions pick every value of the result from
+// one of both branches.
+expr::array_result array_evaluator_impl::evaluate_conditional(
+    const expr::node_ptr& node
+) {
+    const auto failure = expr::error{
+        .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+        .location = node->location,
+        .description = "Failed to evaluate operand."
+    };
+
+    const auto condition = evaluate(node->children[0]);
+    if (!condition)
+        return failure;
+
+    const auto& mask = condition->values;
+    const auto size = mask.size();
+    const auto taken = std::count_if(mask.begin(), mask.end(), [](double value) {
+        return value != 0;
+    });
+    if (size == 1 || taken == 0 || static_cast<std::size_t>(taken) == size) {
+        const auto& branch = node->children[taken == 0 ? 2 : 1];
+        auto result = evaluate(branch);
+        if (!result)
+            return failure;
+        if (size == 1 || result->size() == size)
+            return result;
+        if (result->size() != 1)
+            return mismatched_sizes(node->location, size, result->size());
+
+        result->values.assign(size, result->values[0]);
+        return result;
+    }
+
+    const auto then = evaluate(node->children[1]);
+    const auto otherwise = evaluate(node->children[2]);
+    if (!then || !otherwise)
+        return failure;
+
+    for (const auto branch_size : {then->size(), otherwise->size()}) {
+        if (!combined_size(size, branch_size))
+            return mismatched_sizes(node->location, size, branch_size);
+    }
+    if (then->unit != otherwise->unit) {
+        return expr::error{
+            .code = expr::error_code::QUANTITY_NON_UNIFORM_UNIT,
+            .location = node->location,
+            .description = "The branches of a conditional have different units."
+        };
+    }
+
+    auto result = array_t{then->unit, std::vector<double>(size)};
+    const auto then_step = then->size() == 1 ? 0 : 1;
+    const auto otherwise_step = otherwise->size() == 1 ? 0 : 1;
+    for (std::size_t i = 0; i < size; ++i) {
+        const auto a = then->values[i * then_step];
+        const auto b = otherwise->values[i * otherwise_step];
+        result.values[i] = mask[i] != 0 ? a : b;
+    }
+    return result;
+}
+
+array_evaluator_impl::view_result array_evaluator_impl::evaluate_view(
+    const expr::node_ptr& node,
+    array_t& storage
+) {
+    if (node->type == expr::node_t::type_t::VARIABLE) {
+        if (auto where = _arrays.find(node->content); where != _arrays.end())
+            return where->second;
+    }
+
+    auto result = evaluate(node);
+    if (!result)
+        return std::move(result.error());
+
+    storage = std::move(*result);
+    return expr::array_view{storage.unit, storage.values};
+}
+
+expr::array_result array_evaluator_impl::evaluate(const expr::node_ptr& node) {
+    switch (node->type) {
+        case expr::node_t::type_t::BINARY_OP:
+            return evaluate_binary_operator(node);
+        case expr::node_t::type_t::UNARY_OP:
+            return evaluate_unary_operator(node);
+        case expr::node_t::type_t::NUMBER:
+            return evaluate_number_literal(node);
+        case expr::node_t::type_t::VARIABLE:
+            return evaluate_variable_reference(node);
+        case expr::node_t::type_t::FUNCTION_CALL:
+            return evaluate_function_call(node);
+        case expr::node_t::type_t::ASSIGNMENT:
+            return evaluate_assignment(node);
+        case expr::node_t::type_t::UNIT_APPLICATION:
+            return evaluate_unit_application(node);
+        case expr::node_t::type_t::ARRAY:
+            return evaluate_array_literal(node);
+        case expr::node_t::type_t::CONDITIONAL:
+            return evaluate_conditional(node);
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_UNREGISTERED_FUNCTION_DEFINITION,
+                .location = node->location,
+                .description = "Function definitions have no value, they have to "
+                               "be registered."
+            };
+        case expr::node_t::type_t::UNIT:
+            break;
+    }
+
+    // Unreachable
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_REACHED_UNREACHABLE_CODE_PATH,
+        .location = {},
+        .description = "The evaluator has reached a supposedly unreachable "
+                       "code path."
+    };
+}
+
+expr::array_result expr::evaluate_array(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::array_table& arrays,
+    const expr::function_table& functions
+) {
+    const auto inlined = expr::inline_functions(node, functions, SIZE_MAX);
+    auto evaluator = array_evaluator_impl(symbols, arrays, functions);
+    return evaluator.evaluate(inlined);
+}
@@ -0,0 +1,905 @@
+#include "autodiff.h"
+#include "array.h"
+#include "series.h"
+
+#include <array>            // std::array
+#include <cmath>            // all math functions
+#include <optional>         // std::optional
+#include <span>             // std::span
+#include <unordered_map>    // std::unordered_map
+
+// A value together with its derivative. The derivative is kept without a unit,
+// its unit follows from the unit of the value.
+struct dual_t {
+    expr::quantity value;
+    double derivative;
+};
+
+using dual_result = expr::result<dual_t, expr::error>;
+
+// The derivative of a function call, given its arguments and their
+// derivatives. These are the rules of the derivator, with the chain rule
+// applied.
+using dual_rule_t = double (*)(
+    std::span<const expr::quantity>,
+    std::span<const double>
+);
+
+using dual_rule_table = std::unordered_map<std::string, dual_rule_t>;
+
+static double derive_sin(
+    std::span<const expr::quantity> arguments,
+    std::span<const double> derivatives
+) {
+    return std::cos(arguments[0].value) * derivatives[0];
+}
+
+static double derive_cos(
+    std::span<const expr::quantity> arguments,
+    std::span<const double> derivatives
+) {
+    return -std::sin(arguments[0].value) * derivatives[0];
+}
+
+static double derive_ln(
+    std::span<const expr::quantity> arguments,
+    std::span<const double> derivatives
+) {
+    return derivatives[0] / arguments[0].value;
+}
+
+static double derive_log2(
+    std::span<const expr::quantity> arguments,
+    std::span<const double> derivatives
+) {
+    return derivatives[0] / (std::log(2.0) * arguments[0].value);
+}
+
+static double derive_log10(
+    std::span<const expr::quantity> arguments,
+    std::span<const double> derivatives
+) {
+    return derivatives[0] / (std::log(10.0) * arguments[0].value);
+}
+
+static double derive_log(
+    std::span<const expr::quantity> arguments,
+    std::span<const double> derivatives
+) {
+    // log(x, b) = ln(x) / ln(b), and the base may depend on the variable too.
+    const auto ln_value = std::log(arguments[0].value);
+    const auto ln_base = std::log(arguments[1].value);
+    const auto value_derivative = derivatives[0] / arguments[0].value;
+    const auto base_derivative = derivatives[1] / arguments[1].value;
+    return (value_derivative * ln_base - ln_value * base_derivative)
+         / (ln_base * ln_base);
+}
+
+static const dual_rule_table& function_rules() {
+    static const auto table = dual_rule_table{
+        {"sin", derive_sin},
+        {"cos", derive_cos},
+        {"round", nullptr},
+        {"floor", nullptr},
+        {"ceil", nullptr},
+        {"abs", nullptr},
+        {"ln", derive_ln},
+        {"log2", derive_log2},
+        {"log10", derive_log10},
+        {"log", derive_log},
+        {"sgn", nullptr},
+    };
+    return table;
+}
+
+using rule_result = expr::result<dual_rule_t, expr::error>;
+
+static rule_result find_rule(const std::string& name, expr::location_t location) {
+    const auto& rules = function_rules();
+    const auto rule = rules.find(name);
+    if (rule == rules.end()) {
+        return expr::error{
+            .code = expr::error_code::DERIVATOR_GENERAL_ERROR,
+            .location = location,
+            .description = {"Derivation is not implemented for {0}(...).", name}
+        };
+    }
+
+    if (rule->second == nullptr) {
+        return expr::error{
+            .code = expr::error_code::DERIVATOR_FUNCTION_NOT_DERIVABLE,
+            .location = location,
+            .description = {"Function {0}(...) can't be derived.", name}
+        };
+    }
+    return rule->second;
+}
+
+static dual_result differentiate_node(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    std::string_view variable
+);
+
+static double derive_binary_operator(
+    char operation,
+    const dual_t& lhs,
+    const dual_t& rhs,
+    const expr::quantity& result
+) {
+    const auto f = lhs.value.value;
+    const auto g = rhs.value.value;
+    const auto df = lhs.derivative;
+    const auto dg = rhs.derivative;
+
+    switch (operation) {
+        case '+':
+            return df + dg;
+        case '-':
+            return df - dg;
+        case '*':
+            // (f * g)' = f' * g + f * g'
+            return df * g + f * dg;
+        case '/':
+            // (f / g)' = (f' * g - f * g') / g^2
+            return (df * g - f * dg) / (g * g);
+        case '%':
+            // f % g = f - trunc(f / g) * g
+            return df - std::trunc(f / g) * dg;
+        case '^':
+            // With a constant exponent the rule for simple powers applies:
+            // (f^n)' = n * f^(n - 1) * f'. Otherwise the generic one:
+            // (f^g)' = f^g * (g' * ln(f) + g * f' / f).
+            if (dg == 0)
+                return df == 0 ? 0 : g * std::pow(f, g - 1) * df;
+            return result.value * (dg * std::log(f) + g * df / f);
+    }
+
+    // Comparisons are constant wherever they are differentiable.
+    return 0;
+}
+
+static dual_result differentiate_binary_operator(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    std::string_view variable
+) {
+    const auto left = differentiate_node(node->children[0], symbols, functions, variable);
+    const auto right = differentiate_node(node->children[1], symbols, functions, variable);
+    if (!left || !right) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+            .location = node->location,
+            .description = "Failed to evaluate operand."
+        };
+    }
+
+    auto value = expr::apply_binary_operator<double>(*node, left->value, right->value);
+    if (!value)
+        return std::move(value.error());
+
+    return dual_t{
+        .value = *value,
+        .derivative = derive_binary_operator(node->content[0], *left, *right, *value)
+    };
+}
+
+static dual_result differentiate_unary_operator(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    std::string_view variable
+) {
+    auto operand = differentiate_node(node->children[0], symbols, functions, variable);
+    if (!operand) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+            .location = node->location,
+            .description = "Failed to evaluate operand."
+        };
+    }
+
+    if (node->content == "-") {
+        operand->value.value = -operand->value.value;
+        operand->derivative = -operand->derivative;
+    }
+    return operand;
+}
+
+static dual_result differentiate_variable_reference(
+    const expr::node_ptr& node,
+    const expr::symbol_table& symbols,
+    std::string_view variable
+) {
+    auto where = symbols.find(node->content);
+    if (where == symbols.end()) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_UNDEFINED_VARIABLE,
+            .location = node->location,
+            .description = {"Undefined variable '{0}'.", node->content}
+        };
+    }
+    return dual_t{
+        .value = where->second,
+        .derivative = node->content == variable ? 1.0 : 0.0
+    };
+}
+
+// The terms are differentiated one by one, a product by the product rule.
+// The bounds are integers, so they are constant wherever the result is
+// differentiable.
+static dual_result differentiate_series(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    std::string_view variable
+) {
+    // The index hides the variable, so no term depends on it.
+    const auto& index = node->children[0]->content;
+    if (index == variable) {
+        auto value = expr::evaluate_series(node, symbols, functions);
+        if (!value)
+            return std::move(value.error());
+        return dual_t{.value = *value, .derivative = 0};
+    }
+
+    const auto range = expr::evaluate_series_range(node, symbols, functions);
+    if (!range)
+        return range.error();
+
+    const bool is_product = node->content == "prod";
+    if (range->last < range->first)
+        return dual_t{.value = expr::make_scalar(is_product ? 1 : 0), .derivative = 0};
+
+    const auto& body = node->children[3];
+    std::optional<expr::quantity> hidden;
+    if (auto where = symbols.find(index); where != symbols.end())
+        hidden = where->second;
+
+    const auto failure = expr::error{
+        .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+        .location = node->location,
+        .description = {
+            "Failed to evaluate function arguments for '{0}()'.",
+            node->content
+        }
+    };
+
+    auto result = dual_result{failure};
+    for (auto i = range->first; i <= range->last; ++i) {
+        symbols.insert_or_assign(index, expr::make_scalar(double(i)));
+        auto term = differentiate_node(body, symbols, functions, variable);
+        if (!term) {
+            result = failure;
+            break;
+        }
+        if (i == range->first) {
+            result = *term;
+            continue;
+        }
+
+        const auto value = is_product ? expr::multiply(result->value, term->value)
+                                      : expr::add(result->value, term->value);
+        if (!value) {
+            auto error = value.error();
+            error.location = body->location;
+            result = std::move(error);
+            break;
+        }
+        // (p * f)' = p' * f + p * f'
+        result->derivative = is_product
+                           ? result->derivative * term->value.value
+                             + result->value.value * term->derivative
+                           : result->derivative + term->derivative;
+        result->value = *value;
+    }
+
+    if (hidden)
+        symbols.insert_or_assign(index, *hidden);
+    else
+        symbols.erase(index);
+    return result;
+}
+
+static dual_result differentiate_function_call(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    std::string_view variable
+) {
+    auto where = functions.find(node->content);
+    if (where == functions.end()) {
+        if (expr::is_series(*node))
+            return differentiate_series(node, symbols, functions, variable);
+        if (expr::is_reduction(node->content))
+            return expr::make_unsupported_array_error(node);
+
+        const auto& location = node->location.begin;
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_UNDEFINED_FUNCTION,
+            .location = expr::location_t{
+                .begin = location,
+                .end = location + node->content.length() - 1
+            },
+            .description = {"Undefined function '{0}'.", node->content}
+        };
+    }
+
+    const auto& definition = where->second;
+    const auto count = node->children.size();
+    if (auto error = expr::validate_argument_count(definition, count, node->location))
+        return std::move(*error);
+
+    if (count > expr::max_builtin_arity) {
+        return expr::error{
+            .code = expr::error_code::DERIVATOR_GENERAL_ERROR,
+            .location = node->location,
+            .description = {
+                "Derivation is not implemented for {0}(...).",
+                node->content
+            }
+        };
+    }
+
+    std::array<expr::quantity, expr::max_builtin_arity> values;
+    std::array<double, expr::max_builtin_arity> derivatives;
+    for (std::size_t i = 0; i < count; ++i) {
+        auto argument = differentiate_node(node->children[i], symbols, functions, variable);
+        if (!argument) {
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+                .location = node->location,
+                .description = {
+                    "Failed to evaluate function arguments for '{0}()'.",
+                    node->content
+                }
+            };
+        }
+        values[i] = argument->value;
+        derivatives[i] = argument->derivative;
+    }
+
+    const auto arguments = std::span(values).first(count);
+    auto value = expr::invoke(definition, arguments, node->location);
+    if (!value)
+        return std::move(value.error());
+
+    // Arguments not depending on the variable make any function constant.
+    bool is_constant = true;
+    for (std::size_t i = 0; i < count; ++i)
+        is_constant = is_constant && derivatives[i] == 0;
+    if (is_constant)
+        return dual_t{.value = *value, .derivative = 0};
+
+    auto rule = find_rule(node->content, node->location);
+    if (!rule)
+        return std::move(rule.error());
+
+    return dual_t{
+        .value = *value,
+        .derivative = (*rule)(arguments, std::span(derivatives).first(count))
+    };
+}
+
+static dual_result differentiate_assignment(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    std::string_view variable
+) {
+    auto result = differentiate_node(node->children[1], symbols, functions, variable);
+    if (!result) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+            .location = node->location,
+            .description = "Failed to evaluate function right-hand side for "
+                           "variable assignment."
+        };
+    }
+    symbols[node->children[0]->content] = result->value;
+    return result;
+}
+
+static dual_result differentiate_unit_application(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    std::string_view variable
+) {
+    auto subexpression = differentiate_node(node->children[0], symbols, functions, variable);
+    if (!subexpression)
+        return subexpression;
+
+    const auto factor = expr::make_unit(node->children[1]->content);
+    if (!factor)
+        return factor.error();
+
+    auto value = expr::multiply(subexpression->value, *factor);
+    if (!value)
+        return std::move(value.error());
+
+    return dual_t{
+        .value = *value,
+        .derivative = subexpression->derivative * factor->value
+    };
+}
+
+// Only the branch taken is differentiated, the condition is constant
+// wherever the result is differentiable.
+static dual_result differentiate_conditional(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    std::string_view variable
+) {
+    const auto failure = expr::error{
+        .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+        .location = node->location,
+        .description = "Failed to evaluate operand."
+    };
+
+    const auto condition = differentiate_node(
+        node->children[0],
+        symbols,
+        functions,
+        variable
+    );
+    if (!condition)
+        return failure;
+
+    const auto& branch = node->children[condition->value.value != 0 ? 1 : 2];
+    auto result = differentiate_node(branch, symbols, functions, variable);
+    if (!result)
+        return failure;
+    return result;
+}
+
+static dual_result differentiate_node(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    std::string_view variable
+) {
+    switch (node->type) {
+        case expr::node_t::type_t::BINARY_OP:
+            return differentiate_binary_operator(node, symbols, functions, variable);
+        case expr::node_t::type_t::UNARY_OP:
+            return differentiate_unary_operator(node, symbols, functions, variable);
+        case expr::node_t::type_t::NUMBER: {
+            auto value = expr::evaluate_parse_time(node);
+            if (!value)
+                return std::move(value.error());
+            return dual_t{.value = *value, .derivative = 0};
+        }
+        case expr::node_t::type_t::VARIABLE:
+            return differentiate_variable_reference(node, symbols, variable);
+        case expr::node_t::type_t::FUNCTION_CALL:
+            return differentiate_function_call(node, symbols, functions, variable);
+        case expr::node_t::type_t::ASSIGNMENT:
+            return differentiate_assignment(node, symbols, functions, variable);
+        case expr::node_t::type_t::CONDITIONAL:
+            return differentiate_conditional(node, symbols, functions, variable);
+        case expr::node_t::type_t::ARRAY:
+            return expr::make_unsupported_array_error(node);
+        case expr::node_t::type_t::UNIT:
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+            break;
+        case expr::node_t::type_t::UNIT_APPLICATION:
+            return differentiate_unit_application(node, symbols, functions, variable);
+    }
+
+    // Unreachable
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_REACHED_UNREACHABLE_CODE_PATH,
+        .location = {},
+        .description = "The evaluator has reached a supposedly unreachable "
+                       "code path."
+    };
+}
+
+expr::differential_result expr::differentiate(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    std::string_view variable
+) {
+    // The unit of the variable is looked up first, as an assignment may
+    // change it.
+    const auto where = symbols.find(std::string(variable));
+    const auto variable_unit = where != symbols.end()
+                             ? where->second.unit
+                             : expr::measurement_unit{0, 0};
+
+    auto result = differentiate_node(node, symbols, functions, variable);
+    if (!result)
+        return std::move(result.error());
+
+    const auto derivative = expr::quantity{
+        .unit = result->value.unit,
+        .value = result->derivative
+    };
+    auto quotient = expr::divide(derivative, expr::quantity{variable_unit, 1});
+    if (!quotient)
+        return std::move(quotient.error());
+
+    return expr::differential_t{
+        .value = result->value,
+        .derivative = *quotient
+    };
+}
+
+// Reverse mode. Entries of the tape are referred to by their index, and an
+// entry that depends on no variable needs no partial derivatives at all.
+
+static constexpr std::uint32_t no_entry = std::uint32_t(-1);
+
+class tape_recorder final {
+public:
+    tape_recorder(expr::gradient_tape& tape) :
+        _tape(tape)
+    {}
+
+    std::uint32_t constant() {
+        return push(false);
+    }
+
+    std::uint32_t input() {
+        return push(true);
+    }
+
+    // Starts an entry, the partials of its dependent operands follow.
+    std::uint32_t operation() {
+        return push(false);
+    }
+
+    void partial(std::uint32_t entry, std::uint32_t operand, double value) {
+        if (!_tape.entries[operand].dependent)
+            return;
+        auto& current = _tape.entries[entry];
+        current.dependent = true;
+        ++current.count;
+        _tape.operands.push_back(operand);
+        _tape.partials.push_back(value);
+    }
+
+private:
+    std::uint32_t push(bool dependent) {
+        _tape.entries.push_back(expr::tape_entry_t{
+            .first = std::uint32_t(_tape.operands.size()),
+            .count = 0,
+            .dependent = dependent
+        });
+        return std::uint32_t(_tape.entries.size() - 1);
+    }
+
+    expr::gradient_tape& _tape;
+};
+
+static void reset(
+    expr::gradient_tape& tape,
+    const expr::compiled_expression& expression
+) {
+    const auto variables = expression.variables.size();
+    tape.entries.clear();
+    tape.operands.clear();
+    tape.partials.clear();
+    tape.stack.resize(expression.stack_size);
+    tape.inputs.assign(variables, no_entry);
+    tape.assigned.assign(variables, no_entry);
+    tape.input_units.assign(variables, expr::measurement_unit{0, 0});
+}
+
+static expr::evaluator_result report(
+    const expr::compiled_expression& expression,
+    std::size_t instruction,
+    expr::error&& error
+) {
+    if (instruction >= expression.root || !expression.failure)
+        return std::move(error);
+    return *expression.failure;
+}
+
+static void record_binary_operator(
+    tape_recorder& recorder,
+    std::uint32_t entry,
+    expr::instruction_t::opcode_t opcode,
+    std::uint32_t lhs,
+    std::uint32_t rhs,
+    double f,
+    double g,
+    double result
+) {
+    using opcode_t = expr::instruction_t::opcode_t;
+
+    switch (opcode) {
+        case opcode_t::ADD:
+            recorder.partial(entry, lhs, 1);
+            recorder.partial(entry, rhs, 1);
+            break;
+        case opcode_t::SUBTRACT:
+            recorder.partial(entry, lhs, 1);
+            recorder.partial(entry, rhs, -1);
+            break;
+        case opcode_t::MULTIPLY:
+            recorder.partial(entry, lhs, g);
+            recorder.partial(entry, rhs, f);
+            break;
+        case opcode_t::DIVIDE:
+            recorder.partial(entry, lhs, 1 / g);
+            recorder.partial(entry, rhs, -f / (g * g));
+            break;
+        case opcode_t::MODULO:
+            recorder.partial(entry, lhs, 1);
+            recorder.partial(entry, rhs, -std::trunc(f / g));
+            break;
+        case opcode_t::POWER:
+            recorder.partial(entry, lhs, g * std::pow(f, g - 1));
+            recorder.partial(entry, rhs, result * std::log(f));
+            break;
+        default:
+            // Comparisons depend on no variable.
+            break;
+    }
+}
+
+static expr::evaluator_result record(
+    const expr::compiled_expression& expression,
+    expr::evaluation_context& context,
+    expr::gradient_tape& tape
+) {
+    using opcode_t = expr::instruction_t::opcode_t;
+
+    auto recorder = tape_recorder(tape);
+    auto *stack = context.stack.data();
+    auto *entries = tape.stack.data();
+    std::size_t top = 0;
+    const auto& instructions = expression.instructions;
+    for (std::size_t i = 0; i < instructions.size(); ++i) {
+        const auto& instruction = instructions[i];
+        switch (instruction.opcode) {
+            case opcode_t::CONSTANT:
+                stack[top] = expression.constants[instruction.operand];
+                entries[top++] = recorder.constant();
+                break;
+
+            case opcode_t::LOAD: {
+                const auto slot = instruction.operand;
+                if (!context.bound[slot]) {
+                    const auto& name = expression.variables[slot];
+                    return report(expression, i, expr::error{
+                        .code = expr::error_code::EVALUATOR_UNDEFINED_VARIABLE,
+                        .location = instruction.location,
+                        .description = {"Undefined variable '{0}'.", name}
+                    });
+                }
+
+                if (tape.assigned[slot] == no_entry && tape.inputs[slot] == no_entry) {
+                    tape.inputs[slot] = recorder.input();
+                    tape.input_units[slot] = context.slots[slot].unit;
+                }
+                stack[top] = context.slots[slot];
+                entries[top++] = tape.assigned[slot] != no_entry
+                               ? tape.assigned[slot]
+                               : tape.inputs[slot];
+                break;
+            }
+
+            case opcode_t::STORE:
+                expr::bind(context, instruction.operand, stack[top - 1]);
+                tape.assigned[instruction.operand] = entries[top - 1];
+                break;
+
+            case opcode_t::NEGATE: {
+                stack[top - 1].value = -stack[top - 1].value;
+                const auto entry = recorder.operation();
+                recorder.partial(entry, entries[top - 1], -1);
+                entries[top - 1] = entry;
+                break;
+            }
+
+            case opcode_t::ADD:
+            case opcode_t::SUBTRACT:
+            case opcode_t::MULTIPLY:
+            case opcode_t::DIVIDE:
+            case opcode_t::MODULO:
+            case opcode_t::POWER:
+            case opcode_t::LESS:
+            case opcode_t::LESS_EQUAL:
+            case opcode_t::GREATER:
+            case opcode_t::GREATER_EQUAL:
+            case opcode_t::EQUAL:
+            case opcode_t::NOT_EQUAL: {
+                static constexpr expr::arithmetic_result (*binary[])(
+                    expr::quantity,
+                    expr::quantity
+                ) = {
+                    expr::add,
+                    expr::subtract,
+                    expr::multiply,
+                    expr::divide,
+                    expr::modulo,
+                    expr::power,
+                    expr::less,
+                    expr::less_equal,
+                    expr::greater,
+                    expr::greater_equal,
+                    expr::equal,
+                    expr::not_equal,
+                };
+
+                const auto index = std::size_t(instruction.opcode)
+                                 - std::size_t(opcode_t::ADD);
+                auto result = binary[index](stack[top - 2], stack[top - 1]);
+                if (!result) {
+                    // HACK: The quantity class dictates the error, but the
+                    //       evaluator has source location.
+                    auto& error = result.error();
+                    error.code = expr::operator_error_code(error.code);
+                    error.location = instruction.location;
+                    return report(expression, i, std::move(error));
+                }
+
+                const auto entry = recorder.operation();
+                record_binary_operator(
+                    recorder,
+                    entry,
+                    instruction.opcode,
+                    entries[top - 2],
+                    entries[top - 1],
+                    stack[top - 2].value,
+                    stack[top - 1].value,
+                    result->value
+                );
+                stack[--top - 1] = *result;
+                entries[top - 1] = entry;
+                break;
+            }
+
+            case opcode_t::APPLY_UNIT: {
+                const auto& factor = expression.constants[instruction.operand];
+                auto applied = expr::multiply(stack[top - 1], factor);
+                if (!applied) {
+                    auto& error = applied.error();
+                    error.location = instruction.location;
+                    return report(expression, i, std::move(error));
+                }
+                stack[top - 1] = *applied;
+                const auto entry = recorder.operation();
+                recorder.partial(entry, entries[top - 1], factor.value);
+                entries[top - 1] = entry;
+                break;
+            }
+
+            case opcode_t::CALL: {
+                const auto& call = expression.calls[instruction.operand];
+                const auto& definition = *call.definition;
+                const auto arguments = std::span<const expr::quantity>(
+                    stack + top - call.arity,
+                    call.arity
+                );
+                const auto operands = std::span<const std::uint32_t>(
+                    entries + top - call.arity,
+                    call.arity
+                );
+
+                auto result = [&]() -> expr::function_result {
+                    if (definition.builtin == nullptr)
+                        return expr::invoke(definition, arguments, instruction.location);
+
+                    if (!call.validated) {
+                        auto error = expr::validate_arguments(
+                            definition,
+                            arguments,
+                            instruction.location
+                        );
+                        if (error)
+                            return std::move(*error);
+                    }
+
+                    return definition.builtin(arguments, instruction.location);
+                }();
+
+                if (!result)
+                    return report(expression, i, std::move(result.error()));
+
+                const auto entry = recorder.operation();
+                bool is_constant = true;
+                for (const auto operand : operands)
+                    is_constant = is_constant && !tape.entries[operand].dependent;
+
+                if (!is_constant && call.arity > expr::max_builtin_arity) {
+                    return report(expression, i, expr::error{
+                        .code = expr::error_code::DERIVATOR_GENERAL_ERROR,
+                        .location = instruction.location,
+                        .description = {
+                            "Derivation is not implemented for {0}(...).",
+                            call.name
+                        }
+                    });
+                }
+
+                if (!is_constant) {
+                    auto rule = find_rule(call.name, instruction.location);
+                    if (!rule)
+                        return report(expression, i, std::move(rule.error()));
+
+                    // The partial derivative with respect to an argument is
+                    // its derivative, if only that argument changes.
+                    std::array<double, expr::max_builtin_arity> derivatives{};
+                    const auto direction = std::span(derivatives).first(call.arity);
+                    for (std::size_t k = 0; k < call.arity; ++k) {
+                        if (!tape.entries[operands[k]].dependent)
+                            continue;
+                        direction[k] = 1;
+                        recorder.partial(entry, operands[k], (*rule)(arguments, direction));
+                        direction[k] = 0;
+                    }
+                }
+
+                top -= call.arity;
+                stack[top] = *result;
+                entries[top++] = entry;
+                break;
+            }
+
+            // Only the branch taken is recorded.
+            case opcode_t::JUMP:
+                i = instruction.operand - 1;
+                break;
+
+            case opcode_t::JUMP_IF_FALSE:
+                if (stack[--top].value == 0)
+                    i = instruction.operand - 1;
+                break;
+        }
+    }
+
+    return stack[top - 1];
+}
+
+expr::evaluator_result expr::gradient(
+    const expr::compiled_expression& expression,
+    expr::evaluation_context& context,
+    expr::gradient_tape& tape
+) {
+    expr::prepare(context, expression);
+    reset(tape, expression);
+
+    auto value = record(expression, context, tape);
+    if (!value)
+        return value;
+
+    const auto& entries = tape.entries;
+    auto& adjoints = tape.adjoints;
+    adjoints.assign(entries.size(), 0);
+    // The value is left as the only one on the stack.
+    adjoints[tape.stack[0]] = 1;
+    for (auto entry = entries.size(); entry-- > 0;) {
+        const auto adjoint = adjoints[entry];
+        if (adjoint == 0)
+            continue;
+        const auto& current = entries[entry];
+        for (auto k = current.first; k < current.first + current.count; ++k)
+            adjoints[tape.operands[k]] += tape.partials[k] * adjoint;
+    }
+
+    const auto variables = expression.variables.size();
+    tape.gradient.resize(variables);
+    for (std::size_t slot = 0; slot < variables; ++slot) {
+        const auto input = tape.inputs[slot];
+        const auto derivative = expr::quantity{
+            .unit = value->unit,
+            .value = input == no_entry ? 0 : adjoints[input]
+        };
+        auto quotient = expr::divide(
+            derivative,
+            expr::quantity{tape.input_units[slot], 1}
+        );
+        if (!quotient)
+            return std::move(quotient.error());
+        tape.gradient[slot] = *quotient;
+    }
+    return value;
+}
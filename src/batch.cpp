@@ -0,0 +1,577 @@
+#include "batch.h"
+#include "array.h"
+#include "series.h"
+#include "evaluator.h"
+
+#include <algorithm>        // std::any_of, std::copy_n, std::count_if, std::fill
+#include <optional>         // std::optional, std::nullopt
+
+// Each block gives a column of a single unit, and the results of all blocks
+// have to fit into one column.
+static expr::error non_uniform_unit(const expr::location_t& location) {
+    return expr::error{
+        .code = expr::error_code::QUANTITY_NON_UNIFORM_UNIT,
+        .location = location,
+        .description = "Values of a column have different units."
+    };
+}
+
+class batch_evaluator_impl final {
+public:
+    batch_evaluator_impl(
+        expr::batch_symbol_table& symbols,
+        const expr::function_table& functions,
+        std::size_t rows
+    );
+
+    expr::batch_result evaluate(const expr::node_ptr& root);
+
+private:
+    using block_t = expr::quantity_column;
+    using block_error = expr::column_error;
+
+private:
+    block_error evaluate_block(const expr::node_ptr& node, block_t& output);
+    block_error evaluate_binary_operator(
+        const expr::node_ptr& node,
+        block_t& output
+    );
+    block_error evaluate_unary_operator(
+        const expr::node_ptr& node,
+        block_t& output
+    );
+    block_error evaluate_number_literal(
+        const expr::node_ptr& node,
+        block_t& output
+    );
+    block_error evaluate_unit_application(
+        const expr::node_ptr& node,
+        block_t& output
+    );
+    block_error evaluate_variable_reference(
+        const expr::node_ptr& node,
+        block_t& output
+    );
+    block_error evaluate_function_call(
+        const expr::node_ptr& node,
+        block_t& output
+    );
+    block_error evaluate_assignment(
+        const expr::node_ptr& node,
+        block_t& output
+    );
+    block_error evaluate_conditional(
+        const expr::node_ptr& node,
+        block_t& output
+    );
+    block_error evaluate_runs(
+        const expr::node_ptr& node,
+        const block_t& condition,
+        block_t& output
+    );
+    bool has_effects(const expr::node_ptr& node) const;
+
+private:
+    // Intermediate blocks are recycled between nodes and blocks, so their
+    // storage is only allocated once per batch. Blocks hold the rows of the
+    // current block only.
+    block_t acquire_block() {
+        if (_free_blocks.empty()) {
+            auto block = block_t{};
+            block.values.reserve(expr::batch_block_size);
+            _free_blocks.push_back(std::move(block));
+        }
+        auto block = std::move(_free_blocks.back());
+        _free_blocks.pop_back();
+        block.values.resize(_length);
+        return block;
+    }
+
+    void release_block(block_t&& block) {
+        _free_blocks.push_back(std::move(block));
+    }
+
+private:
+    expr::batch_symbol_table& _symbols;
+    const expr::function_table& _functions;
+    const std::size_t _rows;
+    std::size_t _begin;
+    std::size_t _length;
+    std::vector<block_t> _free_blocks;
+};
+
+batch_evaluator_impl::batch_evaluator_impl(
+    expr::batch_symbol_table& symbols,
+    const expr::function_table& functions,
+    std::size_t rows
+) :
+    _symbols(symbols),
+    _functions(functions),
+    _rows(rows),
+    _begin(0),
+    _length(0)
+{}
+
+batch_evaluator_impl::block_error
+batch_evaluator_impl::evaluate_binary_operator(
+    const expr::node_ptr& node,
+    block_t& output
+) {
+    using binary_operator = expr::column_error (*)(
+        const expr::quantity_column&,
+        const expr::quantity_column&,
+        expr::quantity_column&
+    );
+    static const std::unordered_map<std::string, binary_operator> binary = {
+        {"+", expr::columns::add},
+        {"-", expr::columns::subtract},
+        {"*", expr::columns::multiply},
+        {"/", expr::columns::divide},
+        {"%", expr::columns::modulo},
+        {"^", expr::columns::power},
+        {"<", expr::columns::less},
+        {"<=", expr::columns::less_equal},
+        {">", expr::columns::greater},
+        {">=", expr::columns::greater_equal},
+        {"==", expr::columns::equal},
+        {"!=", expr::columns::not_equal},
+    };
+
+    auto right = acquire_block();
+    const bool failed = evaluate_block(node->children[0], output).has_value()
+                     || evaluate_block(node->children[1], right).has_value();
+    if (failed) {
+        release_block(std::move(right));
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+            .location = node->location,
+            .description = "Failed to evaluate operand."
+        };
+    }
+
+    const auto operator_fn = binary.at(node->content);
+    auto error = operator_fn(output, right, output);
+    release_block(std::move(right));
+    if (error) {
+        // HACK: The quantity class dictates the error, but the evaluator has
+        //       source location.
+        error->code = expr::operator_error_code(error->code);
+        error->location = node->children[1]->location;
+    }
+    return error;
+}
+
+batch_evaluator_impl::block_error
+batch_evaluator_impl::evaluate_unary_operator(
+    const expr::node_ptr& node,
+    block_t& output
+) {
+    if (evaluate_block(node->children[0], output)) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+            .location = node->location,
+            .description = "Failed to evaluate operand."
+        };
+    }
+
+    if (node->content == "-") {
+        for (auto& value : output.values)
+            value = -value;
+    }
+
+    return std::nullopt;
+}
+
+batch_evaluator_impl::block_error
+batch_evaluator_impl::evaluate_number_literal(
+    const expr::node_ptr& node,
+    block_t& output
+) {
+    const auto value = expr::evaluate_parse_time(node);
+    if (!value)
+        return value.error();
+
+    output.unit = value->unit;
+    std::fill(output.values.begin(), output.values.end(), value->value);
+    return std::nullopt;
+}
+
+batch_evaluator_impl::block_error
+batch_evaluator_impl::evaluate_unit_application(
+    const expr::node_ptr& node,
+    block_t& output
+) {
+    if (auto error = evaluate_block(node->children[0], output))
+        return error;
+
+    const auto factor = expr::make_unit(node->children[1]->content);
+    if (!factor)
+        return factor.error();
+
+    const auto unit = expr::multiply_unit(output.unit, factor->unit);
+    if (!unit)
+        return unit.error();
+
+    output.unit = *unit;
+    for (auto& value : output.values)
+        value *= factor->value;
+
+    return std::nullopt;
+}
+
+batch_evaluator_impl::block_error
+batch_evaluator_impl::evaluate_variable_reference(
+    const expr::node_ptr& node,
+    block_t& output
+) {
+    auto where = _symbols.find(node->content);
+    if (where == _symbols.end()) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_UNDEFINED_VARIABLE,
+            .location = node->location,
+            .description = {"Undefined variable '{0}'.", node->content}
+        };
+    }
+
+    const auto& column = where->second;
+    output.unit = column.unit;
+    std::copy_n(column.values.begin() + _begin, _length, output.values.begin());
+    return std::nullopt;
+}
+
+batch_evaluator_impl::block_error
+batch_evaluator_impl::evaluate_function_call(
+    const expr::node_ptr& node,
+    block_t& output
+) {
+    auto where = _functions.find(node->content);
+    if (where == _functions.end()) {
+        if (expr::is_series(*node))
+            return expr::make_unsupported_series_error(node);
+        if (expr::is_reduction(node->content))
+            return expr::make_unsupported_array_error(node);
+
+        const auto& location = node->location.begin;
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_UNDEFINED_FUNCTION,
+            .location = expr::location_t{
+                .begin = location,
+                .end = location + node->content.length() - 1
+            },
+            .description = {"Undefined function '{0}'.", node->content}
+        };
+    }
+
+    const auto& definition = where->second;
+    const auto count = node->children.size();
+
+    std::vector<block_t> arguments;
+    arguments.reserve(count);
+    bool failed = false;
+    for (const auto& child : node->children) {
+        arguments.push_back(acquire_block());
+        if (evaluate_block(child, arguments.back())) {
+            failed = true;
+            break;
+        }
+    }
+
+    auto release_arguments = [&] {
+        for (auto& argument : arguments)
+            release_block(std::move(argument));
+    };
+
+    if (failed) {
+        release_arguments();
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+            .location = node->location,
+            .description = {
+                "Failed to evaluate function arguments for '{0}()'.",
+                node->content
+            }
+        };
+    }
+
+    // Builtins only look at the units of their arguments, never their values,
+    // to decide the unit of the result, or whether the call is invalid. Every
+    // argument has a single unit across the block, so calling the scalar
+    // implementation on the first row validates the whole block, and the rest
+    // of the work can be done by the vectorized kernel on raw values.
+    std::vector<expr::quantity> row(count);
+    auto fetch_row = [&](std::size_t i) {
+        for (std::size_t j = 0; j < count; ++j)
+            row[j] = arguments[j][i];
+    };
+
+    fetch_row(0);
+    const auto first = expr::invoke(definition, row, node->location);
+    if (!first) {
+        release_arguments();
+        return first.error();
+    }
+    output.unit = first->unit;
+
+    if (definition.batch_implementation != nullptr) {
+        std::vector<const double *> pointers;
+        pointers.reserve(count);
+        for (const auto& argument : arguments)
+            pointers.push_back(argument.values.data());
+
+        definition.batch_implementation(pointers.data(), output.values.data(), _length);
+        release_arguments();
+        return std::nullopt;
+    }
+
+    output.values[0] = first->value;
+    for (std::size_t i = 1; i < _length; ++i) {
+        fetch_row(i);
+        const auto result = expr::invoke(definition, row, node->location);
+        if (!result) {
+            release_arguments();
+            return result.error();
+        }
+        output.values[i] = result->value;
+    }
+
+    release_arguments();
+    return std::nullopt;
+}
+
+batch_evaluator_impl::block_error
+batch_evaluator_impl::evaluate_assignment(
+    const expr::node_ptr& node,
+    block_t& output
+) {
+    if (evaluate_block(node->children[1], output)) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+            .location = node->location,
+            .description = "Failed to evaluate function right-hand side for "
+                           "variable assignment."
+        };
+    }
+
+    // Rows of a column can't have different units, so variables keep theirs.
+    const auto& name = node->children[0]->content;
+    auto& column = _symbols.try_emplace(
+        name,
+        expr::quantity_column{output.unit, std::vector<double>(_rows)}
+    ).first->second;
+    if (column.unit != output.unit)
+        return non_uniform_unit(node->location);
+
+    std::copy_n(output.values.begin(), _length, column.values.begin() + _begin);
+    return std::nullopt;
+}
+
+// Assignments and impure functions must only run for the rows taking their
+// branch.
+bool batch_evaluator_impl::has_effects(const expr::node_ptr& node) const {
+    if (node->type == expr::node_t::type_t::ASSIGNMENT)
+        return true;
+    if (node->type == expr::node_t::type_t::FUNCTION_CALL) {
+        const auto where = _functions.find(node->content);
+        if (where != _functions.end() && !where->second.is_pure)
+            return true;
+    }
+    const auto& children = node->children;
+    return std::any_of(children.begin(), children.end(), [this](const auto& child) {
+        return has_effects(child);
+    });
+}
+
+// Blocks taking a single branch only evaluate that branch. Other blocks
+// evaluate both branches for every row and pick the values without branching,
+// unless a branch has effects or fails for rows not taking it, in which case
+// each run of rows taking the same branch is evaluated as a block of its own.
+batch_evaluator_impl::block_error
+batch_evaluator_impl::evaluate_conditional(
+    const expr::node_ptr& node,
+    block_t& output
+) {
+    const auto failure = expr::error{
+        .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+        .location = node->location,
+        .description = "Failed to evaluate operand."
+    };
+
+    auto condition = acquire_block();
+    if (evaluate_block(node->children[0], condition)) {
+        release_block(std::move(condition));
+        return failure;
+    }
+
+    const auto& mask = condition.values;
+    const auto taken = std::count_if(mask.begin(), mask.end(), [](double value) {
+        return value != 0;
+    });
+    if (taken == 0 || static_cast<std::size_t>(taken) == _length) {
+        release_block(std::move(condition));
+        const auto& branch = node->children[taken == 0 ? 2 : 1];
+        if (evaluate_block(branch, output))
+            return failure;
+        return std::nullopt;
+    }
+
+    if (has_effects(node->children[1]) || has_effects(node->children[2])) {
+        auto error = evaluate_runs(node, condition, output);
+        release_block(std::move(condition));
+        return error;
+    }
+
+    auto otherwise = acquire_block();
+    const bool failed = evaluate_block(node->children[1], output).has_value()
+                     || evaluate_block(node->children[2], otherwise).has_value();
+    if (failed) {
+        release_block(std::move(otherwise));
+        auto error = evaluate_runs(node, condition, output);
+        release_block(std::move(condition));
+        return error;
+    }
+
+    if (output.unit != otherwise.unit) {
+        release_block(std::move(otherwise));
+        release_block(std::move(condition));
+        return non_uniform_unit(node->location);
+    }
+
+    for (std::size_t i = 0; i < _length; ++i)
+        output.values[i] = mask[i] != 0 ? output.values[i] : otherwise.values[i];
+
+    release_block(std::move(otherwise));
+    release_block(std::move(condition));
+    return std::nullopt;
+}
+
+batch_evaluator_impl::block_error batch_evaluator_impl::evaluate_runs(
+    const expr::node_ptr& node,
+    const block_t& condition,
+    block_t& output
+) {
+    const auto begin = _begin;
+    const auto length = _length;
+    auto restore = [&] {
+        _begin = begin;
+        _length = length;
+    };
+
+    std::optional<expr::measurement_unit> unit;
+    for (std::size_t start = 0; start < length;) {
+        const bool truth = condition.values[start] != 0;
+        auto end = start + 1;
+        while (end < length && (condition.values[end] != 0) == truth)
+            ++end;
+
+        _begin = begin + start;
+        _length = end - start;
+        auto run = acquire_block();
+        if (evaluate_block(node->children[truth ? 1 : 2], run)) {
+            release_block(std::move(run));
+            restore();
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+                .location = node->location,
+                .description = "Failed to evaluate operand."
+            };
+        }
+        if (unit && *unit != run.unit) {
+            release_block(std::move(run));
+            restore();
+            return non_uniform_unit(node->location);
+        }
+
+        unit = run.unit;
+        std::copy_n(run.values.begin(), _length, output.values.begin() + start);
+        release_block(std::move(run));
+        start = end;
+    }
+
+    restore();
+    output.unit = *unit;
+    return std::nullopt;
+}
+
+batch_evaluator_impl::block_error batch_evaluator_impl::evaluate_block(
+    const expr::node_ptr& node,
+    block_t& output
+) {
+    switch (node->type) {
+        case expr::node_t::type_t::BINARY_OP:
+            return evaluate_binary_operator(node, output);
+        case expr::node_t::type_t::UNARY_OP:
+            return evaluate_unary_operator(node, output);
+        case expr::node_t::type_t::NUMBER:
+            return evaluate_number_literal(node, output);
+        case expr::node_t::type_t::VARIABLE:
+            return evaluate_variable_reference(node, output);
+        case expr::node_t::type_t::FUNCTION_CALL:
+            return evaluate_function_call(node, output);
+        case expr::node_t::type_t::ASSIGNMENT:
+            return evaluate_assignment(node, output);
+        case expr::node_t::type_t::CONDITIONAL:
+            return evaluate_conditional(node, output);
+        case expr::node_t::type_t::ARRAY:
+            return expr::make_unsupported_array_error(node);
+        case expr::node_t::type_t::UNIT:
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+            break;
+        case expr::node_t::type_t::UNIT_APPLICATION:
+            return evaluate_unit_application(node, output);
+    }
+
+    // Unreachable
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_REACHED_UNREACHABLE_CODE_PATH,
+        .location = {},
+        .description = "The evaluator has reached a supposedly unreachable "
+                       "code path."
+    };
+}
+
+expr::batch_result batch_evaluator_impl::evaluate(const expr::node_ptr& root) {
+    auto results = expr::quantity_column{};
+    results.values.resize(_rows);
+
+    for (_begin = 0; _begin < _rows; _begin += expr::batch_block_size) {
+        _length = std::min(expr::batch_block_size, _rows - _begin);
+        auto block = acquire_block();
+        if (auto error = evaluate_block(root, block))
+            return std::move(*error);
+        if (_begin == 0)
+            results.unit = block.unit;
+        else if (block.unit != results.unit)
+            return non_uniform_unit(root->location);
+        std::copy_n(block.values.begin(), _length, results.values.begin() + _begin);
+        release_block(std::move(block));
+    }
+
+    return results;
+}
+
+expr::batch_result expr::evaluate_batch(
+    const expr::node_ptr& node,
+    expr::batch_symbol_table& symbols,
+    const expr::function_table& functions
+) {
+    // Every bound variable has to have a value for every row. A batch without
+    // any bound variables is evaluated once.
+    std::size_t rows = symbols.empty() ? 1 : symbols.begin()->second.size();
+    for (const auto& [name, column] : symbols) {
+        if (column.size() != rows) {
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_MISMATCHED_BATCH_SIZES,
+                .location = {},
+                .description = {
+                    "Variable '{0}' has {1} value(s) instead of {2}.",
+                    name,
+                    column.size(),
+                    rows
+                }
+            };
+        }
+    }
+
+    auto evaluator = batch_evaluator_impl(symbols, functions, rows);
+    return evaluator.evaluate(node);
+}
@@ -0,0 +1,306 @@
+#include "bounds.h"
+#include "array.h"
+#include "series.h"
+#include "evaluator.h"
+
+#include <algorithm>        // std::min, std::max
+#include <array>            // std::array
+#include <span>             // std::span
+#include <unordered_map>    // std::unordered_map
+
+static expr::interval_result evaluate_binary_operator(
+    const expr::node_ptr& node,
+    expr::interval_table& symbols,
+    const expr::function_table& functions
+) {
+    using binary_operator = expr::interval_result (*)(
+        expr::interval_quantity,
+        expr::interval_quantity
+    );
+    static const std::unordered_map<std::string, binary_operator> binary = {
+        {"+", expr::intervals::add},
+        {"-", expr::intervals::subtract},
+        {"*", expr::intervals::multiply},
+        {"/", expr::intervals::divide},
+        {"%", expr::intervals::modulo},
+        {"^", expr::intervals::power},
+        {"<", expr::intervals::less},
+        {"<=", expr::intervals::less_equal},
+        {">", expr::intervals::greater},
+        {">=", expr::intervals::greater_equal},
+        {"==", expr::intervals::equal},
+        {"!=", expr::intervals::not_equal},
+    };
+
+    const auto left = expr::evaluate(node->children[0], symbols, functions);
+    const auto right = expr::evaluate(node->children[1], symbols, functions);
+    if (!left || !right) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+            .location = node->location,
+            .description = "Failed to evaluate operand."
+        };
+    }
+
+    const auto operator_fn = binary.at(node->content);
+    auto result = operator_fn(*left, *right);
+    if (!result) {
+        // HACK: The quantity class dictates the error, but the evaluator has
+        //       source location.
+        auto& error = result.error();
+        error.code = expr::operator_error_code(error.code);
+        error.location = node->children[1]->location;
+    }
+    return result;
+}
+
+static expr::interval_result evaluate_unary_operator(
+    const expr::node_ptr& node,
+    expr::interval_table& symbols,
+    const expr::function_table& functions
+) {
+    using unary_operator = expr::interval_result (*)(expr::interval_quantity);
+    static const std::unordered_map<std::string, unary_operator> unary = {
+        {"+", expr::intervals::identity},
+        {"-", expr::intervals::negate},
+    };
+
+    const auto operand = expr::evaluate(node->children[0], symbols, functions);
+    if (operand.has_value()) {
+        const auto& operator_fn = unary.at(node->content);
+        return operator_fn(*operand);
+    }
+
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+        .location = node->location,
+        .description = "Failed to evaluate operand."
+    };
+}
+
+// Literals are read by the point evaluator, into intervals of a single value.
+static expr::interval_result evaluate_number_literal(const expr::node_ptr& node) {
+    auto value = expr::evaluate_parse_time(node);
+    if (!value)
+        return std::move(value.error());
+    return expr::make_interval(*value);
+}
+
+static expr::interval_result evaluate_unit_application(
+    const expr::node_ptr& node,
+    expr::interval_table& symbols,
+    const expr::function_table& functions
+) {
+    const auto& unit = node->children[1]->content;
+    const auto subexpression = expr::evaluate(
+        node->children[0],
+        symbols,
+        functions
+    );
+    if (!subexpression)
+        return subexpression.error();
+
+    const auto factor = expr::make_unit(unit);
+    if (!factor)
+        return factor.error();
+
+    return expr::intervals::multiply(*subexpression, expr::make_interval(*factor));
+}
+
+static expr::interval_result evaluate_variable_reference(
+    const expr::node_ptr& node,
+    const expr::interval_table& symbols
+) {
+    auto where = symbols.find(node->content);
+    if (where == symbols.end()) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_UNDEFINED_VARIABLE,
+            .location = node->location,
+            .description = {"Undefined variable '{0}'.", node->content}
+        };
+    }
+    return where->second;
+}
+
+static expr::interval_result evaluate_function_call(
+    const expr::node_ptr& node,
+    expr::interval_table& symbols,
+    const expr::function_table& functions
+) {
+    auto where = functions.find(node->content);
+    if (where == functions.end()) {
+        if (expr::is_series(*node))
+            return expr::make_unsupported_series_error(node);
+        if (expr::is_reduction(node->content))
+            return expr::make_unsupported_array_error(node);
+
+        const auto& location = node->location.begin;
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_UNDEFINED_FUNCTION,
+            .location = expr::location_t{
+                .begin = location,
+                .end = location + node->content.length() - 1
+            },
+            .description = {"Undefined function '{0}'.", node->content}
+        };
+    }
+
+    const auto& definition = where->second;
+    if (definition.interval_implementation == nullptr) {
+        return expr::error{
+            .code = expr::error_code::INTERVAL_UNSUPPORTED_FUNCTION,
+            .location = node->location,
+            .description = {
+                "Function '{0}()' can not be evaluated on intervals.",
+                node->content
+            }
+        };
+    }
+
+    const auto count = node->children.size();
+    if (auto error = expr::validate_argument_count(definition, count, node->location))
+        return std::move(*error);
+
+    std::array<expr::interval_quantity, expr::max_builtin_arity> buffer;
+    const auto evaluated = std::span(buffer).first(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        auto result = expr::evaluate(node->children[i], symbols, functions);
+        if (!result) {
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+                .location = node->location,
+                .description = {
+                    "Failed to evaluate function arguments for '{0}()'.",
+                    node->content
+                }
+            };
+        }
+        evaluated[i] = *result;
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        auto error = expr::validate_argument(
+            definition,
+            i,
+            evaluated[i].unit,
+            node->location
+        );
+        if (error)
+            return std::move(*error);
+    }
+
+    return definition.interval_implementation(evaluated);
+}
+
+static expr::interval_result evaluate_assignment(
+    const expr::node_ptr& node,
+    expr::interval_table& symbols,
+    const expr::function_table& functions
+) {
+    auto result = expr::evaluate(node->children[1], symbols, functions);
+    if (!result) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+            .location = node->location,
+            .description = "Failed to evaluate function right-hand side for "
+                           "variable assignment."
+        };
+    }
+    symbols[node->children[0]->content] = *result;
+    return result;
+}
+
+// A condition that excludes zero only takes the first branch, one that is
+// exactly zero only the second, and any other gives the hull of both.
+static expr::interval_result evaluate_conditional(
+    const expr::node_ptr& node,
+    expr::interval_table& symbols,
+    const expr::function_table& functions
+) {
+    const auto failure = expr::error{
+        .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+        .location = node->location,
+        .description = "Failed to evaluate operand."
+    };
+
+    const auto condition = expr::evaluate(node->children[0], symbols, functions);
+    if (!condition)
+        return failure;
+
+    const auto& truth = condition->value;
+    if (truth.is_empty())
+        return *condition;
+
+    const auto evaluate_branch = [&](const expr::node_ptr& branch) {
+        auto result = expr::evaluate(branch, symbols, functions);
+        if (!result)
+            return expr::interval_result{failure};
+        return result;
+    };
+    if (!truth.contains(0))
+        return evaluate_branch(node->children[1]);
+    if (truth.lower == 0 && truth.upper == 0)
+        return evaluate_branch(node->children[2]);
+
+    const auto then = evaluate_branch(node->children[1]);
+    if (!then)
+        return then;
+    const auto otherwise = evaluate_branch(node->children[2]);
+    if (!otherwise)
+        return otherwise;
+
+    if (then->unit != otherwise->unit) {
+        return expr::error{
+            .code = expr::error_code::QUANTITY_NON_UNIFORM_UNIT,
+            .location = node->location,
+            .description = "The branches of a conditional have different units."
+        };
+    }
+    if (then->value.is_empty())
+        return otherwise;
+    if (otherwise->value.is_empty())
+        return then;
+    return expr::make_interval(
+        std::min(then->value.lower, otherwise->value.lower),
+        std::max(then->value.upper, otherwise->value.upper),
+        then->unit
+    );
+}
+
+expr::interval_result expr::evaluate(
+    const expr::node_ptr& node,
+    expr::interval_table& symbols,
+    const expr::function_table& functions
+) {
+    switch (node->type) {
+        case expr::node_t::type_t::BINARY_OP:
+            return evaluate_binary_operator(node, symbols, functions);
+        case expr::node_t::type_t::UNARY_OP:
+            return evaluate_unary_operator(node, symbols, functions);
+        case expr::node_t::type_t::NUMBER:
+            return evaluate_number_literal(node);
+        case expr::node_t::type_t::VARIABLE:
+            return evaluate_variable_reference(node, symbols);
+        case expr::node_t::type_t::FUNCTION_CALL:
+            return evaluate_function_call(node, symbols, functions);
+        case expr::node_t::type_t::ASSIGNMENT:
+            return evaluate_assignment(node, symbols, functions);
+        case expr::node_t::type_t::CONDITIONAL:
+            return evaluate_conditional(node, symbols, functions);
+        case expr::node_t::type_t::ARRAY:
+            return expr::make_unsupported_array_error(node);
+        case expr::node_t::type_t::UNIT:
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+            break;
+        case expr::node_t::type_t::UNIT_APPLICATION:
+            return evaluate_unit_application(node, symbols, functions);
+    }
+
+    // Unreachable
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_REACHED_UNREACHABLE_CODE_PATH,
+        .location = {},
+        .description = "The evaluator has reached a supposedly unreachable "
+                       "code path."
+    };
+}
@@ -0,0 +1,270 @@
+#include "column.h"
+#include "utility.h"
+
+#include <cfloat>           // DBL_EPSILON
+#include <cmath>            // std::fabs, std::floor, std::fmod
+
+static expr::error make_error(expr::error_code code, const char *description) {
+    return expr::error{
+        .code = code,
+        .location = {},
+        .description = description
+    };
+}
+
+// The loops only read and write arrays of doubles, with no calls and no early
+// exits, so the compiler is free to vectorize them. A single value is read
+// before the output is resized, as the output may be the operand holding it.
+// Columns of different sizes, neither of them a single value, are rejected
+// before anything is read.
+template <typename Operation>
+static expr::column_error transform(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output,
+    Operation operation
+) {
+    if (lhs.size() != rhs.size() && lhs.size() != 1 && rhs.size() != 1) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_MISMATCHED_ARRAY_SIZES,
+            .location = {},
+            .description = {
+                "Arrays of {0} and {1} values can't be combined.",
+                lhs.size(),
+                rhs.size()
+            }
+        };
+    }
+
+    if (lhs.size() == 1 && rhs.size() != 1) {
+        const double left = lhs.values[0];
+        output.values.resize(rhs.size());
+        const double *right = rhs.values.data();
+        double *result = output.values.data();
+        for (std::size_t i = 0; i < rhs.size(); ++i)
+            result[i] = operation(left, right[i]);
+        return std::nullopt;
+    }
+
+    if (rhs.size() == 1 && lhs.size() != 1) {
+        const double right = rhs.values[0];
+        output.values.resize(lhs.size());
+        const double *left = lhs.values.data();
+        double *result = output.values.data();
+        for (std::size_t i = 0; i < lhs.size(); ++i)
+            result[i] = operation(left[i], right);
+        return std::nullopt;
+    }
+
+    const auto count = lhs.size();
+    output.values.resize(count);
+    const double *left = lhs.values.data();
+    const double *right = rhs.values.data();
+    double *result = output.values.data();
+    for (std::size_t i = 0; i < count; ++i)
+        result[i] = operation(left[i], right[i]);
+    return std::nullopt;
+}
+
+template <typename Operation>
+static expr::column_error compare(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output,
+    Operation operation
+) {
+    if (lhs.unit != rhs.unit) {
+        return make_error(
+            expr::error_code::QUANTITY_EXPECTED_SAME_UNIT,
+            "Expected operands with identical units."
+        );
+    }
+
+    output.unit = expr::measurement_unit{0, 0};
+    return transform(lhs, rhs, output, [&](double x, double y) {
+        return operation(x, y) ? 1.0 : 0.0;
+    });
+}
+
+expr::column_error expr::columns::add(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    if (lhs.unit != rhs.unit) {
+        return make_error(
+            expr::error_code::QUANTITY_INVALID_BINARY_OPERATION,
+            "Invalid binary operation."
+        );
+    }
+
+    output.unit = lhs.unit;
+    return transform(lhs, rhs, output, [](double x, double y) { return x + y; });
+}
+
+expr::column_error expr::columns::subtract(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    if (lhs.unit != rhs.unit) {
+        return make_error(
+            expr::error_code::QUANTITY_INVALID_BINARY_OPERATION,
+            "Invalid binary operation."
+        );
+    }
+
+    output.unit = lhs.unit;
+    return transform(lhs, rhs, output, [](double x, double y) { return x - y; });
+}
+
+expr::column_error expr::columns::multiply(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    const auto unit = expr::multiply_unit(lhs.unit, rhs.unit);
+    if (!unit)
+        return unit.error();
+
+    output.unit = *unit;
+    return transform(lhs, rhs, output, [](double x, double y) { return x * y; });
+}
+
+expr::column_error expr::columns::divide(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    // Divisors near zero are counted while dividing, instead of being looked
+    // for first.
+    const auto unit = expr::divide_unit(lhs.unit, rhs.unit);
+    if (!unit)
+        return unit.error();
+
+    bool near_zero = false;
+    const auto error = transform(lhs, rhs, output, [&](double x, double y) {
+        near_zero |= std::fabs(y) <= DBL_EPSILON;
+        return x / y;
+    });
+    if (error)
+        return error;
+
+    if (near_zero) {
+        return make_error(
+            expr::error_code::QUANTITY_DIVISION_BY_ZERO,
+            "Division by zero."
+        );
+    }
+
+    output.unit = *unit;
+    return std::nullopt;
+}
+
+expr::column_error expr::columns::modulo(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    if (lhs.unit != rhs.unit) {
+        return make_error(
+            expr::error_code::QUANTITY_EXPECTED_SAME_UNIT,
+            "Expected operands with identical units."
+        );
+    }
+
+    output.unit = lhs.unit;
+    return transform(lhs, rhs, output, [](double x, double y) { return std::fmod(x, y); });
+}
+
+expr::column_error expr::columns::power(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    const auto count = rhs.size();
+    const double *exponents = rhs.values.data();
+    bool integral = rhs.unit.is_scalar();
+    bool uniform = true;
+    for (std::size_t i = 0; i < count; ++i) {
+        integral &= exponents[i] - std::floor(exponents[i]) < DBL_EPSILON;
+        uniform &= exponents[i] == exponents[0];
+    }
+
+    if (!integral) {
+        return make_error(
+            expr::error_code::QUANTITY_SCALAR_INTEGER_EXPECTED_AS_POWER,
+            "Scalar integer expected as power."
+        );
+    }
+
+    // Values of a unit raised to different exponents have different units, so
+    // they don't make a column.
+    if (!lhs.unit.is_scalar() && !uniform) {
+        return make_error(
+            expr::error_code::QUANTITY_NON_UNIFORM_UNIT,
+            "Values of a column have different units."
+        );
+    }
+
+    const auto unit = count == 0 ? lhs.unit : expr::power_unit(lhs.unit, exponents[0]);
+    if (!unit)
+        return unit.error();
+
+    const auto error = count != 0 && uniform && exponents[0] == 2
+        ? transform(lhs, rhs, output, [](double x, double) { return x * x; })
+        : transform(lhs, rhs, output, [](double x, double y) { return expr::raise(x, y); });
+    if (error)
+        return error;
+
+    output.unit = *unit;
+    return std::nullopt;
+}
+
+expr::column_error expr::columns::less(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    return compare(lhs, rhs, output, [](double x, double y) { return x < y; });
+}
+
+expr::column_error expr::columns::less_equal(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    return compare(lhs, rhs, output, [](double x, double y) { return x <= y; });
+}
+
+expr::column_error expr::columns::greater(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    return compare(lhs, rhs, output, [](double x, double y) { return x > y; });
+}
+
+expr::column_error expr::columns::greater_equal(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    return compare(lhs, rhs, output, [](double x, double y) { return x >= y; });
+}
+
+expr::column_error expr::columns::equal(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    return compare(lhs, rhs, output, [](double x, double y) { return x == y; });
+}
+
+expr::column_error expr::columns::not_equal(
+    const expr::quantity_column& lhs,
+    const expr::quantity_column& rhs,
+    expr::quantity_column& output
+) {
+    return compare(lhs, rhs, output, [](double x, double y) { return x != y; });
+}
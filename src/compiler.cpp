@@ -0,0 +1,397 @@
+#include "compiler.h"
+#include "array.h"
+#include "series.h"
+#include "evaluator.h"
+#include "optimizer.h"
+
+#include <algorithm>        // std::find, std::max
+#include <cstdint>          // SIZE_MAX
+#include <optional>         // std::optional, std::nullopt
+#include <unordered_map>    // std::unordered_map
+
+class expression_compiler_impl final {
+public:
+    expression_compiler_impl(const expr::function_table& functions);
+    expr::compiler_result compile(const expr::node_ptr& root);
+
+private:
+    using opcode_t = expr::instruction_t::opcode_t;
+    using compile_error = std::optional<expr::error>;
+
+private:
+    compile_error compile_node(const expr::node_ptr& node);
+    compile_error compile_node_contents(const expr::node_ptr& node);
+    compile_error compile_binary_operator(const expr::node_ptr& node);
+    compile_error compile_unary_operator(const expr::node_ptr& node);
+    compile_error compile_number_literal(const expr::node_ptr& node);
+    compile_error compile_variable_reference(const expr::node_ptr& node);
+    compile_error compile_function_call(const expr::node_ptr& node);
+    compile_error compile_assignment(const expr::node_ptr& node);
+    compile_error compile_unit_application(const expr::node_ptr& node);
+    compile_error compile_conditional(const expr::node_ptr& node);
+
+private:
+    void emit(opcode_t opcode, std::size_t operand, expr::location_t location) {
+        _result.instructions.push_back(expr::instruction_t{
+            .opcode = opcode,
+            .operand = std::uint32_t(operand),
+            .location = location
+        });
+    }
+
+    void push(std::size_t count = 1) {
+        _depth += count;
+        _result.stack_size = std::max(_result.stack_size, _depth);
+    }
+
+    void pop(std::size_t count = 1) {
+        _depth -= count;
+    }
+
+    std::size_t add_constant(const expr::quantity& value) {
+        _result.constants.push_back(value);
+        return _result.constants.size() - 1;
+    }
+
+    std::size_t add_variable(const std::string& name) {
+        auto& variables = _result.variables;
+        const auto where = std::find(variables.begin(), variables.end(), name);
+        if (where != variables.end())
+            return std::size_t(where - variables.begin());
+        variables.push_back(name);
+        return variables.size() - 1;
+    }
+
+private:
+    const expr::function_table& _functions;
+    expr::compiled_expression _result;
+    std::size_t _depth;
+    const expr::node_t *_reporting;
+};
+
+static const expr::node_ptr& find_reporting_node(const expr::node_ptr& root) {
+    // Unit applications forward the errors of their subexpression as-is.
+    if (root->type == expr::node_t::type_t::UNIT_APPLICATION)
+        return find_reporting_node(root->children[0]);
+    return root;
+}
+
+static std::optional<expr::error> make_subexpression_failure(
+    const expr::node_ptr& node
+) {
+    switch (node->type) {
+        case expr::node_t::type_t::BINARY_OP:
+        case expr::node_t::type_t::UNARY_OP:
+        case expr::node_t::type_t::CONDITIONAL:
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+                .location = node->location,
+                .description = "Failed to evaluate operand."
+            };
+        case expr::node_t::type_t::FUNCTION_CALL:
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+                .location = node->location,
+                .description = {
+                    "Failed to evaluate function arguments for '{0}()'.",
+                    node->content
+                }
+            };
+        case expr::node_t::type_t::ASSIGNMENT:
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+                .location = node->location,
+                .description = "Failed to evaluate function right-hand side "
+                               "for variable assignment."
+            };
+        case expr::node_t::type_t::NUMBER:
+        case expr::node_t::type_t::VARIABLE:
+        case expr::node_t::type_t::UNIT:
+        case expr::node_t::type_t::UNIT_APPLICATION:
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+        case expr::node_t::type_t::ARRAY:
+            break;
+    }
+    return std::nullopt;
+}
+
+expression_compiler_impl::expression_compiler_impl(
+    const expr::function_table& functions
+) :
+    _functions(functions),
+    _result{
+        .instructions = {},
+        .constants = {},
+        .variables = {},
+        .calls = {},
+        .stack_size = 0,
+        .root = 0,
+        .failure = std::nullopt
+    },
+    _depth(0),
+    _reporting(nullptr)
+{}
+
+expression_compiler_impl::compile_error
+expression_compiler_impl::compile_binary_operator(const expr::node_ptr& node) {
+    static const std::unordered_map<std::string, opcode_t> binary = {
+        {"+", opcode_t::ADD},
+        {"-", opcode_t::SUBTRACT},
+        {"*", opcode_t::MULTIPLY},
+        {"/", opcode_t::DIVIDE},
+        {"%", opcode_t::MODULO},
+        {"^", opcode_t::POWER},
+        {"<", opcode_t::LESS},
+        {"<=", opcode_t::LESS_EQUAL},
+        {">", opcode_t::GREATER},
+        {">=", opcode_t::GREATER_EQUAL},
+        {"==", opcode_t::EQUAL},
+        {"!=", opcode_t::NOT_EQUAL},
+    };
+
+    if (auto error = compile_node(node->children[0]))
+        return error;
+    if (auto error = compile_node(node->children[1]))
+        return error;
+
+    // Errors of binary operators point at their right operand.
+    emit(binary.at(node->content), 0, node->children[1]->location);
+    pop();
+    return std::nullopt;
+}
+
+expression_compiler_impl::compile_error
+expression_compiler_impl::compile_unary_operator(const expr::node_ptr& node) {
+    if (auto error = compile_node(node->children[0]))
+        return error;
+
+    if (node->content == "-")
+        emit(opcode_t::NEGATE, 0, node->location);
+    return std::nullopt;
+}
+
+expression_compiler_impl::compile_error
+expression_compiler_impl::compile_number_literal(const expr::node_ptr& node) {
+    const auto value = expr::evaluate_parse_time(node);
+    if (!value)
+        return value.error();
+
+    emit(opcode_t::CONSTANT, add_constant(*value), node->location);
+    push();
+    return std::nullopt;
+}
+
+expression_compiler_impl::compile_error
+expression_compiler_impl::compile_variable_reference(
+    const expr::node_ptr& node
+) {
+    emit(opcode_t::LOAD, add_variable(node->content), node->location);
+    push();
+    return std::nullopt;
+}
+
+expression_compiler_impl::compile_error
+expression_compiler_impl::compile_function_call(const expr::node_ptr& node) {
+    auto where = _functions.find(node->content);
+    if (where == _functions.end()) {
+        if (expr::is_series(*node))
+            return expr::make_unsupported_series_error(node);
+        if (expr::is_reduction(node->content))
+            return expr::make_unsupported_array_error(node);
+
+        const auto& location = node->location.begin;
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_UNDEFINED_FUNCTION,
+            .location = expr::location_t{
+                .begin = location,
+                .end = location + node->content.length() - 1
+            },
+            .description = {"Undefined function '{0}'.", node->content}
+        };
+    }
+
+    const auto& definition = where->second;
+    const auto arity = node->children.size();
+    if (auto error = expr::validate_argument_count(definition, arity, node->location))
+        return error;
+
+    // Every other call to a user function was inlined before compiling.
+    if (definition.user_function != nullptr) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_NOT_INLINED_FUNCTION,
+            .location = node->location,
+            .description = {
+                "Recursive function '{0}()' can't be compiled.",
+                node->content
+            }
+        };
+    }
+
+    // Arguments that can be evaluated at compile time have their units
+    // validated here. If every argument is such, the call site is marked as
+    // validated, and the interpreter calls the function without checks.
+    bool validated = true;
+    for (std::size_t i = 0; i < arity; ++i) {
+        const auto& argument = node->children[i];
+        if (auto value = expr::evaluate_parse_time(argument)) {
+            auto error = expr::validate_argument(
+                definition,
+                i,
+                value->unit,
+                node->location
+            );
+            if (error)
+                return error;
+        } else {
+            validated = false;
+        }
+
+        if (auto error = compile_node(argument))
+            return error;
+    }
+
+    _result.calls.push_back(expr::call_site_t{
+        .name = node->content,
+        .definition = &definition,
+        .arity = std::uint32_t(arity),
+        .validated = validated
+    });
+    emit(opcode_t::CALL, _result.calls.size() - 1, node->location);
+    pop(arity);
+    push();
+    return std::nullopt;
+}
+
+expression_compiler_impl::compile_error
+expression_compiler_impl::compile_assignment(const expr::node_ptr& node) {
+    if (auto error = compile_node(node->children[1]))
+        return error;
+
+    const auto& name = node->children[0]->content;
+    emit(opcode_t::STORE, add_variable(name), node->location);
+    return std::nullopt;
+}
+
+expression_compiler_impl::compile_error
+expression_compiler_impl::compile_unit_application(
+    const expr::node_ptr& node
+) {
+    if (auto error = compile_node(node->children[0]))
+        return error;
+
+    const auto factor = expr::make_unit(node->children[1]->content);
+    if (!factor)
+        return factor.error();
+
+    emit(opcode_t::APPLY_UNIT, add_constant(*factor), node->location);
+    return std::nullopt;
+}
+
+// Only the branch the condition takes is run, the targets of the jumps are
+// patched in once both branches are compiled.
+expression_compiler_impl::compile_error
+expression_compiler_impl::compile_conditional(const expr::node_ptr& node) {
+    if (auto error = compile_node(node->children[0]))
+        return error;
+
+    const auto jump_to_else = _result.instructions.size();
+    emit(opcode_t::JUMP_IF_FALSE, 0, node->location);
+    pop();
+
+    if (auto error = compile_node(node->children[1]))
+        return error;
+
+    const auto jump_to_end = _result.instructions.size();
+    emit(opcode_t::JUMP, 0, node->location);
+    pop();
+
+    _result.instructions[jump_to_else].operand = std::uint32_t(
+        _result.instructions.size()
+    );
+    if (auto error = compile_node(node->children[2]))
+        return error;
+
+    _result.instructions[jump_to_end].operand = std::uint32_t(
+        _result.instructions.size()
+    );
+    return std::nullopt;
+}
+
+expression_compiler_impl::compile_error expression_compiler_impl::compile_node(
+    const expr::node_ptr& node
+) {
+    auto error = compile_node_contents(node);
+
+    // The last instruction of the reporting node is the one reporting its own
+    // errors. A unary plus is not compiled to any instruction, and the last
+    // instruction of a conditional belongs to one of its branches, so neither
+    // reports errors of its own.
+    if (!error && node.get() == _reporting) {
+        const bool is_identity = node->type == expr::node_t::type_t::UNARY_OP
+                              && node->content == "+";
+        const bool is_conditional = node->type == expr::node_t::type_t::CONDITIONAL;
+        _result.root = (is_identity || is_conditional)
+                     ? _result.instructions.size()
+                     : _result.instructions.size() - 1;
+    }
+
+    return error;
+}
+
+expression_compiler_impl::compile_error
+expression_compiler_impl::compile_node_contents(const expr::node_ptr& node) {
+    switch (node->type) {
+        case expr::node_t::type_t::BINARY_OP:
+            return compile_binary_operator(node);
+        case expr::node_t::type_t::UNARY_OP:
+            return compile_unary_operator(node);
+        case expr::node_t::type_t::NUMBER:
+            return compile_number_literal(node);
+        case expr::node_t::type_t::VARIABLE:
+            return compile_variable_reference(node);
+        case expr::node_t::type_t::FUNCTION_CALL:
+            return compile_function_call(node);
+        case expr::node_t::type_t::ASSIGNMENT:
+            return compile_assignment(node);
+        case expr::node_t::type_t::CONDITIONAL:
+            return compile_conditional(node);
+        case expr::node_t::type_t::ARRAY:
+            return expr::make_unsupported_array_error(node);
+        case expr::node_t::type_t::UNIT:
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+            break;
+        case expr::node_t::type_t::UNIT_APPLICATION:
+            return compile_unit_application(node);
+    }
+
+    // Unreachable
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_REACHED_UNREACHABLE_CODE_PATH,
+        .location = {},
+        .description = "The evaluator has reached a supposedly unreachable "
+                       "code path."
+    };
+}
+
+expr::compiler_result expression_compiler_impl::compile(
+    const expr::node_ptr& root
+) {
+    const auto& reporting = find_reporting_node(root);
+    _reporting = reporting.get();
+    if (auto error = compile_node(root))
+        return std::move(*error);
+
+    _result.failure = make_subexpression_failure(reporting);
+    return std::move(_result);
+}
+
+expr::compiler_result expr::compile(
+    const expr::node_ptr& root,
+    const expr::function_table& functions
+) {
+    // The interpreter only calls builtins, so user functions are inlined
+    // whatever their size.
+    const auto inlined = expr::inline_functions(root, functions, SIZE_MAX);
+    auto compiler = expression_compiler_impl(functions);
+    return compiler.compile(inlined);
+}
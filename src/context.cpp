@@ -0,0 +1,96 @@
+#include "context.h"
+
+#include <algorithm>        // std::find, std::fill
+
+expr::evaluation_context expr::make_context(
+    const expr::compiled_expression& expression
+) {
+    const auto variables = expression.variables.size();
+    return expr::evaluation_context{
+        .slots = expr::cache_aligned_vector<expr::quantity>(variables),
+        .bound = expr::cache_aligned_vector<std::uint8_t>(variables, 0),
+        .stack = expr::cache_aligned_vector<expr::quantity>(expression.stack_size),
+        .exact = expr::cache_aligned_vector<std::int64_t>(expression.stack_size)
+    };
+}
+
+void expr::prepare(
+    expr::evaluation_context& context,
+    const expr::compiled_expression& expression
+) {
+    const auto variables = expression.variables.size();
+    if (context.slots.size() < variables) {
+        context.slots.resize(variables);
+        context.bound.resize(variables, 0);
+    }
+    if (context.stack.size() < expression.stack_size) {
+        context.stack.resize(expression.stack_size);
+        context.exact.resize(expression.stack_size);
+    }
+}
+
+std::optional<std::size_t> expr::find_slot(
+    const expr::compiled_expression& expression,
+    std::string_view name
+) {
+    const auto& variables = expression.variables;
+    const auto where = std::find(variables.begin(), variables.end(), name);
+    if (where == variables.end())
+        return std::nullopt;
+    return std::size_t(where - variables.begin());
+}
+
+std::vector<std::size_t> expr::referenced_slots(
+    const expr::compiled_expression& expression
+) {
+    std::vector<std::uint8_t> is_read(expression.variables.size(), 0);
+    for (const auto& instruction : expression.instructions) {
+        if (instruction.opcode == expr::instruction_t::opcode_t::LOAD)
+            is_read[instruction.operand] = 1;
+    }
+
+    std::vector<std::size_t> slots;
+    for (std::size_t i = 0; i < is_read.size(); ++i) {
+        if (is_read[i])
+            slots.push_back(i);
+    }
+    return slots;
+}
+
+bool expr::bind(
+    expr::evaluation_context& context,
+    const expr::compiled_expression& expression,
+    std::string_view name,
+    expr::quantity value
+) {
+    const auto slot = expr::find_slot(expression, name);
+    if (!slot)
+        return false;
+
+    expr::bind(context, *slot, value);
+    return true;
+}
+
+void expr::bind(
+    expr::evaluation_context& context,
+    std::size_t slot,
+    expr::quantity value
+) {
+    context.slots[slot] = value;
+    context.bound[slot] = 1;
+}
+
+void expr::unbind_all(expr::evaluation_context& context) {
+    std::fill(context.bound.begin(), context.bound.end(), 0);
+}
+
+std::optional<expr::quantity> expr::lookup(
+    const expr::evaluation_context& context,
+    const expr::compiled_expression& expression,
+    std::string_view name
+) {
+    const auto slot = expr::find_slot(expression, name);
+    if (!slot || !context.bound[*slot])
+        return std::nullopt;
+    return context.slots[*slot];
+}
@@ -1,14 +1,7 @@
 #include "derivator.h"
+#include "functions.h"
 #include "optimizer.h"
-
-#include <unordered_map>    // std::unordered_map
-
-using derivator_t = expr::derivator_result (*)(
-    const expr::node_ptr&,
-    std::string_view
-);
-
-using derivator_table = std::unordered_map<std::string, derivator_t>;
+#include "series.h"
 
 static constexpr expr::location_t empty_location = expr::location_t{
     .begin = 0,
@@ -79,6 +72,10 @@ static expr::derivator_result derive_binary_op(
     const expr::node_ptr& root,
     std::string_view variable
 ) {
+    // Comparisons are constant wherever they are differentiable.
+    if (expr::is_comparison(root->content))
+        return expr::make_number_literal_node("0", empty_location);
+
     auto left_d = derive(clone_node(root->children[0]), variable);
     if (!left_d)
         return left_d;
@@ -232,11 +229,11 @@ static expr::derivator_result derive_binary_op(
     return expr::error{
         .code = expr::error_code::DERIVATOR_GENERAL_ERROR,
         .location = root->location,
-        .description = "Unsupported binary operator: '" + root->content +  "'"
+        .description = {"Unsupported binary operator: '{0}'", root->content}
     };
 }
 
-static expr::derivator_result derive_sin(
+expr::derivator_result expr::derivatives::sin(
     const expr::node_ptr& root,
     std::string_view
 ) {
@@ -250,7 +247,7 @@ static expr::derivator_result derive_sin(
     );
 }
 
-static expr::derivator_result derive_cos(
+expr::derivator_result expr::derivatives::cos(
     const expr::node_ptr& root,
     std::string_view
 ) {
@@ -268,7 +265,7 @@ static expr::derivator_result derive_cos(
     );
 }
 
-static expr::derivator_result derive_tan(
+expr::derivator_result expr::derivatives::tan(
     const expr::node_ptr& root,
     std::string_view
 ) {
@@ -292,7 +289,7 @@ static expr::derivator_result derive_tan(
     );
 }
 
-static expr::derivator_result derive_ctg(
+expr::derivator_result expr::derivatives::ctg(
     const expr::node_ptr& root,
     std::string_view
 ) {
@@ -320,7 +317,7 @@ static expr::derivator_result derive_ctg(
     );
 }
 
-static expr::derivator_result derive_sec(
+expr::derivator_result expr::derivatives::sec(
     const expr::node_ptr& root,
     std::string_view
 ) {
@@ -346,7 +343,7 @@ static expr::derivator_result derive_sec(
     );
 }
 
-static expr::derivator_result derive_csc(
+expr::derivator_result expr::derivatives::csc(
     const expr::node_ptr& root,
     std::string_view
 ) {
@@ -376,18 +373,7 @@ static expr::derivator_result derive_csc(
     );
 }
 
-static expr::derivator_result derive_nonderivables(
-    const expr::node_ptr& root,
-    std::string_view
-) {
-    return expr::error{
-        .code = expr::error_code::DERIVATOR_FUNCTION_NOT_DERIVABLE,
-        .location = root->location,
-        .description = "Function " + root->content + "(...) can't be derived."
-    };
-}
-
-static expr::derivator_result derive_logarithms(
+expr::derivator_result expr::derivatives::logarithm(
     const expr::node_ptr& root,
     std::string_view
 ) {
@@ -459,41 +445,139 @@ static expr::derivator_result derive_logarithms(
     );
 }
 
-static const derivator_table& function_derivators() {
-    static const auto table = derivator_table{
-        {"sin", derive_sin},
-        {"cos", derive_cos},
-        {"tan", derive_tan},
-        {"ctg", derive_ctg},
-        {"sec", derive_sec},
-        {"csc", derive_csc},
-        {"round", derive_nonderivables},
-        {"floor", derive_nonderivables},
-        {"ceil", derive_nonderivables},
-        {"abs", derive_nonderivables},
-        {"ln", derive_logarithms},
-        {"log2", derive_logarithms},
-        {"log10", derive_logarithms},
-        {"log", derive_logarithms},
-        {"sgn", derive_nonderivables}
-    };
-    return table;
+// A series over the range of the series at the root.
+static expr::node_ptr make_series_node(
+    std::string name,
+    const expr::node_ptr& root,
+    expr::node_ptr&& body
+) {
+    std::vector<expr::node_ptr> arguments;
+    for (std::size_t i = 0; i < 3; ++i)
+        arguments.push_back(clone_node(root->children[i]));
+    arguments.push_back(std::move(body));
+    return expr::make_function_call_node(
+        std::move(name),
+        std::move(arguments),
+        empty_location
+    );
+}
+
+// A sum is the sum of the derivatives of its terms, and a product, by the
+// product rule, its value times the sum of the logarithmic derivatives of its
+// factors: "prod(k, a, b, f)' = prod(k, a, b, f) * sum(k, a, b, f' / f)".
+static expr::derivator_result derive_series(
+    const expr::node_ptr& root,
+    std::string_view variable
+) {
+    // The index hides the variable, so no term depends on it.
+    if (root->children[0]->content == variable)
+        return expr::make_number_literal_node("0", empty_location);
+
+    auto body = expr::derive(root->children[3], variable);
+    if (!body)
+        return body;
+    if ((*body)->type == expr::node_t::type_t::NUMBER && (*body)->content == "0")
+        return body;
+
+    if (root->content == "sum")
+        return make_series_node("sum", root, std::move(*body));
+
+    auto logarithmic = expr::make_binary_operator_node(
+        "/",
+        std::move(*body),
+        clone_node(root->children[3]),
+        empty_location
+    );
+    return expr::make_binary_operator_node(
+        "*",
+        clone_node(root),
+        make_series_node("sum", root, std::move(logarithmic)),
+        empty_location
+    );
 }
 
 static expr::derivator_result derive_function_call(
     const expr::node_ptr& root,
     std::string_view variable
 ) {
-    const auto& derivators = function_derivators();
-    if (derivators.count(root->content) != 0)
-        return derivators.at(root->content)(root, variable);
+    const auto& functions = expr::functions();
+    const auto where = functions.find(root->content);
+    if (where == functions.end() && expr::is_series(*root))
+        return derive_series(root, variable);
+
+    // Sums and means are linear, so they are the sum or mean of the
+    // derivatives of the values.
+    const auto is_linear = root->content == "sum" || root->content == "mean";
+    if (where == functions.end() && is_linear && root->children.size() == 1) {
+        auto derivative = expr::derive(root->children[0], variable);
+        if (!derivative)
+            return derivative;
+
+        std::vector<expr::node_ptr> arguments;
+        arguments.push_back(std::move(*derivative));
+        return expr::make_function_call_node(
+            root->content,
+            std::move(arguments),
+            empty_location
+        );
+    }
 
-    return expr::error{
-        .code = expr::error_code::DERIVATOR_GENERAL_ERROR,
-        .location = root->location,
-        .description = "Derivation is not implemented for " + root->content +
-                       "(...)."
-    };
+    if (where == functions.end()) {
+        return expr::error{
+            .code = expr::error_code::DERIVATOR_GENERAL_ERROR,
+            .location = root->location,
+            .description = {
+                "Derivation is not implemented for {0}(...).",
+                root->content
+            }
+        };
+    }
+
+    const auto rule = where->second.derivative;
+    if (rule == nullptr) {
+        return expr::error{
+            .code = expr::error_code::DERIVATOR_FUNCTION_NOT_DERIVABLE,
+            .location = root->location,
+            .description = {"Function {0}(...) can't be derived.", root->content}
+        };
+    }
+    return rule(root, variable);
+}
+
+static expr::derivator_result derive_array(
+    const expr::node_ptr& root,
+    std::string_view variable
+) {
+    std::vector<expr::node_ptr> elements;
+    for (const auto& element : root->children) {
+        auto derivative = expr::derive(element, variable);
+        if (!derivative)
+            return derivative;
+        elements.push_back(std::move(*derivative));
+    }
+    return expr::make_array_node(std::move(elements), empty_location);
+}
+
+// The derivative picks from the derivatives of the branches with the same
+// condition.
+static expr::derivator_result derive_conditional(
+    const expr::node_ptr& root,
+    std::string_view variable
+) {
+    auto then_d = expr::derive(root->children[1], variable);
+    if (!then_d)
+        return then_d;
+
+    auto else_d = expr::derive(root->children[2], variable);
+    if (!else_d)
+        return else_d;
+
+    return expr::make_conditional_node(
+        clone_node(root->children[0]),
+        std::move(*then_d),
+        std::move(*else_d),
+        empty_location
+    );
 }
 
 static expr::derivator_result derive_assignment(
@@ -547,6 +631,10 @@ expr::derivator_result expr::derive(
         FOR_NODE(ASSIGNMENT, derive_assignment(root, variable));
         FOR_NODE(UNIT, derivator_unit_unreachable());
         FOR_NODE(UNIT_APPLICATION, derive_unit_application(root, variable));
+        FOR_NODE(ARRAY, derive_array(root, variable));
+        FOR_NODE(CONDITIONAL, derive_conditional(root, variable));
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+            break;
     }
 
 #undef FOR_NODE
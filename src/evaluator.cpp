@@ -1,55 +1,117 @@
 #include "evaluator.h"
+#include "array.h"
+#include "series.h"
 #include "utility.h"
 
-#include <algorithm>        // std::transform
-#include <cmath>            // std::fmod, std::pow, M_PI
-#include <functional>       // std::function
-#include <iterator>         // std::back_inserter
+#include <array>            // std::array
+#include <cerrno>           // errno
+#include <cmath>            // std::fabs
+#include <cstdint>          // std::int64_t
+#include <cstdlib>          // std::strtod, std::strtof, std::strtold, std::strtoll
 #include <optional>         // std::optional
+#include <span>             // std::span
+#include <type_traits>      // std::is_same_v
+#include <utility>          // std::exchange
 
-static expr::evaluator_result evaluate_binary_operator(
-    const expr::node_ptr& node,
-    expr::symbol_table& symbols,
-    const expr::function_table& functions
+// Integral doubles below 2^53 are exact, so arithmetic on them is exact as
+// long as its result stays in that range. Like the compiled interpreter, the
+// evaluator redoes an operation in double with a larger operand or result on
+// 64-bit integers, and rounds the exact result to double once. The exact
+// value of the last large result is kept for the operator it is an operand
+// of, other large values, like those of variables and functions, are taken
+// as they are.
+struct exact_value_t {
+    double value;
+    std::optional<std::int64_t> exact;
+};
+
+static thread_local std::optional<exact_value_t> last_exact;
+
+static bool is_large(double value) {
+    return std::fabs(value) >= expr::max_exact_integer;
+}
+
+static std::optional<std::int64_t> exact_of(
+    double value,
+    const std::optional<exact_value_t>& computed
 ) {
-    using binary_operator = std::function<expr::function_result(expr::quantity, expr::quantity)>;
-    static const std::unordered_map<std::string, binary_operator> binary = {
-        {"+", expr::add},
-        {"-", expr::subtract},
-        {"*", expr::multiply},
-        {"/", expr::divide},
-        {"%", expr::modulo},
-        {"^", expr::power},
-    };
+    if (!is_large(value))
+        return expr::exact_integer(value);
+    if (computed && computed->value == value)
+        return computed->exact;
+    if (std::fabs(value) < 0x1p63)
+        return std::int64_t(value);
+    return std::nullopt;
+}
 
-    const auto left = expr::evaluate(node->children[0], symbols, functions);
-    const auto right = expr::evaluate(node->children[1], symbols, functions);
-    if (!left || !right) {
-        return expr::error{
-            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
-            .location = node->location,
-            .description = "Failed to evaluate operand."
-        };
-    }
+// Keeps the exact value of a result of a (large) operation, if there is one.
+static void make_exact(
+    char operation,
+    double lhs,
+    const std::optional<exact_value_t>& exact_lhs,
+    double rhs,
+    const std::optional<exact_value_t>& exact_rhs,
+    expr::quantity& result
+) {
+    auto exact = std::optional<std::int64_t>{};
+    const auto integer_lhs = exact_of(lhs, exact_lhs);
+    const auto integer_rhs = exact_of(rhs, exact_rhs);
+    if (integer_lhs && integer_rhs)
+        exact = expr::exact_operation(operation, *integer_lhs, *integer_rhs);
+    if (exact)
+        result.value = double(*exact);
+    last_exact = exact_value_t{result.value, exact};
+}
 
-    const auto& operator_fn = binary.at(node->content);
-    auto result = operator_fn(*left, *right);
-    if (!result) {
-        // HACK: The quantity class dictates the error, but the evaluator has
-        //       source location.
-        auto& error = result.error();
-        error.code = expr::error_code::EVALUATOR_DIVISION_BY_ZERO;
-        error.location = node->children[1]->location;
+// Results of nodes computing their value in some other way than an operator
+// are taken as they are.
+template <typename T>
+static expr::basic_evaluator_result<T> given(expr::basic_evaluator_result<T>&& result) {
+    if constexpr (std::is_same_v<T, double>)
+        last_exact.reset();
+    return std::move(result);
+}
+
+template <typename T>
+static expr::basic_evaluator_result<T> evaluate_binary_operator(
+    const expr::node_ptr& node,
+    expr::basic_symbol_table<T>& symbols,
+    const expr::function_table& functions
+) {
+    if constexpr (std::is_same_v<T, double>) {
+        const auto left = expr::evaluate(node->children[0], symbols, functions);
+        const auto exact_left = std::exchange(last_exact, std::nullopt);
+        const auto right = expr::evaluate(node->children[1], symbols, functions);
+        const auto exact_right = std::exchange(last_exact, std::nullopt);
+        auto result = expr::apply_binary_operator<T>(*node, left, right);
+        if (result && node->content.length() == 1 && (is_large(left->value)
+            || is_large(right->value) || is_large(result->value))) {
+            make_exact(
+                node->content[0],
+                left->value,
+                exact_left,
+                right->value,
+                exact_right,
+                *result
+            );
+        }
+        return result;
+    } else {
+        const auto left = expr::evaluate(node->children[0], symbols, functions);
+        const auto right = expr::evaluate(node->children[1], symbols, functions);
+        return expr::apply_binary_operator<T>(*node, left, right);
     }
-    return result;
 }
 
-static expr::evaluator_result evaluate_unary_operator(
+template <typename T>
+static expr::basic_evaluator_result<T> evaluate_unary_operator(
     const expr::node_ptr& node,
-    expr::symbol_table& symbols,
+    expr::basic_symbol_table<T>& symbols,
     const expr::function_table& functions
 ) {
-    using unary_operator = std::function<expr::function_result(expr::quantity)>;
+    using unary_operator = expr::basic_arithmetic_result<T> (*)(
+        expr::basic_quantity<T>
+    );
     static const std::unordered_map<std::string, unary_operator> unary = {
         {"+", expr::identity},
         {"-", expr::negate},
@@ -58,7 +120,13 @@ static expr::evaluator_result evaluate_unary_operator(
     const auto operand = expr::evaluate(node->children[0], symbols, functions);
     if (operand.has_value()) {
         const auto& operator_fn = unary.at(node->content);
-        return operator_fn(*operand);
+        auto result = operator_fn(*operand);
+        if constexpr (std::is_same_v<T, double>) {
+            const auto exact = std::exchange(last_exact, std::nullopt);
+            if (result && node->content == "-" && is_large(result->value))
+                make_exact('-', 0, std::nullopt, operand->value, exact, *result);
+        }
+        return result;
     }
 
     return expr::error{
@@ -68,35 +136,98 @@ static expr::evaluator_result evaluate_unary_operator(
     };
 }
 
-static expr::evaluator_result evaluate_number_literal(
-    const expr::node_ptr& node
+// Only the branch picked by the condition is evaluated, so the other one may
+// fail, or assign variables, without any effect. Any value other than zero
+// picks the first branch.
+template <typename T>
+static expr::basic_evaluator_result<T> evaluate_conditional(
+    const expr::node_ptr& node,
+    expr::basic_symbol_table<T>& symbols,
+    const expr::function_table& functions
 ) {
-    if (node->content.substr(0, 2) == "0b") {
-        return expr::make_scalar(
-            double(std::strtol(node->content.substr(2).c_str(), nullptr, 2))
-        );
-    }
-
-    if (node->content.length() == 0 || node->content[0] != '0')
-        return expr::make_scalar(std::strtod(node->content.c_str(), nullptr));
-
-    auto octal_char = [](char c) { return (c >= '0' && c <= '7'); };
-    if (!std::all_of(node->content.begin(), node->content.end(), octal_char)) {
+    auto failed_operand = [&] {
         return expr::error{
-            .code = expr::EVALUATOR_INVALID_NUMBER_LITERAL,
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
             .location = node->location,
-            .description = "Invalid numeric literal '" + node->content + "'."
+            .description = "Failed to evaluate operand."
         };
-    }
+    };
 
-    return expr::make_scalar(
-        double(std::strtol(node->content.substr(1).c_str(), nullptr, 8))
-    );
+    const auto condition = expr::evaluate(node->children[0], symbols, functions);
+    if (!condition)
+        return failed_operand();
+
+    const auto& branch = node->children[condition->value != 0 ? 1 : 2];
+    auto result = expr::evaluate(branch, symbols, functions);
+    if (!result)
+        return failed_operand();
+    return result;
+}
+
+// Decimal literals are rounded to the value type once, not through double.
+template <typename T>
+static T parse_decimal(const char *text, char **end) {
+    if constexpr (std::is_same_v<T, float>)
+        return std::strtof(text, end);
+    else if constexpr (std::is_same_v<T, long double>)
+        return std::strtold(text, end);
+    else
+        return T(std::strtod(text, end));
 }
 
-static expr::evaluator_result evaluate_unit_application(
+static expr::error make_invalid_literal_error(const expr::node_ptr& node) {
+    return expr::error{
+        .code = expr::EVALUATOR_INVALID_NUMBER_LITERAL,
+        .location = node->location,
+        .description = {"Invalid numeric literal '{0}'.", node->content}
+    };
+}
+
+// The tokenizer lets through literals like "0x", "0x1.8" or "1e", so the
+// whole text after the prefix has to be read, and integers have to fit into
+// 64 bits rather than saturate.
+template <typename T>
+static expr::basic_evaluator_result<T> parse_integer(
     const expr::node_ptr& node,
-    expr::symbol_table& symbols,
+    std::size_t prefix,
+    int base
+) {
+    const char *digits = node->content.c_str() + prefix;
+    char *end = nullptr;
+    errno = 0;
+    const auto value = std::strtoll(digits, &end, base);
+    if (end == digits || *end != '\0' || errno != 0)
+        return make_invalid_literal_error(node);
+    return expr::make_scalar<T>(T(value));
+}
+
+template <typename T>
+static expr::basic_evaluator_result<T> evaluate_number_literal(
+    const expr::node_ptr& node
+) {
+    if (node->content.substr(0, 2) == "0b")
+        return parse_integer<T>(node, 2, 2);
+
+    if (node->content.substr(0, 2) == "0x")
+        return parse_integer<T>(node, 2, 16);
+
+    // Only integers with a leading zero are octal, "0.5" is decimal.
+    const auto is_integer = node->content.find_first_of(".eE") == std::string::npos;
+    if (node->content.length() > 1 && node->content[0] == '0' && is_integer)
+        return parse_integer<T>(node, 1, 8);
+
+    // Decimals out of range are left to IEEE 754, so "1e999" is infinite.
+    char *end = nullptr;
+    const auto value = parse_decimal<T>(node->content.c_str(), &end);
+    if (*end != '\0')
+        return make_invalid_literal_error(node);
+    return expr::make_scalar<T>(value);
+}
+
+template <typename T>
+static expr::basic_evaluator_result<T> evaluate_unit_application(
+    const expr::node_ptr& node,
+    expr::basic_symbol_table<T>& symbols,
     const expr::function_table& functions
 ) {
     const auto& unit = node->children[1]->content;
@@ -108,55 +239,208 @@ static expr::evaluator_result evaluate_unit_application(
     if (!subexpression)
         return subexpression.error();
 
-    if (unit == "mm")
-        return expr::multiply(*subexpression, expr::make_length(0.001));
+    const auto factor = expr::make_unit<T>(unit);
+    if (!factor)
+        return factor.error();
 
-    if (unit == "cm")
-        return expr::multiply(*subexpression, expr::make_length(0.01));
+    auto result = expr::multiply(*subexpression, *factor);
+    if constexpr (std::is_same_v<T, double>) {
+        const auto exact = std::exchange(last_exact, std::nullopt);
+        if (result && (is_large(subexpression->value) || is_large(result->value))) {
+            make_exact(
+                '*',
+                subexpression->value,
+                exact,
+                factor->value,
+                std::nullopt,
+                *result
+            );
+        }
+    }
+    return result;
+}
 
-    if (unit == "m")
-        return expr::multiply(*subexpression, expr::make_length(1));
+// The resolver of the tree evaluation in progress on the thread, if any.
+static thread_local const expr::variable_resolver *active_resolver = nullptr;
 
-    if (unit == "km")
-        return expr::multiply(*subexpression, expr::make_length(1000));
+template <typename T>
+static const expr::basic_quantity<T> *lookup_variable(
+    const std::string& name,
+    expr::basic_symbol_table<T>& symbols
+) {
+    auto where = symbols.find(name);
+    if (where != symbols.end())
+        return &where->second;
+    if (active_resolver == nullptr)
+        return nullptr;
 
-    if (unit == "deg")
-        return expr::multiply(*subexpression, expr::make_angle(M_PI / 180));
+    const auto value = (*active_resolver)(name);
+    if (!value)
+        return nullptr;
+    const auto converted = expr::basic_quantity<T>{value->unit, T(value->value)};
+    return &symbols.emplace(name, converted).first->second;
+}
 
-    if (unit == "rad")
-        return expr::multiply(*subexpression, expr::make_angle(1));
+template <typename T>
+static expr::basic_evaluator_result<T> evaluate_variable_reference(
+    const expr::node_ptr& node,
+    expr::basic_symbol_table<T>& symbols
+) {
+    const auto *value = lookup_variable(node->content, symbols);
+    if (value == nullptr) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_UNDEFINED_VARIABLE,
+            .location = node->location,
+            .description = {"Undefined variable '{0}'.", node->content}
+        };
+    }
+    return *value;
+}
 
-    // Unreachable
-    return expr::error{
-        .code = expr::error_code::EVALUATOR_REACHED_UNREACHABLE_CODE_PATH,
-        .location = {},
-        .description = "The evaluator has reached a supposedly unreachable "
-                       "code path."
-    };
+// The number of calls to user functions being evaluated by the thread.
+static thread_local std::size_t call_depth = 0;
+
+template <typename T>
+static expr::basic_evaluator_result<T> evaluate_user_function_call(
+    const expr::node_ptr& node,
+    const expr::function_definition_t& definition,
+    expr::basic_symbol_table<T>& symbols,
+    const expr::function_table& functions
+) {
+    const auto count = node->children.size();
+    if (auto error = expr::validate_argument_count(definition, count, node->location))
+        return std::move(*error);
+
+    if (call_depth == expr::max_call_depth) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_CALL_DEPTH_EXCEEDED,
+            .location = node->location,
+            .description = {
+                "Function calls are nested deeper than {0} levels.",
+                expr::max_call_depth
+            }
+        };
+    }
+
+    std::vector<expr::basic_quantity<T>> arguments;
+    arguments.reserve(count);
+    for (const auto& child : node->children) {
+        auto result = expr::evaluate(child, symbols, functions);
+        if (!result) {
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+                .location = node->location,
+                .description = {
+                    "Failed to evaluate function arguments for '{0}()'.",
+                    node->content
+                }
+            };
+        }
+        arguments.push_back(*result);
+    }
+
+    // The parameters hide the variables of the same name while the body is
+    // evaluated.
+    const auto& function = *definition.user_function;
+    std::vector<std::optional<expr::basic_quantity<T>>> hidden(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto& parameter = function.parameters[i];
+        if (auto where = symbols.find(parameter); where != symbols.end())
+            hidden[i] = where->second;
+        symbols.insert_or_assign(parameter, arguments[i]);
+    }
+
+    ++call_depth;
+    auto result = expr::evaluate(function.body, symbols, functions);
+    --call_depth;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto& parameter = function.parameters[i];
+        if (hidden[i])
+            symbols.insert_or_assign(parameter, *hidden[i]);
+        else
+            symbols.erase(parameter);
+    }
+
+    // The body is not part of the expression, so its errors are reported at
+    // the call.
+    if (!result)
+        result.error().location = node->location;
+    return result;
 }
 
-static expr::evaluator_result evaluate_variable_reference(
+// Array literals and reductions are evaluated by the array evaluator, in
+// double, and have to give a single value.
+template <typename T>
+static expr::basic_evaluator_result<T> evaluate_array_expression(
     const expr::node_ptr& node,
-    const expr::symbol_table& symbols
+    expr::basic_symbol_table<T>& symbols,
+    const expr::function_table& functions
 ) {
-    auto where = symbols.find(node->content);
-    if (where == symbols.end()) {
+    auto evaluate = [&](expr::symbol_table& table) {
+        return expr::evaluate_array(node, table, expr::array_table{}, functions);
+    };
+
+    auto result = expr::array_result{expr::quantity_column{}};
+    if constexpr (std::is_same_v<T, double>) {
+        result = evaluate(symbols);
+    } else {
+        expr::symbol_table table;
+        for (const auto& [name, value] : symbols)
+            table[name] = expr::quantity{value.unit, double(value.value)};
+        result = evaluate(table);
+        for (const auto& [name, value] : table)
+            symbols[name] = expr::basic_quantity<T>{value.unit, T(value.value)};
+    }
+
+    if (!result)
+        return std::move(result.error());
+    if (result->size() != 1) {
         return expr::error{
-            .code = expr::error_code::EVALUATOR_UNDEFINED_VARIABLE,
+            .code = expr::error_code::EVALUATOR_ARRAY_AS_SINGLE_VALUE,
             .location = node->location,
-            .description = "Undefined variable '" + node->content + "'."
+            .description = {
+                "An array of {0} values can't be used as a single value.",
+                result->size()
+            }
         };
     }
-    return where->second;
+    return expr::basic_quantity<T>{result->unit, T(result->values[0])};
 }
 
-static expr::evaluator_result evaluate_function_call(
+// Series are evaluated in double as well, by the series evaluator.
+template <typename T>
+static expr::basic_evaluator_result<T> evaluate_series_expression(
     const expr::node_ptr& node,
-    expr::symbol_table& symbols,
+    expr::basic_symbol_table<T>& symbols,
+    const expr::function_table& functions
+) {
+    if constexpr (std::is_same_v<T, double>) {
+        return expr::evaluate_series(node, symbols, functions);
+    } else {
+        expr::symbol_table table;
+        for (const auto& [name, value] : symbols)
+            table[name] = expr::quantity{value.unit, double(value.value)};
+        const auto result = expr::evaluate_series(node, table, functions);
+        if (!result)
+            return result.error();
+        return expr::basic_quantity<T>{result->unit, T(result->value)};
+    }
+}
+
+template <typename T>
+static expr::basic_evaluator_result<T> evaluate_function_call(
+    const expr::node_ptr& node,
+    expr::basic_symbol_table<T>& symbols,
     const expr::function_table& functions
 ) {
     auto where = functions.find(node->content);
     if (where == functions.end()) {
+        if (expr::is_series(*node))
+            return evaluate_series_expression(node, symbols, functions);
+        if (expr::is_reduction(node->content))
+            return given(evaluate_array_expression(node, symbols, functions));
+
         const auto& location = node->location.begin;
         return expr::error{
             .code = expr::error_code::EVALUATOR_UNDEFINED_FUNCTION,
@@ -164,43 +448,65 @@ static expr::evaluator_result evaluate_function_call(
                 .begin = location,
                 .end = location + node->content.length() - 1
             },
-            .description = "Undefined function '" + node->content + "'."
+            .description = {"Undefined function '{0}'.", node->content}
         };
     }
 
-    const auto& implementation = where->second.implementation;
-
-    bool failed = false;
-    std::vector<expr::quantity> evaluated;
-    std::transform(
-        node->children.begin(),
-        node->children.end(),
-        std::back_inserter(evaluated),
-        [&] (const expr::node_ptr& unevaluated) {
-            if (failed)
-                return expr::make_scalar(0);
-            if (auto result = expr::evaluate(unevaluated, symbols, functions))
-                return *result;
-            failed = true;
-            return expr::make_scalar(0);
+    const auto& definition = where->second;
+    if (definition.user_function != nullptr)
+        return evaluate_user_function_call(node, definition, symbols, functions);
+
+    auto evaluate_arguments = [&](std::span<expr::basic_quantity<T>> evaluated) {
+        for (std::size_t i = 0; i < evaluated.size(); ++i) {
+            auto result = expr::evaluate(node->children[i], symbols, functions);
+            if (!result)
+                return false;
+            evaluated[i] = *result;
         }
-    );
+        return true;
+    };
 
-    if (failed) {
+    auto failed_arguments = [&] {
         return expr::error{
             .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
             .location = node->location,
-            .description = "Failed to evaluate function arguments for '" +
-                           node->content + "()'."
+            .description = {
+                "Failed to evaluate function arguments for '{0}()'.",
+                node->content
+            }
         };
+    };
+
+    // Functions of the legacy calling convention get their arguments in a
+    // vector, through the adapter in expr::invoke(), as do functions without
+    // a builtin for the value type.
+    const auto builtin = expr::builtin_for<T>(definition);
+    if (builtin == nullptr) {
+        std::vector<expr::basic_quantity<T>> evaluated(node->children.size());
+        if (!evaluate_arguments(evaluated))
+            return failed_arguments();
+        return expr::invoke<T>(definition, evaluated, node->location);
     }
 
-    return implementation(evaluated, node->location);
+    const auto count = node->children.size();
+    if (auto error = expr::validate_argument_count(definition, count, node->location))
+        return std::move(*error);
+
+    std::array<expr::basic_quantity<T>, expr::max_builtin_arity> buffer;
+    const auto evaluated = std::span(buffer).first(count);
+    if (!evaluate_arguments(evaluated))
+        return failed_arguments();
+
+    if (auto error = expr::validate_arguments<T>(definition, evaluated, node->location))
+        return std::move(*error);
+
+    return builtin(evaluated, node->location);
 }
 
-static expr::evaluator_result evaluate_assignment(
+template <typename T>
+static expr::basic_evaluator_result<T> evaluate_assignment(
     const expr::node_ptr& node,
-    expr::symbol_table& symbols,
+    expr::basic_symbol_table<T>& symbols,
     const expr::function_table& functions
 ) {
     auto result = expr::evaluate(node->children[1], symbols, functions);
@@ -216,9 +522,10 @@ static expr::evaluator_result evaluate_assignment(
     return result;
 }
 
-expr::evaluator_result expr::evaluate(
+template <typename T>
+expr::basic_evaluator_result<T> expr::evaluate(
     const expr::node_ptr& node,
-    expr::symbol_table& symbols,
+    expr::basic_symbol_table<T>& symbols,
     const expr::function_table& functions
 ) {
     switch (node->type) {
@@ -227,17 +534,28 @@ expr::evaluator_result expr::evaluate(
         case expr::node_t::type_t::UNARY_OP:
             return evaluate_unary_operator(node, symbols, functions);
         case expr::node_t::type_t::NUMBER:
-            return evaluate_number_literal(node);
+            return given(evaluate_number_literal<T>(node));
         case expr::node_t::type_t::VARIABLE:
-            return evaluate_variable_reference(node, symbols);
+            return given(evaluate_variable_reference(node, symbols));
         case expr::node_t::type_t::FUNCTION_CALL:
-            return evaluate_function_call(node, symbols, functions);
+            return given(evaluate_function_call(node, symbols, functions));
         case expr::node_t::type_t::ASSIGNMENT:
             return evaluate_assignment(node, symbols, functions);
         case expr::node_t::type_t::UNIT:
             break;
         case expr::node_t::type_t::UNIT_APPLICATION:
             return evaluate_unit_application(node, symbols, functions);
+        case expr::node_t::type_t::ARRAY:
+            return given(evaluate_array_expression(node, symbols, functions));
+        case expr::node_t::type_t::CONDITIONAL:
+            return evaluate_conditional(node, symbols, functions);
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_UNREGISTERED_FUNCTION_DEFINITION,
+                .location = node->location,
+                .description = "Function definitions have no value, they have to "
+                               "be registered."
+            };
     }
 
     // Unreachable
@@ -249,7 +567,110 @@ expr::evaluator_result expr::evaluate(
     };
 }
 
+expr::evaluator_result expr::evaluate(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    const expr::variable_resolver& resolver
+) {
+    // Evaluations nested in this one, like that of a reduction by the array
+    // evaluator, find the resolver through find_variable().
+    const auto *previous = std::exchange(
+        active_resolver,
+        resolver ? &resolver : nullptr
+    );
+    auto result = expr::evaluate(node, symbols, functions);
+    active_resolver = previous;
+    return result;
+}
+
+std::optional<expr::quantity> expr::find_variable(
+    const std::string& name,
+    expr::symbol_table& symbols
+) {
+    if (const auto *value = lookup_variable(name, symbols))
+        return *value;
+    return std::nullopt;
+}
+
 expr::evaluator_result expr::evaluate_parse_time(const expr::node_ptr& node) {
     expr::symbol_table table;
     return expr::evaluate(node, table, expr::function_table{});
 }
+
+template <typename T>
+expr::basic_evaluator_result<T> expr::apply_binary_operator(
+    const expr::node_t& node,
+    const expr::basic_evaluator_result<T>& left,
+    const expr::basic_evaluator_result<T>& right
+) {
+    using binary_operator = expr::basic_arithmetic_result<T> (*)(
+        expr::basic_quantity<T>,
+        expr::basic_quantity<T>
+    );
+    static const std::unordered_map<std::string, binary_operator> binary = {
+        {"+", expr::add},
+        {"-", expr::subtract},
+        {"*", expr::multiply},
+        {"/", expr::divide},
+        {"%", expr::modulo},
+        {"^", expr::power},
+        {"<", expr::less},
+        {"<=", expr::less_equal},
+        {">", expr::greater},
+        {">=", expr::greater_equal},
+        {"==", expr::equal},
+        {"!=", expr::not_equal},
+    };
+
+    if (!left || !right) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+            .location = node.location,
+            .description = "Failed to evaluate operand."
+        };
+    }
+
+    const auto operator_fn = binary.at(node.content);
+    auto result = operator_fn(*left, *right);
+    if (!result) {
+        // HACK: The quantity class dictates the error, but the evaluator has
+        //       source location.
+        auto& error = result.error();
+        error.code = expr::operator_error_code(error.code);
+        error.location = node.children[1]->location;
+    }
+    return result;
+}
+
+expr::error_code expr::operator_error_code(expr::error_code code) {
+    switch (code) {
+        case expr::error_code::QUANTITY_INVALID_BINARY_OPERATION:
+        case expr::error_code::QUANTITY_EXPECTED_SAME_UNIT:
+            return expr::error_code::EVALUATOR_MISMATCHED_UNITS;
+        case expr::error_code::QUANTITY_UNIT_OUT_OF_RANGE:
+            return expr::error_code::EVALUATOR_UNIT_OUT_OF_RANGE;
+        case expr::error_code::EVALUATOR_MISMATCHED_ARRAY_SIZES:
+            return code;
+        default:
+            return expr::error_code::EVALUATOR_DIVISION_BY_ZERO;
+    }
+}
+
+#define EXPR_INSTANTIATE_EVALUATOR(T)                                          \
+    template expr::basic_evaluator_result<T> expr::evaluate(                   \
+        const expr::node_ptr&,                                                 \
+        expr::basic_symbol_table<T>&,                                          \
+        const expr::function_table&                                            \
+    );                                                                         \
+    template expr::basic_evaluator_result<T> expr::apply_binary_operator(      \
+        const expr::node_t&,                                                   \
+        const expr::basic_evaluator_result<T>&,                                \
+        const expr::basic_evaluator_result<T>&                                 \
+    )
+
+EXPR_INSTANTIATE_EVALUATOR(float);
+EXPR_INSTANTIATE_EVALUATOR(double);
+EXPR_INSTANTIATE_EVALUATOR(long double);
+
+#undef EXPR_INSTANTIATE_EVALUATOR
@@ -1,127 +1,423 @@
 #include "functions.h"
 #include "quantity.h"
 
+#include <array>            // std::array
 #include <cfloat>           // DBL_EPSILON
 #include <cmath>            // all math functions
+#include <string>           // std::to_string
 
 #define EXPR_BUILTIN_FUNCTION(NAME)                                            \
-    static expr::function_result NAME(                                         \
-        const std::vector<expr::quantity>& parameters,                         \
-        const expr::location_t& location                                       \
+    template <typename T>                                                      \
+    static expr::basic_function_result<T> NAME(                                \
+        std::span<const expr::basic_quantity<T>> parameters,                   \
+        const expr::location_t&                                                \
     ) noexcept
 
-#define EXPR_CHECK_PARAMETER_COUNT(N)                                          \
-    if (parameters.size() != N) {                                              \
-        return expr::error{                                                    \
-            expr::error_code::EVALUATOR_WRONG_ARGUMENT_COUNT,                  \
-            location,                                                          \
-            #N " argument(s) expected."                                        \
-        };                                                                     \
-    }
+#define EXPR_BUILTIN(NAME)                                                     \
+    .builtin = NAME<double>,                                                   \
+    .float_builtin = NAME<float>,                                              \
+    .long_double_builtin = NAME<long double>
 
-#define EXPR_CHECK_PARAMETER_TYPE(N, TYPE)                                     \
-    if (!parameters[N].is_ ## TYPE ()) {                                       \
-        return expr::error{                                                    \
-            expr::error_code::EVALUATOR_WRONG_ARGUMENT_TYPE,                   \
-            location,                                                          \
-            "Argument at position " #N " is expected to be a " #TYPE "."       \
-        };                                                                     \
-    }
+#define EXPR_LEGACY_IMPLEMENTATION(NAME)                                       \
+    .implementation = legacy_builtin<NAME<double>>
+
+#define EXPR_PARAMETER(TYPE)                                                   \
+    expr::parameter_t{#TYPE, &expr::measurement_unit::is_ ## TYPE}
+
+#define EXPR_ANY_PARAMETER                                                     \
+    expr::parameter_t{"any", nullptr}
 
 EXPR_BUILTIN_FUNCTION(sine) {
-    EXPR_CHECK_PARAMETER_COUNT(1);
-    EXPR_CHECK_PARAMETER_TYPE(0, angle);
-    return expr::make_scalar(std::sin(parameters[0].value));
+    return expr::make_scalar<T>(std::sin(parameters[0].value));
 }
 
 EXPR_BUILTIN_FUNCTION(cosine) {
-    EXPR_CHECK_PARAMETER_COUNT(1);
-    EXPR_CHECK_PARAMETER_TYPE(0, angle);
-    return expr::make_scalar(std::cos(parameters[0].value));
+    return expr::make_scalar<T>(std::cos(parameters[0].value));
 }
 
 EXPR_BUILTIN_FUNCTION(round) {
-    EXPR_CHECK_PARAMETER_COUNT(1);
-    EXPR_CHECK_PARAMETER_TYPE(0, scalar);
-    return expr::make_scalar(std::round(parameters[0].value));
+    return expr::make_scalar<T>(std::round(parameters[0].value));
 }
 
 EXPR_BUILTIN_FUNCTION(floor) {
-    EXPR_CHECK_PARAMETER_COUNT(1);
-    EXPR_CHECK_PARAMETER_TYPE(0, scalar);
-    return expr::make_scalar(std::floor(parameters[0].value));
+    return expr::make_scalar<T>(std::floor(parameters[0].value));
 }
 
 EXPR_BUILTIN_FUNCTION(ceiling) {
-    EXPR_CHECK_PARAMETER_COUNT(1);
-    EXPR_CHECK_PARAMETER_TYPE(0, scalar);
-    return expr::make_scalar(std::ceil(parameters[0].value));
+    return expr::make_scalar<T>(std::ceil(parameters[0].value));
 }
 
 EXPR_BUILTIN_FUNCTION(absolute) {
-    EXPR_CHECK_PARAMETER_COUNT(1);
     auto result = parameters[0];
     result.value = std::abs(result.value);
     return result;
 }
 
 EXPR_BUILTIN_FUNCTION(log_n) {
-    EXPR_CHECK_PARAMETER_COUNT(1);
-    EXPR_CHECK_PARAMETER_TYPE(0, scalar);
-    return expr::make_scalar(std::log(parameters[0].value));
+    return expr::make_scalar<T>(std::log(parameters[0].value));
 }
 
 EXPR_BUILTIN_FUNCTION(log_2) {
-    EXPR_CHECK_PARAMETER_COUNT(1);
-    EXPR_CHECK_PARAMETER_TYPE(0, scalar);
-    return expr::make_scalar(std::log2(parameters[0].value));
+    return expr::make_scalar<T>(std::log2(parameters[0].value));
 }
 
 EXPR_BUILTIN_FUNCTION(log_10) {
-    EXPR_CHECK_PARAMETER_COUNT(1);
-    EXPR_CHECK_PARAMETER_TYPE(0, scalar);
-    return expr::make_scalar(std::log10(parameters[0].value));
+    return expr::make_scalar<T>(std::log10(parameters[0].value));
 }
 
 EXPR_BUILTIN_FUNCTION(log_any) {
-    EXPR_CHECK_PARAMETER_COUNT(2);
-    EXPR_CHECK_PARAMETER_TYPE(0, scalar);
-    EXPR_CHECK_PARAMETER_TYPE(1, scalar);
     const auto& value = parameters[0].value;
     const auto& base = parameters[1].value;
-    return expr::make_scalar(std::log10(value) / std::log10(base));
+    return expr::make_scalar<T>(std::log10(value) / std::log10(base));
 }
 
 EXPR_BUILTIN_FUNCTION(sign) {
-    EXPR_CHECK_PARAMETER_COUNT(1);
     if (std::fabs(parameters[0].value) < DBL_EPSILON)
-        return expr::make_scalar(0);
+        return expr::make_scalar<T>(0);
     if (parameters[0].value < 0)
-        return expr::make_scalar(-1);
-    return expr::make_scalar(1);
+        return expr::make_scalar<T>(-1);
+    return expr::make_scalar<T>(1);
+}
+
+static const expr::function_definition_t *find_builtin(expr::builtin_t builtin) {
+    for (const auto& [name, definition] : expr::functions()) {
+        if (definition.builtin == builtin)
+            return &definition;
+    }
+    return nullptr;
+}
+
+// Lets callers of the legacy calling convention call builtins, which rely on
+// their caller to validate the arguments, so the call goes through invoke().
+template <expr::builtin_t Builtin>
+static expr::function_result legacy_builtin(
+    const std::vector<expr::quantity>& arguments,
+    const expr::location_t& location
+) {
+    static const auto *definition = find_builtin(Builtin);
+    const auto span = std::span<const expr::quantity>(arguments);
+    if (definition == nullptr)
+        return Builtin(span, location);
+    return expr::invoke(*definition, span, location);
 }
 
 const expr::function_table& expr::functions() {
     static const auto table = expr::function_table{
-        {std::string{"sin"}, expr::function_definition_t{sine, "sin(x: angle) -> scalar"}},
-        {std::string{"cos"}, expr::function_definition_t{cosine, "cos(x: angle) -> scalar"}},
-        // {std::string{"tan"}, expr::function_definition_t{tangent, "tan(x: angle) -> scalar"}},
-        // {std::string{"ctg"}, expr::function_definition_t{cotangent, "ctg(x: angle) -> scalar"}},
-        // {std::string{"sec"}, expr::function_definition_t{secant, "sec(x: angle) -> scalar"}},
-        // {std::string{"csc"}, expr::function_definition_t{cosecant, "csc(x: angle) -> scalar"}},
-        {std::string{"round"}, expr::function_definition_t{round, "round(x: scalar) -> scalar"}},
-        {std::string{"floor"}, expr::function_definition_t{floor, "floor(x: scalar) -> scalar"}},
-        {std::string{"ceil"}, expr::function_definition_t{ceiling, "ceil(x: scalar) -> scalar"}},
-        {std::string{"abs"}, expr::function_definition_t{absolute, "abs(x: any) -> any"}},
-        {std::string{"ln"}, expr::function_definition_t{log_n, "ln(x: scalar) -> scalar"}},
-        {std::string{"log2"}, expr::function_definition_t{log_2, "log2(x: scalar) -> scalar"}},
-        {std::string{"log10"}, expr::function_definition_t{log_10, "log10(x: scalar) -> scalar"}},
-        {std::string{"log"}, expr::function_definition_t{log_any, "log(x: scalar, base: scalar) -> scalar"}},
-        {std::string{"sgn"}, expr::function_definition_t{sign, "sgn(x: any) -> scalar"}},
+        {std::string{"sin"}, expr::function_definition_t{
+            EXPR_LEGACY_IMPLEMENTATION(sine),
+            .signature = "sin(x: angle) -> scalar",
+            .batch_implementation = expr::kernels::sin,
+            .interval_implementation = expr::intervals::sin,
+            EXPR_BUILTIN(sine),
+            .parameters = {EXPR_PARAMETER(angle)},
+            .is_pure = true,
+            .cost = 20,
+            .derivative = expr::derivatives::sin,
+        }},
+        {std::string{"cos"}, expr::function_definition_t{
+            EXPR_LEGACY_IMPLEMENTATION(cosine),
+            .signature = "cos(x: angle) -> scalar",
+            .batch_implementation = expr::kernels::cos,
+            .interval_implementation = expr::intervals::cos,
+            EXPR_BUILTIN(cosine),
+            .parameters = {EXPR_PARAMETER(angle)},
+            .is_pure = true,
+            .cost = 20,
+            .derivative = expr::derivatives::cos,
+        }},
+        // tan, ctg, sec and csc are not implemented yet.
+        {std::string{"round"}, expr::function_definition_t{
+            EXPR_LEGACY_IMPLEMENTATION(round),
+            .signature = "round(x: scalar) -> scalar",
+            .batch_implementation = expr::kernels::round,
+            .interval_implementation = expr::intervals::round,
+            EXPR_BUILTIN(round),
+            .parameters = {EXPR_PARAMETER(scalar)},
+            .is_pure = true,
+            .cost = 2,
+        }},
+        {std::string{"floor"}, expr::function_definition_t{
+            EXPR_LEGACY_IMPLEMENTATION(floor),
+            .signature = "floor(x: scalar) -> scalar",
+            .batch_implementation = expr::kernels::floor,
+            .interval_implementation = expr::intervals::floor,
+            EXPR_BUILTIN(floor),
+            .parameters = {EXPR_PARAMETER(scalar)},
+            .is_pure = true,
+            .cost = 2,
+        }},
+        {std::string{"ceil"}, expr::function_definition_t{
+            EXPR_LEGACY_IMPLEMENTATION(ceiling),
+            .signature = "ceil(x: scalar) -> scalar",
+            .batch_implementation = expr::kernels::ceil,
+            .interval_implementation = expr::intervals::ceil,
+            EXPR_BUILTIN(ceiling),
+            .parameters = {EXPR_PARAMETER(scalar)},
+            .is_pure = true,
+            .cost = 2,
+        }},
+        {std::string{"abs"}, expr::function_definition_t{
+            EXPR_LEGACY_IMPLEMENTATION(absolute),
+            .signature = "abs(x: any) -> any",
+            .batch_implementation = expr::kernels::abs,
+            .interval_implementation = expr::intervals::abs,
+            EXPR_BUILTIN(absolute),
+            .parameters = {EXPR_ANY_PARAMETER},
+            .is_pure = true,
+            .cost = 1,
+        }},
+        {std::string{"ln"}, expr::function_definition_t{
+            EXPR_LEGACY_IMPLEMENTATION(log_n),
+            .signature = "ln(x: scalar) -> scalar",
+            .batch_implementation = expr::kernels::ln,
+            .interval_implementation = expr::intervals::ln,
+            EXPR_BUILTIN(log_n),
+            .parameters = {EXPR_PARAMETER(scalar)},
+            .is_pure = true,
+            .cost = 20,
+            .derivative = expr::derivatives::logarithm,
+        }},
+        {std::string{"log2"}, expr::function_definition_t{
+            EXPR_LEGACY_IMPLEMENTATION(log_2),
+            .signature = "log2(x: scalar) -> scalar",
+            .batch_implementation = expr::kernels::log2,
+            .interval_implementation = expr::intervals::log2,
+            EXPR_BUILTIN(log_2),
+            .parameters = {EXPR_PARAMETER(scalar)},
+            .is_pure = true,
+            .cost = 20,
+            .derivative = expr::derivatives::logarithm,
+        }},
+        {std::string{"log10"}, expr::function_definition_t{
+            EXPR_LEGACY_IMPLEMENTATION(log_10),
+            .signature = "log10(x: scalar) -> scalar",
+            .batch_implementation = expr::kernels::log10,
+            .interval_implementation = expr::intervals::log10,
+            EXPR_BUILTIN(log_10),
+            .parameters = {EXPR_PARAMETER(scalar)},
+            .is_pure = true,
+            .cost = 20,
+            .derivative = expr::derivatives::logarithm,
+        }},
+        {std::string{"log"}, expr::function_definition_t{
+            EXPR_LEGACY_IMPLEMENTATION(log_any),
+            .signature = "log(x: scalar, base: scalar) -> scalar",
+            .batch_implementation = expr::kernels::log,
+            .interval_implementation = expr::intervals::log,
+            EXPR_BUILTIN(log_any),
+            .parameters = {EXPR_PARAMETER(scalar), EXPR_PARAMETER(scalar)},
+            .is_pure = true,
+            .cost = 40,
+            .derivative = expr::derivatives::logarithm,
+        }},
+        {std::string{"sgn"}, expr::function_definition_t{
+            EXPR_LEGACY_IMPLEMENTATION(sign),
+            .signature = "sgn(x: any) -> scalar",
+            .batch_implementation = expr::kernels::sgn,
+            .interval_implementation = expr::intervals::sgn,
+            EXPR_BUILTIN(sign),
+            .parameters = {EXPR_ANY_PARAMETER},
+            .is_pure = true,
+            .cost = 2,
+        }},
     };
     return table;
 }
 
+std::optional<expr::error> expr::define_function(
+    expr::function_table& functions,
+    expr::node_ptr&& definition
+) {
+    const auto& name = definition->content;
+    const auto where = functions.find(name);
+    if (where != functions.end() && where->second.user_function == nullptr) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_BUILTIN_REDEFINITION,
+            .location = definition->location,
+            .description = {"Builtin function '{0}()' can't be redefined.", name}
+        };
+    }
+
+    auto function = std::make_shared<expr::user_function_t>();
+    function->name = name;
+    auto signature = expr::to_expression_string(definition);
+    auto parameters = std::vector<expr::parameter_t>{};
+    for (std::size_t i = 0; i + 1 < definition->children.size(); ++i) {
+        function->parameters.push_back(definition->children[i]->content);
+        parameters.push_back(EXPR_ANY_PARAMETER);
+    }
+    function->body = std::move(definition->children.back());
+
+    functions[name] = expr::function_definition_t{
+        .implementation = nullptr,
+        .signature = std::move(signature),
+        .parameters = std::move(parameters),
+        .user_function = std::move(function),
+    };
+    return std::nullopt;
+}
+
+// Functions of the legacy calling convention validate their own arguments.
+static bool has_parameter_list(const expr::function_definition_t& definition) {
+    return definition.builtin != nullptr
+        || definition.native_function != nullptr
+        || definition.user_function != nullptr;
+}
+
+std::optional<expr::error> expr::validate_argument_count(
+    const expr::function_definition_t& definition,
+    std::size_t count,
+    const expr::location_t& location
+) {
+    if (!has_parameter_list(definition))
+        return std::nullopt;
+
+    const auto expected = definition.parameters.size();
+    if (count != expected) {
+        return expr::error{
+            expr::error_code::EVALUATOR_WRONG_ARGUMENT_COUNT,
+            location,
+            {"{0} argument(s) expected.", expected}
+        };
+    }
+
+    return std::nullopt;
+}
+
+std::optional<expr::error> expr::validate_argument(
+    const expr::function_definition_t& definition,
+    std::size_t position,
+    expr::measurement_unit unit,
+    const expr::location_t& location
+) {
+    if (!has_parameter_list(definition))
+        return std::nullopt;
+
+    const auto& parameter = definition.parameters[position];
+    if (parameter.accepts != nullptr && !(unit.*parameter.accepts)()) {
+        return expr::error{
+            expr::error_code::EVALUATOR_WRONG_ARGUMENT_TYPE,
+            location,
+            {
+                "Argument at position {0} is expected to be a {1}.",
+                position,
+                parameter.type
+            }
+        };
+    }
+
+    return std::nullopt;
+}
+
+template <typename T>
+std::optional<expr::error> expr::validate_arguments(
+    const expr::function_definition_t& definition,
+    std::span<const expr::basic_quantity<T>> arguments,
+    const expr::location_t& location
+) {
+    if (auto error = validate_argument_count(definition, arguments.size(), location))
+        return error;
+
+    for (std::size_t i = 0; i < arguments.size(); ++i) {
+        if (auto error = validate_argument(definition, i, arguments[i].unit, location))
+            return error;
+    }
+
+    return std::nullopt;
+}
+
+std::optional<expr::error> expr::validate_arguments(
+    const expr::function_definition_t& definition,
+    std::span<const expr::quantity> arguments,
+    const expr::location_t& location
+) {
+    return validate_arguments<double>(definition, arguments, location);
+}
+
+template <typename T>
+expr::basic_function_result<T> expr::invoke(
+    const expr::function_definition_t& definition,
+    std::span<const expr::basic_quantity<T>> arguments,
+    const expr::location_t& location
+) {
+    if (definition.user_function != nullptr) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_NOT_INLINED_FUNCTION,
+            .location = location,
+            .description = {
+                "Function '{0}()' is defined by an expression, and has to be "
+                "inlined first.",
+                definition.user_function->name
+            }
+        };
+    }
+
+    if constexpr (std::is_same_v<T, double>) {
+        if (auto error = validate_arguments(definition, arguments, location))
+            return std::move(*error);
+
+        if (definition.builtin != nullptr)
+            return definition.builtin(arguments, location);
+
+        if (definition.native_function != nullptr) {
+            std::array<double, expr::max_builtin_arity> values;
+            for (std::size_t i = 0; i < arguments.size(); ++i)
+                values[i] = arguments[i].value;
+            return expr::make_scalar(definition.native_function(values.data()));
+        }
+
+        // Adapter for function tables written against the legacy calling
+        // convention, which needs its arguments in a vector of its own.
+        return definition.implementation(
+            std::vector<expr::quantity>(arguments.begin(), arguments.end()),
+            location
+        );
+    } else {
+        if (const auto builtin = expr::builtin_for<T>(definition)) {
+            if (auto error = validate_arguments(definition, arguments, location))
+                return std::move(*error);
+            return builtin(arguments, location);
+        }
+
+        std::vector<expr::quantity> converted;
+        converted.reserve(arguments.size());
+        for (const auto& argument : arguments)
+            converted.push_back(expr::quantity{argument.unit, double(argument.value)});
+
+        auto result = expr::invoke(definition, std::span<const expr::quantity>(converted), location);
+        if (!result)
+            return std::move(result.error());
+        return expr::basic_quantity<T>{result->unit, T(result->value)};
+    }
+}
+
+expr::function_result expr::invoke(
+    const expr::function_definition_t& definition,
+    std::span<const expr::quantity> arguments,
+    const expr::location_t& location
+) {
+    return invoke<double>(definition, arguments, location);
+}
+
+#define EXPR_INSTANTIATE_FUNCTIONS(T)                                          \
+    template std::optional<expr::error> expr::validate_arguments(              \
+        const expr::function_definition_t&,                                    \
+        std::span<const expr::basic_quantity<T>>,                              \
+        const expr::location_t&                                                \
+    );                                                                         \
+    template expr::basic_function_result<T> expr::invoke(                      \
+        const expr::function_definition_t&,                                    \
+        std::span<const expr::basic_quantity<T>>,                              \
+        const expr::location_t&                                                \
+    )
+
+EXPR_INSTANTIATE_FUNCTIONS(float);
+EXPR_INSTANTIATE_FUNCTIONS(double);
+EXPR_INSTANTIATE_FUNCTIONS(long double);
+
 #undef EXPR_BUILTIN_FUNCTION
-#undef EXPR_CHECK_PARAMETER_COUNT
-#undef EXPR_CHECK_PARAMETER_TYPE
+#undef EXPR_BUILTIN
+#undef EXPR_LEGACY_IMPLEMENTATION
+#undef EXPR_PARAMETER
+#undef EXPR_ANY_PARAMETER
+#undef EXPR_INSTANTIATE_FUNCTIONS
@@ -0,0 +1,453 @@
+#include "interpreter.h"
+#include "utility.h"
+
+#include <array>            // std::array
+#include <cmath>            // std::fabs
+#include <cstdint>          // std::int64_t
+#include <optional>         // std::optional
+#include <span>             // std::span
+#include <string_view>      // std::string_view
+#include <vector>           // std::vector
+
+// Variables are either looked up by name in a symbol table, or read from the
+// slots of an evaluation context, which a resolver may fill on demand.
+
+class symbol_table_variables final {
+public:
+    symbol_table_variables(
+        const expr::compiled_expression& expression,
+        expr::symbol_table& symbols
+    ) :
+        _expression(expression),
+        _symbols(symbols)
+    {}
+
+    const expr::quantity * load(std::size_t slot) const {
+        auto where = _symbols.find(_expression.variables[slot]);
+        return (where == _symbols.end()) ? nullptr : &where->second;
+    }
+
+    void store(std::size_t slot, const expr::quantity& value) {
+        _symbols[_expression.variables[slot]] = value;
+    }
+
+private:
+    const expr::compiled_expression& _expression;
+    expr::symbol_table& _symbols;
+};
+
+class context_variables final {
+public:
+    context_variables(expr::evaluation_context& context) :
+        _context(context)
+    {}
+
+    const expr::quantity * load(std::size_t slot) const {
+        return _context.bound[slot] ? &_context.slots[slot] : nullptr;
+    }
+
+    void store(std::size_t slot, const expr::quantity& value) {
+        expr::bind(_context, slot, value);
+    }
+
+private:
+    expr::evaluation_context& _context;
+};
+
+class resolved_variables final {
+public:
+    resolved_variables(
+        const expr::compiled_expression& expression,
+        expr::evaluation_context& context,
+        const expr::variable_resolver& resolver
+    ) :
+        _expression(expression),
+        _context(context),
+        _resolver(resolver)
+    {}
+
+    const expr::quantity * load(std::size_t slot) {
+        if (!_context.bound[slot]) {
+            const auto value = _resolver(_expression.variables[slot]);
+            if (!value)
+                return nullptr;
+            expr::bind(_context, slot, *value);
+        }
+        return &_context.slots[slot];
+    }
+
+    void store(std::size_t slot, const expr::quantity& value) {
+        expr::bind(_context, slot, value);
+    }
+
+private:
+    const expr::compiled_expression& _expression;
+    expr::evaluation_context& _context;
+    const expr::variable_resolver& _resolver;
+};
+
+// Most expressions fit into this many stack slots, so evaluating them does not
+// allocate at all.
+static constexpr std::size_t inline_stack_size = 32;
+
+static expr::evaluator_result report(
+    const expr::compiled_expression& expression,
+    std::size_t instruction,
+    expr::error&& error
+) {
+    if (instruction >= expression.root || !expression.failure)
+        return std::move(error);
+    return *expression.failure;
+}
+
+// Integral doubles below 2^53 are exact, so arithmetic on them is exact as
+// long as its result stays in that range. A double of 2^53 may already be a
+// rounded 2^53 + 1, so integers from 2^53 up are kept next to the stack, in
+// 64 bits, and the double is rounded from them once. Large values that are no
+// longer known exactly are not_exact there. Entries of small values are never
+// read, nor written.
+static constexpr std::int64_t not_exact = INT64_MIN;
+
+static bool is_large(double value) {
+    return std::fabs(value) >= expr::max_exact_integer;
+}
+
+// Large values read from variables, constants and functions are taken as
+// they are.
+static std::int64_t exact_of_given(double value) {
+    if (std::fabs(value) < 0x1p63)
+        return std::int64_t(value);
+    return not_exact;
+}
+
+static std::optional<std::int64_t> exact_of_operand(double value, std::int64_t exact) {
+    if (is_large(value)) {
+        if (exact == not_exact)
+            return std::nullopt;
+        return exact;
+    }
+    return expr::exact_integer(value);
+}
+
+// Redoes an operation with a large operand or result on the integers. The
+// result is left as computed on doubles if the operands are not integers,
+// or the exact result does not fit into 64 bits.
+static void make_exact(
+    expr::instruction_t::opcode_t opcode,
+    const expr::quantity& lhs,
+    std::int64_t exact_lhs,
+    const expr::quantity& rhs,
+    std::int64_t exact_rhs,
+    expr::quantity& result,
+    std::int64_t& exact_result
+) {
+    exact_result = not_exact;
+    const auto integer_lhs = exact_of_operand(lhs.value, exact_lhs);
+    const auto integer_rhs = exact_of_operand(rhs.value, exact_rhs);
+    if (!integer_lhs || !integer_rhs)
+        return;
+
+    using opcode_t = expr::instruction_t::opcode_t;
+
+    // The arithmetic opcodes are in the order of their operators here.
+    static constexpr auto operations = std::string_view("+-*/%^");
+    const auto index = std::size_t(opcode) - std::size_t(opcode_t::ADD);
+    if (index >= operations.size())
+        return;
+
+    const auto exact = expr::exact_operation(
+        operations[index],
+        *integer_lhs,
+        *integer_rhs
+    );
+    if (!exact || *exact == not_exact)
+        return;
+    result.value = double(*exact);
+    exact_result = *exact;
+}
+
+template <expr::evaluation_policy Policy, typename Variables>
+static expr::evaluator_result run(
+    const expr::compiled_expression& expression,
+    Variables& variables,
+    expr::quantity *stack,
+    std::int64_t *exact
+) {
+    using opcode_t = expr::instruction_t::opcode_t;
+
+    std::size_t top = 0;
+    const auto& instructions = expression.instructions;
+    for (std::size_t i = 0; i < instructions.size(); ++i) {
+        const auto& instruction = instructions[i];
+        switch (instruction.opcode) {
+            case opcode_t::CONSTANT:
+                stack[top] = expression.constants[instruction.operand];
+                if (is_large(stack[top].value))
+                    exact[top] = exact_of_given(stack[top].value);
+                ++top;
+                break;
+
+            case opcode_t::LOAD: {
+                const auto *value = variables.load(instruction.operand);
+                if (value == nullptr) {
+                    const auto& name = expression.variables[instruction.operand];
+                    return report(expression, i, expr::error{
+                        .code = expr::error_code::EVALUATOR_UNDEFINED_VARIABLE,
+                        .location = instruction.location,
+                        .description = {"Undefined variable '{0}'.", name}
+                    });
+                }
+                stack[top] = *value;
+                if (is_large(value->value))
+                    exact[top] = exact_of_given(value->value);
+                ++top;
+                break;
+            }
+
+            case opcode_t::STORE:
+                variables.store(instruction.operand, stack[top - 1]);
+                break;
+
+            case opcode_t::NEGATE:
+                stack[top - 1].value = -stack[top - 1].value;
+                if (is_large(stack[top - 1].value) && exact[top - 1] != not_exact)
+                    exact[top - 1] = -exact[top - 1];
+                break;
+
+            case opcode_t::ADD:
+            case opcode_t::SUBTRACT:
+            case opcode_t::MULTIPLY:
+            case opcode_t::DIVIDE:
+            case opcode_t::MODULO:
+            case opcode_t::POWER:
+            case opcode_t::LESS:
+            case opcode_t::LESS_EQUAL:
+            case opcode_t::GREATER:
+            case opcode_t::GREATER_EQUAL:
+            case opcode_t::EQUAL:
+            case opcode_t::NOT_EQUAL: {
+                static constexpr expr::arithmetic_result (*binary[])(
+                    expr::quantity,
+                    expr::quantity
+                ) = {
+                    expr::add,
+                    expr::subtract,
+                    expr::multiply,
+                    Policy::is_checked ? expr::divide<double> : expr::ieee_divide<double>,
+                    expr::modulo,
+                    Policy::is_checked ? expr::power<double> : expr::ieee_power<double>,
+                    expr::less,
+                    expr::less_equal,
+                    expr::greater,
+                    expr::greater_equal,
+                    expr::equal,
+                    expr::not_equal,
+                };
+
+                const auto index = std::size_t(instruction.opcode)
+                                 - std::size_t(opcode_t::ADD);
+                auto result = binary[index](stack[top - 2], stack[top - 1]);
+                if (!result) {
+                    // HACK: The quantity class dictates the error, but the
+                    //       evaluator has source location.
+                    auto& error = result.error();
+                    error.code = expr::operator_error_code(error.code);
+                    error.location = instruction.location;
+                    return report(expression, i, std::move(error));
+                }
+                const auto& lhs = stack[top - 2];
+                const auto& rhs = stack[top - 1];
+                if (is_large(lhs.value) || is_large(rhs.value) || is_large(result->value)) {
+                    make_exact(
+                        instruction.opcode,
+                        lhs,
+                        exact[top - 2],
+                        rhs,
+                        exact[top - 1],
+                        *result,
+                        exact[top - 2]
+                    );
+                }
+                stack[--top - 1] = *result;
+                break;
+            }
+
+            case opcode_t::APPLY_UNIT: {
+                const auto& factor = expression.constants[instruction.operand];
+                auto applied = expr::multiply(stack[top - 1], factor);
+                if (!applied) {
+                    auto& error = applied.error();
+                    error.location = instruction.location;
+                    return report(expression, i, std::move(error));
+                }
+                auto result = *applied;
+                if (is_large(stack[top - 1].value) || is_large(result.value)) {
+                    make_exact(
+                        opcode_t::MULTIPLY,
+                        stack[top - 1],
+                        exact[top - 1],
+                        factor,
+                        not_exact,
+                        result,
+                        exact[top - 1]
+                    );
+                }
+                stack[top - 1] = result;
+                break;
+            }
+
+            case opcode_t::CALL: {
+                const auto& call = expression.calls[instruction.operand];
+                const auto& definition = *call.definition;
+                const auto arguments = std::span<const expr::quantity>(
+                    stack + top - call.arity,
+                    call.arity
+                );
+
+                auto result = [&]() -> expr::function_result {
+                    if (definition.builtin == nullptr)
+                        return expr::invoke(definition, arguments, instruction.location);
+
+                    if (!call.validated) {
+                        auto error = expr::validate_arguments(
+                            definition,
+                            arguments,
+                            instruction.location
+                        );
+                        if (error)
+                            return std::move(*error);
+                    }
+
+                    return definition.builtin(arguments, instruction.location);
+                }();
+
+                if (!result)
+                    return report(expression, i, std::move(result.error()));
+
+                top -= call.arity;
+                stack[top] = *result;
+                if (is_large(result->value))
+                    exact[top] = exact_of_given(result->value);
+                ++top;
+                break;
+            }
+
+            case opcode_t::JUMP:
+                i = instruction.operand - 1;
+                break;
+
+            case opcode_t::JUMP_IF_FALSE:
+                if (stack[--top].value == 0)
+                    i = instruction.operand - 1;
+                break;
+        }
+    }
+
+    return stack[top - 1];
+}
+
+template <expr::evaluation_policy Policy>
+expr::evaluator_result expr::evaluate(
+    const expr::compiled_expression& expression,
+    expr::symbol_table& symbols
+) {
+    std::array<expr::quantity, inline_stack_size> inline_stack;
+    std::array<std::int64_t, inline_stack_size> inline_exact;
+    std::vector<expr::quantity> heap_stack;
+    std::vector<std::int64_t> heap_exact;
+    auto *stack = inline_stack.data();
+    auto *exact = inline_exact.data();
+    if (expression.stack_size > inline_stack.size()) {
+        heap_stack.resize(expression.stack_size);
+        heap_exact.resize(expression.stack_size);
+        stack = heap_stack.data();
+        exact = heap_exact.data();
+    }
+
+    auto variables = symbol_table_variables(expression, symbols);
+    return run<Policy>(expression, variables, stack, exact);
+}
+
+template <expr::evaluation_policy Policy>
+expr::evaluator_result expr::evaluate(
+    const expr::compiled_expression& expression,
+    expr::evaluation_context& context
+) {
+    expr::prepare(context, expression);
+
+    auto variables = context_variables(context);
+    return run<Policy>(
+        expression,
+        variables,
+        context.stack.data(),
+        context.exact.data()
+    );
+}
+
+template <expr::evaluation_policy Policy>
+expr::evaluator_result expr::evaluate(
+    const expr::compiled_expression& expression,
+    expr::evaluation_context& context,
+    const expr::variable_resolver& resolver
+) {
+    expr::prepare(context, expression);
+
+    auto variables = resolved_variables(expression, context, resolver);
+    return run<Policy>(
+        expression,
+        variables,
+        context.stack.data(),
+        context.exact.data()
+    );
+}
+
+template <expr::evaluation_policy Policy>
+expr::evaluator_result expr::evaluate(
+    const expr::compiled_expression& expression,
+    const expr::variable_resolver& resolver
+) {
+    auto context = expr::make_context(expression);
+    return expr::evaluate<Policy>(expression, context, resolver);
+}
+
+template expr::evaluator_result expr::evaluate<expr::checked_policy>(
+    const expr::compiled_expression&,
+    expr::symbol_table&
+);
+
+template expr::evaluator_result expr::evaluate<expr::ieee_policy>(
+    const expr::compiled_expression&,
+    expr::symbol_table&
+);
+
+template expr::evaluator_result expr::evaluate<expr::checked_policy>(
+    const expr::compiled_expression&,
+    expr::evaluation_context&
+);
+
+template expr::evaluator_result expr::evaluate<expr::ieee_policy>(
+    const expr::compiled_expression&,
+    expr::evaluation_context&
+);
+
+template expr::evaluator_result expr::evaluate<expr::checked_policy>(
+    const expr::compiled_expression&,
+    expr::evaluation_context&,
+    const expr::variable_resolver&
+);
+
+template expr::evaluator_result expr::evaluate<expr::ieee_policy>(
+    const expr::compiled_expression&,
+    expr::evaluation_context&,
+    const expr::variable_resolver&
+);
+
+template expr::evaluator_result expr::evaluate<expr::checked_policy>(
+    const expr::compiled_expression&,
+    const expr::variable_resolver&
+);
+
+template expr::evaluator_result expr::evaluate<expr::ieee_policy>(
+    const expr::compiled_expression&,
+    const expr::variable_resolver&
+);
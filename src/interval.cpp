@@ -0,0 +1,538 @@
+#include "interval.h"
+
+#include <algorithm>        // std::min, std::max, std::clamp
+#include <cfloat>           // DBL_EPSILON
+#include <cmath>            // all math functions
+#include <iostream>         // std::ostream
+#include <limits>           // std::numeric_limits
+
+// Results of the basic operations are rounded to nearest, so moving each bound
+// by one ulp outwards encloses the exact result. The C library functions are
+// allowed an error of two ulps.
+
+static constexpr double infinity = std::numeric_limits<double>::infinity();
+static constexpr double not_a_number = std::numeric_limits<double>::quiet_NaN();
+static constexpr expr::interval_t empty = {not_a_number, not_a_number};
+static constexpr double two_pi = 6.283185307179586477;
+
+static double round_down(double value, int ulps = 1) {
+    for (int i = 0; i < ulps && std::isfinite(value); ++i)
+        value = std::nextafter(value, -infinity);
+    return value;
+}
+
+static double round_up(double value, int ulps = 1) {
+    for (int i = 0; i < ulps && std::isfinite(value); ++i)
+        value = std::nextafter(value, infinity);
+    return value;
+}
+
+static expr::interval_t outwards(double lower, double upper, int ulps = 1) {
+    if (std::isnan(lower) || std::isnan(upper))
+        return empty;
+    return expr::interval_t{round_down(lower, ulps), round_up(upper, ulps)};
+}
+
+// The bounds of a function over an interval in which it is non-decreasing.
+static expr::interval_t increasing(
+    expr::interval_t operand,
+    double (*function)(double),
+    int ulps
+) {
+    if (operand.is_empty())
+        return empty;
+    return outwards(function(operand.lower), function(operand.upper), ulps);
+}
+
+// Products of a zero and an infinity are zero, as zero is a bound reached by
+// actual values, and the infinity only bounds values growing without limit.
+static double product(double lhs, double rhs) {
+    if (lhs == 0 || rhs == 0)
+        return 0;
+    return lhs * rhs;
+}
+
+static expr::interval_t multiply_values(expr::interval_t lhs, expr::interval_t rhs) {
+    if (lhs.is_empty() || rhs.is_empty())
+        return empty;
+
+    const double products[] = {
+        product(lhs.lower, rhs.lower),
+        product(lhs.lower, rhs.upper),
+        product(lhs.upper, rhs.lower),
+        product(lhs.upper, rhs.upper),
+    };
+    return outwards(
+        *std::min_element(std::begin(products), std::end(products)),
+        *std::max_element(std::begin(products), std::end(products))
+    );
+}
+
+// The reciprocals of the values of an interval, not counting the ones the
+// point division rejects as zero. Returns an empty interval if there are none.
+static expr::interval_t reciprocal_of_divisors(expr::interval_t divisor) {
+    auto reciprocal = empty;
+    auto include = [&](double lower, double upper) {
+        const auto part = outwards(1 / upper, 1 / lower);
+        if (reciprocal.is_empty()) {
+            reciprocal = part;
+        } else {
+            reciprocal.lower = std::min(reciprocal.lower, part.lower);
+            reciprocal.upper = std::max(reciprocal.upper, part.upper);
+        }
+    };
+
+    if (divisor.lower < -DBL_EPSILON)
+        include(divisor.lower, std::min(divisor.upper, -DBL_EPSILON));
+    if (divisor.upper > DBL_EPSILON)
+        include(std::max(divisor.lower, DBL_EPSILON), divisor.upper);
+    return reciprocal;
+}
+
+// The reciprocals of all values of an interval, with IEEE semantics at zero,
+// for the operations which do not reject zero divisors.
+static expr::interval_t reciprocal_of_values(expr::interval_t divisor) {
+    if (divisor.is_empty())
+        return empty;
+    if (divisor.lower > 0 || divisor.upper < 0)
+        return outwards(1 / divisor.upper, 1 / divisor.lower);
+    if (divisor.lower == 0 && divisor.upper == 0)
+        return expr::interval_t{infinity, infinity};
+    if (divisor.lower == 0)
+        return expr::interval_t{round_down(1 / divisor.upper), infinity};
+    if (divisor.upper == 0)
+        return expr::interval_t{-infinity, round_up(1 / divisor.lower)};
+    return expr::interval_t{-infinity, infinity};
+}
+
+// The point operators decide units and unit errors. Values standing in for the
+// operands are chosen so only the units can make them fail.
+static expr::result<expr::measurement_unit, expr::error> unit_of(
+    expr::arithmetic_result (*operation)(expr::quantity, expr::quantity),
+    expr::measurement_unit lhs,
+    expr::quantity rhs
+) {
+    auto result = operation(expr::quantity{.unit = lhs, .value = 1}, rhs);
+    if (!result)
+        return std::move(result.error());
+    return result->unit;
+}
+
+static expr::quantity probe(expr::measurement_unit unit) {
+    return expr::quantity{.unit = unit, .value = 1};
+}
+
+static bool is_point(expr::interval_t interval) {
+    return interval.lower == interval.upper;
+}
+
+// Whether the interval contains phase + 2 * k * pi for some integer k. Close
+// calls count as contained, which only widens the bounds.
+static bool contains_phase(expr::interval_t interval, double phase) {
+    static constexpr double slack = 1e-9;
+    const auto first = std::ceil((interval.lower - phase) / two_pi - slack);
+    const auto last = std::floor((interval.upper - phase) / two_pi + slack);
+    return first <= last;
+}
+
+static expr::interval_t periodic(
+    expr::interval_t operand,
+    double (*function)(double),
+    double maximum_phase,
+    double minimum_phase
+) {
+    static constexpr double largest_reduced = 1e9;
+
+    if (operand.is_empty())
+        return empty;
+
+    const bool is_full_period = !(operand.upper - operand.lower < two_pi) ||
+                                std::fabs(operand.lower) > largest_reduced ||
+                                std::fabs(operand.upper) > largest_reduced;
+    if (is_full_period)
+        return expr::interval_t{-1, 1};
+
+    const auto at_lower = function(operand.lower);
+    const auto at_upper = function(operand.upper);
+    auto result = outwards(
+        std::min(at_lower, at_upper),
+        std::max(at_lower, at_upper),
+        2
+    );
+
+    if (contains_phase(operand, maximum_phase))
+        result.upper = 1;
+    if (contains_phase(operand, minimum_phase))
+        result.lower = -1;
+
+    result.lower = std::clamp(result.lower, -1.0, 1.0);
+    result.upper = std::clamp(result.upper, -1.0, 1.0);
+    return result;
+}
+
+// The logarithms are defined for positive values, they give NaNs for negative
+// ones, which are left out, and an infinity for zero.
+static expr::interval_t logarithm(expr::interval_t operand, double (*function)(double)) {
+    if (operand.is_empty() || operand.upper < 0)
+        return empty;
+
+    return expr::interval_t{
+        operand.lower > 0 ? round_down(function(operand.lower), 2) : -infinity,
+        round_up(function(operand.upper), 2)
+    };
+}
+
+static double sign(double value) {
+    if (std::fabs(value) < DBL_EPSILON)
+        return 0;
+    return value < 0 ? -1 : 1;
+}
+
+bool expr::interval_t::is_empty() const {
+    return std::isnan(lower) || std::isnan(upper);
+}
+
+bool expr::interval_t::contains(double value) const {
+    return lower <= value && value <= upper;
+}
+
+expr::interval_result expr::intervals::identity(expr::interval_quantity operand) {
+    return operand;
+}
+
+expr::interval_result expr::intervals::negate(expr::interval_quantity operand) {
+    operand.value = expr::interval_t{-operand.value.upper, -operand.value.lower};
+    return operand;
+}
+
+expr::interval_result expr::intervals::add(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    auto unit = unit_of(expr::add, lhs.unit, probe(rhs.unit));
+    if (!unit)
+        return std::move(unit.error());
+
+    if (lhs.value.is_empty() || rhs.value.is_empty())
+        return expr::interval_quantity{*unit, empty};
+
+    return expr::interval_quantity{*unit, outwards(
+        lhs.value.lower + rhs.value.lower,
+        lhs.value.upper + rhs.value.upper
+    )};
+}
+
+expr::interval_result expr::intervals::subtract(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    auto unit = unit_of(expr::subtract, lhs.unit, probe(rhs.unit));
+    if (!unit)
+        return std::move(unit.error());
+
+    if (lhs.value.is_empty() || rhs.value.is_empty())
+        return expr::interval_quantity{*unit, empty};
+
+    return expr::interval_quantity{*unit, outwards(
+        lhs.value.lower - rhs.value.upper,
+        lhs.value.upper - rhs.value.lower
+    )};
+}
+
+expr::interval_result expr::intervals::multiply(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    auto unit = unit_of(expr::multiply, lhs.unit, probe(rhs.unit));
+    if (!unit)
+        return std::move(unit.error());
+    return expr::interval_quantity{*unit, multiply_values(lhs.value, rhs.value)};
+}
+
+expr::interval_result expr::intervals::divide(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    auto unit = unit_of(expr::divide, lhs.unit, probe(rhs.unit));
+    if (!unit)
+        return std::move(unit.error());
+
+    if (rhs.value.is_empty())
+        return expr::interval_quantity{*unit, empty};
+
+    const auto reciprocal = reciprocal_of_divisors(rhs.value);
+    if (reciprocal.is_empty()) {
+        return expr::error{
+            .code = expr::error_code::QUANTITY_DIVISION_BY_ZERO,
+            .location = {},
+            .description = "Division by zero."
+        };
+    }
+
+    return expr::interval_quantity{*unit, multiply_values(lhs.value, reciprocal)};
+}
+
+expr::interval_result expr::intervals::modulo(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    auto unit = unit_of(expr::modulo, lhs.unit, probe(rhs.unit));
+    if (!unit)
+        return std::move(unit.error());
+
+    const auto& dividend = lhs.value;
+    const auto& divisor = rhs.value;
+    if (dividend.is_empty() || divisor.is_empty())
+        return expr::interval_quantity{*unit, empty};
+    if (divisor.lower == 0 && divisor.upper == 0)
+        return expr::interval_quantity{*unit, empty};
+
+    // Within a single period of a fixed divisor the remainder grows with the
+    // dividend, and the remainder is exact.
+    if (is_point(divisor) && std::isfinite(dividend.lower) && std::isfinite(dividend.upper)) {
+        const auto first = std::trunc(dividend.lower / divisor.lower);
+        const auto last = std::trunc(dividend.upper / divisor.lower);
+        const bool is_same_sign = dividend.lower >= 0 || dividend.upper <= 0;
+        if (first == last && is_same_sign) {
+            const auto lower = std::fmod(dividend.lower, divisor.lower);
+            const auto upper = std::fmod(dividend.upper, divisor.lower);
+            if (lower <= upper)
+                return expr::interval_quantity{*unit, {lower, upper}};
+        }
+    }
+
+    // Otherwise the remainder has the sign of the dividend, and is smaller in
+    // magnitude than both the dividend and the divisor.
+    const auto largest = std::max(std::fabs(divisor.lower), std::fabs(divisor.upper));
+    return expr::interval_quantity{*unit, expr::interval_t{
+        dividend.lower >= 0 ? 0 : std::max(dividend.lower, -largest),
+        dividend.upper <= 0 ? 0 : std::min(dividend.upper, largest)
+    }};
+}
+
+expr::interval_result expr::intervals::power(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    // The point operator only accepts integer exponents, so the exponent has
+    // to be a single value.
+    if (!is_point(rhs.value)) {
+        return expr::error{
+            .code = expr::error_code::QUANTITY_SCALAR_INTEGER_EXPECTED_AS_POWER,
+            .location = {},
+            .description = "Scalar integer expected as power."
+        };
+    }
+
+    const auto exponent = rhs.value.lower;
+    auto unit = unit_of(expr::power, lhs.unit, {rhs.unit, exponent});
+    if (!unit)
+        return std::move(unit.error());
+
+    const auto& base = lhs.value;
+    if (base.is_empty())
+        return expr::interval_quantity{*unit, empty};
+
+    const auto magnitude = std::fabs(exponent);
+    auto raise = [&](double value) { return std::pow(value, magnitude); };
+
+    auto raised = expr::interval_t{1, 1};
+    if (magnitude != 0) {
+        const bool is_even = std::fmod(magnitude, 2) == 0;
+        if (!is_even || base.lower >= 0) {
+            raised = outwards(raise(base.lower), raise(base.upper), 2);
+        } else if (base.upper <= 0) {
+            raised = outwards(raise(base.upper), raise(base.lower), 2);
+        } else {
+            raised = outwards(0, std::max(raise(base.lower), raise(base.upper)), 2);
+            raised.lower = 0;
+        }
+    }
+
+    if (exponent < 0)
+        raised = reciprocal_of_values(raised);
+    return expr::interval_quantity{*unit, raised};
+}
+
+expr::interval_quantity expr::intervals::sin(
+    std::span<const expr::interval_quantity> arguments
+) {
+    return expr::interval_quantity{
+        {0, 0},
+        periodic(arguments[0].value, std::sin, M_PI / 2, -M_PI / 2)
+    };
+}
+
+expr::interval_quantity expr::intervals::cos(
+    std::span<const expr::interval_quantity> arguments
+) {
+    return expr::interval_quantity{
+        {0, 0},
+        periodic(arguments[0].value, std::cos, 0, M_PI)
+    };
+}
+
+expr::interval_quantity expr::intervals::round(
+    std::span<const expr::interval_quantity> arguments
+) {
+    return expr::interval_quantity{
+        {0, 0},
+        increasing(arguments[0].value, std::round, 0)
+    };
+}
+
+expr::interval_quantity expr::intervals::floor(
+    std::span<const expr::interval_quantity> arguments
+) {
+    return expr::interval_quantity{
+        {0, 0},
+        increasing(arguments[0].value, std::floor, 0)
+    };
+}
+
+expr::interval_quantity expr::intervals::ceil(
+    std::span<const expr::interval_quantity> arguments
+) {
+    return expr::interval_quantity{
+        {0, 0},
+        increasing(arguments[0].value, std::ceil, 0)
+    };
+}
+
+expr::interval_quantity expr::intervals::abs(
+    std::span<const expr::interval_quantity> arguments
+) {
+    const auto& operand = arguments[0].value;
+    auto result = operand;
+    if (operand.upper <= 0)
+        result = expr::interval_t{-operand.upper, -operand.lower};
+    else if (operand.lower < 0)
+        result = expr::interval_t{0, std::max(-operand.lower, operand.upper)};
+    return expr::interval_quantity{arguments[0].unit, result};
+}
+
+expr::interval_quantity expr::intervals::ln(
+    std::span<const expr::interval_quantity> arguments
+) {
+    return expr::interval_quantity{{0, 0}, logarithm(arguments[0].value, std::log)};
+}
+
+expr::interval_quantity expr::intervals::log2(
+    std::span<const expr::interval_quantity> arguments
+) {
+    return expr::interval_quantity{{0, 0}, logarithm(arguments[0].value, std::log2)};
+}
+
+expr::interval_quantity expr::intervals::log10(
+    std::span<const expr::interval_quantity> arguments
+) {
+    return expr::interval_quantity{{0, 0}, logarithm(arguments[0].value, std::log10)};
+}
+
+expr::interval_quantity expr::intervals::log(
+    std::span<const expr::interval_quantity> arguments
+) {
+    // The builtin divides the logarithms without rejecting a zero divisor.
+    const auto value = logarithm(arguments[0].value, std::log10);
+    const auto base = logarithm(arguments[1].value, std::log10);
+    return expr::interval_quantity{
+        {0, 0},
+        multiply_values(value, reciprocal_of_values(base))
+    };
+}
+
+expr::interval_quantity expr::intervals::sgn(
+    std::span<const expr::interval_quantity> arguments
+) {
+    return expr::interval_quantity{
+        {0, 0},
+        increasing(arguments[0].value, sign, 0)
+    };
+}
+
+// The truth of a comparison, which holds for every pair of values, for none,
+// or for some of them.
+static expr::interval_result truth_of(
+    expr::arithmetic_result (*comparison)(expr::quantity, expr::quantity),
+    const expr::interval_quantity& lhs,
+    const expr::interval_quantity& rhs,
+    bool always,
+    bool never
+) {
+    auto unit = unit_of(comparison, lhs.unit, probe(rhs.unit));
+    if (!unit)
+        return std::move(unit.error());
+
+    if (lhs.value.is_empty() || rhs.value.is_empty())
+        return expr::interval_quantity{*unit, empty};
+    if (always)
+        return expr::make_interval(1, 1);
+    if (never)
+        return expr::make_interval(0, 0);
+    return expr::make_interval(0, 1);
+}
+
+expr::interval_result expr::intervals::less(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    const bool always = lhs.value.upper < rhs.value.lower;
+    const bool never = lhs.value.lower >= rhs.value.upper;
+    return truth_of(expr::less, lhs, rhs, always, never);
+}
+
+expr::interval_result expr::intervals::less_equal(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    const bool always = lhs.value.upper <= rhs.value.lower;
+    const bool never = lhs.value.lower > rhs.value.upper;
+    return truth_of(expr::less_equal, lhs, rhs, always, never);
+}
+
+expr::interval_result expr::intervals::greater(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    return expr::intervals::less(rhs, lhs);
+}
+
+expr::interval_result expr::intervals::greater_equal(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    return expr::intervals::less_equal(rhs, lhs);
+}
+
+expr::interval_result expr::intervals::equal(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    const bool always = is_point(lhs.value) && is_point(rhs.value)
+                     && lhs.value.lower == rhs.value.lower;
+    const bool never = lhs.value.upper < rhs.value.lower
+                    || rhs.value.upper < lhs.value.lower;
+    return truth_of(expr::equal, lhs, rhs, always, never);
+}
+
+expr::interval_result expr::intervals::not_equal(
+    expr::interval_quantity lhs,
+    expr::interval_quantity rhs
+) {
+    const bool always = lhs.value.upper < rhs.value.lower
+                     || rhs.value.upper < lhs.value.lower;
+    const bool never = is_point(lhs.value) && is_point(rhs.value)
+                    && lhs.value.lower == rhs.value.lower;
+    return truth_of(expr::not_equal, lhs, rhs, always, never);
+}
+
+std::ostream& operator<<(
+    std::ostream& stream,
+    const expr::interval_quantity& interval
+) {
+    return stream << '['
+                  << expr::quantity{interval.unit, interval.value.lower}
+                  << ", "
+                  << expr::quantity{interval.unit, interval.value.upper}
+                  << ']';
+}
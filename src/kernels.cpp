@@ -0,0 +1,701 @@
+#include "kernels.h"
+
+#include <bit>              // std::bit_cast
+#include <cfloat>           // DBL_EPSILON, DBL_MIN, DBL_MAX
+#include <cmath>            // all math functions
+#include <cstdint>          // std::uint64_t
+
+#if defined(__SSE2__)
+#include <immintrin.h>      // SSE2, SSE4.1, AVX2 and FMA intrinsics
+#endif
+
+// Every kernel is written once against a small set of vector operations, and
+// is instantiated for the widest instruction set the translation unit is
+// compiled for. The remainder of each block, which does not fill a whole
+// vector register, is processed by the scalar instantiation of the same
+// algorithm, so every element gets bitwise identical results regardless of its
+// position in the block.
+
+namespace {
+    constexpr std::uint64_t sign_bit = 0x8000000000000000ULL;
+    constexpr std::uint64_t mantissa_bits = 0x000FFFFFFFFFFFFFULL;
+    constexpr std::uint64_t exponent_one = 0x3FF0000000000000ULL;
+    constexpr std::uint64_t magic_bits = 0x4330000000000000ULL;
+    constexpr double magic = 4503599627370496.0;    // 2^52
+
+    struct scalar_ops {
+        using vector = double;
+        using mask = bool;
+        static constexpr std::size_t width = 1;
+
+        static vector load(const double *source) { return *source; }
+        static void store(double *target, vector v) { *target = v; }
+        static vector set(double v) { return v; }
+        static mask none() { return false; }
+
+        static vector add(vector a, vector b) { return a + b; }
+        static vector sub(vector a, vector b) { return a - b; }
+        static vector mul(vector a, vector b) { return a * b; }
+        static vector div(vector a, vector b) { return a / b; }
+
+        static vector mul_add(vector a, vector b, vector c) {
+#if defined(__FMA__)
+            return std::fma(a, b, c);
+#else
+            return a * b + c;
+#endif
+        }
+
+        static vector abs(vector a) { return std::fabs(a); }
+        static vector floor(vector a) { return std::floor(a); }
+        static vector ceil(vector a) { return std::ceil(a); }
+        static vector trunc(vector a) { return std::trunc(a); }
+        static vector nearest(vector a) { return std::nearbyint(a); }
+
+        static vector copy_sign(vector magnitude, vector sign) {
+            return std::copysign(magnitude, sign);
+        }
+
+        static mask less(vector a, vector b) { return a < b; }
+        static mask less_equal(vector a, vector b) { return a <= b; }
+        static mask equal(vector a, vector b) { return a == b; }
+        static mask both(mask a, mask b) { return a && b; }
+        static mask either(mask a, mask b) { return a || b; }
+        static mask negation(mask a) { return !a; }
+        static vector select(mask m, vector a, vector b) { return m ? a : b; }
+        static unsigned lanes(mask m) { return m ? 1 : 0; }
+
+        static vector split_exponent(vector x, vector& mantissa) {
+            const auto bits = std::bit_cast<std::uint64_t>(x);
+            mantissa = std::bit_cast<double>((bits & mantissa_bits) | exponent_one);
+            return double(bits >> 52);
+        }
+    };
+
+#if defined(__AVX2__)
+    struct avx2_ops {
+        using vector = __m256d;
+        using mask = __m256d;
+        static constexpr std::size_t width = 4;
+
+        static vector load(const double *source) { return _mm256_loadu_pd(source); }
+        static void store(double *target, vector v) { _mm256_storeu_pd(target, v); }
+        static vector set(double v) { return _mm256_set1_pd(v); }
+        static mask none() { return _mm256_setzero_pd(); }
+
+        static vector add(vector a, vector b) { return _mm256_add_pd(a, b); }
+        static vector sub(vector a, vector b) { return _mm256_sub_pd(a, b); }
+        static vector mul(vector a, vector b) { return _mm256_mul_pd(a, b); }
+        static vector div(vector a, vector b) { return _mm256_div_pd(a, b); }
+
+        static vector mul_add(vector a, vector b, vector c) {
+#if defined(__FMA__)
+            return _mm256_fmadd_pd(a, b, c);
+#else
+            return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+#endif
+        }
+
+        static vector abs(vector a) {
+            return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a);
+        }
+
+        static vector floor(vector a) { return _mm256_floor_pd(a); }
+        static vector ceil(vector a) { return _mm256_ceil_pd(a); }
+
+        static vector trunc(vector a) {
+            return _mm256_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        }
+
+        static vector nearest(vector a) {
+            return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        }
+
+        static vector copy_sign(vector magnitude, vector sign) {
+            const auto sign_mask = _mm256_set1_pd(-0.0);
+            return _mm256_or_pd(
+                _mm256_andnot_pd(sign_mask, magnitude),
+                _mm256_and_pd(sign_mask, sign)
+            );
+        }
+
+        static mask less(vector a, vector b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        static mask less_equal(vector a, vector b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        static mask equal(vector a, vector b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+        static mask both(mask a, mask b) { return _mm256_and_pd(a, b); }
+        static mask either(mask a, mask b) { return _mm256_or_pd(a, b); }
+
+        static mask negation(mask a) {
+            return _mm256_xor_pd(a, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)));
+        }
+
+        static vector select(mask m, vector a, vector b) { return _mm256_blendv_pd(b, a, m); }
+        static unsigned lanes(mask m) { return unsigned(_mm256_movemask_pd(m)); }
+
+        static vector split_exponent(vector x, vector& mantissa) {
+            const auto bits = _mm256_castpd_si256(x);
+            mantissa = _mm256_castsi256_pd(
+                _mm256_or_si256(
+                    _mm256_and_si256(bits, _mm256_set1_epi64x(mantissa_bits)),
+                    _mm256_set1_epi64x(exponent_one)
+                )
+            );
+            const auto exponent = _mm256_or_si256(
+                _mm256_srli_epi64(bits, 52),
+                _mm256_set1_epi64x(magic_bits)
+            );
+            return _mm256_sub_pd(_mm256_castsi256_pd(exponent), set(magic));
+        }
+    };
+#endif
+
+#if defined(__SSE2__)
+    struct sse2_ops {
+        using vector = __m128d;
+        using mask = __m128d;
+        static constexpr std::size_t width = 2;
+
+        static vector load(const double *source) { return _mm_loadu_pd(source); }
+        static void store(double *target, vector v) { _mm_storeu_pd(target, v); }
+        static vector set(double v) { return _mm_set1_pd(v); }
+        static mask none() { return _mm_setzero_pd(); }
+
+        static vector add(vector a, vector b) { return _mm_add_pd(a, b); }
+        static vector sub(vector a, vector b) { return _mm_sub_pd(a, b); }
+        static vector mul(vector a, vector b) { return _mm_mul_pd(a, b); }
+        static vector div(vector a, vector b) { return _mm_div_pd(a, b); }
+
+        static vector mul_add(vector a, vector b, vector c) {
+#if defined(__FMA__)
+            return _mm_fmadd_pd(a, b, c);
+#else
+            return _mm_add_pd(_mm_mul_pd(a, b), c);
+#endif
+        }
+
+        static vector abs(vector a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+
+        static vector copy_sign(vector magnitude, vector sign) {
+            const auto sign_mask = _mm_set1_pd(-0.0);
+            return _mm_or_pd(
+                _mm_andnot_pd(sign_mask, magnitude),
+                _mm_and_pd(sign_mask, sign)
+            );
+        }
+
+        static mask less(vector a, vector b) { return _mm_cmplt_pd(a, b); }
+        static mask less_equal(vector a, vector b) { return _mm_cmple_pd(a, b); }
+        static mask equal(vector a, vector b) { return _mm_cmpeq_pd(a, b); }
+        static mask both(mask a, mask b) { return _mm_and_pd(a, b); }
+        static mask either(mask a, mask b) { return _mm_or_pd(a, b); }
+
+        static mask negation(mask a) {
+            return _mm_xor_pd(a, _mm_castsi128_pd(_mm_set1_epi64x(-1)));
+        }
+
+        static vector select(mask m, vector a, vector b) {
+#if defined(__SSE4_1__)
+            return _mm_blendv_pd(b, a, m);
+#else
+            return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b));
+#endif
+        }
+
+        static unsigned lanes(mask m) { return unsigned(_mm_movemask_pd(m)); }
+
+#if defined(__SSE4_1__)
+        static vector floor(vector a) { return _mm_floor_pd(a); }
+        static vector ceil(vector a) { return _mm_ceil_pd(a); }
+
+        static vector trunc(vector a) {
+            return _mm_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        }
+
+        static vector nearest(vector a) {
+            return _mm_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        }
+#else
+        // Without SSE4.1, rounding is done by adding and subtracting 2^52,
+        // which pushes the fractional bits out of the mantissa. Every rounding
+        // function preserves the sign of its input, including negative zero.
+        static vector nearest(vector a) {
+            const auto shift = copy_sign(set(magic), a);
+            const auto rounded = _mm_sub_pd(_mm_add_pd(a, shift), shift);
+            return copy_sign(select(less(abs(a), set(magic)), rounded, a), a);
+        }
+
+        static vector floor(vector a) {
+            const auto rounded = nearest(a);
+            const auto step = _mm_and_pd(less(a, rounded), set(1.0));
+            return copy_sign(_mm_sub_pd(rounded, step), a);
+        }
+
+        static vector ceil(vector a) {
+            const auto rounded = nearest(a);
+            const auto step = _mm_and_pd(less(rounded, a), set(1.0));
+            return copy_sign(_mm_add_pd(rounded, step), a);
+        }
+
+        static vector trunc(vector a) {
+            return copy_sign(floor(abs(a)), a);
+        }
+#endif
+
+        static vector split_exponent(vector x, vector& mantissa) {
+            const auto bits = _mm_castpd_si128(x);
+            mantissa = _mm_castsi128_pd(
+                _mm_or_si128(
+                    _mm_and_si128(bits, _mm_set1_epi64x(mantissa_bits)),
+                    _mm_set1_epi64x(exponent_one)
+                )
+            );
+            const auto exponent = _mm_or_si128(
+                _mm_srli_epi64(bits, 52),
+                _mm_set1_epi64x(magic_bits)
+            );
+            return _mm_sub_pd(_mm_castsi128_pd(exponent), set(magic));
+        }
+    };
+#endif
+
+#if defined(__AVX2__)
+    using vector_ops = avx2_ops;
+#elif defined(__SSE2__)
+    using vector_ops = sse2_ops;
+#else
+    using vector_ops = scalar_ops;
+#endif
+
+    // Cody-Waite reduction by pi/2 in three parts, followed by the minimax
+    // polynomials of fdlibm's __kernel_sin and __kernel_cos on [-pi/4, pi/4].
+    // The first two parts of pi/2 have 33 significant bits, so their products
+    // with the quadrant number are exact as long as it fits into 20 bits.
+    template <int QuadrantOffset>
+    struct sine_kernel {
+        static constexpr double two_over_pi = 6.36619772367581382433e-01;
+        static constexpr double pi_over_2_1 = 1.57079632673412561417e+00;
+        static constexpr double pi_over_2_2 = 6.07710050630396597660e-11;
+        static constexpr double pi_over_2_3 = 2.02226624871116645580e-21;
+        static constexpr double limit = 1647099.3291652855;  // 2^20 * pi/2
+
+        static double fallback(double x) {
+            return QuadrantOffset == 0 ? std::sin(x) : std::cos(x);
+        }
+
+        template <typename Ops>
+        static typename Ops::vector evaluate(
+            typename Ops::vector x,
+            typename Ops::mask& special
+        ) {
+            using O = Ops;
+            special = O::negation(O::less_equal(O::abs(x), O::set(limit)));
+
+            const auto n = O::nearest(O::mul(x, O::set(two_over_pi)));
+            auto r = O::mul_add(n, O::set(-pi_over_2_1), x);
+            r = O::mul_add(n, O::set(-pi_over_2_2), r);
+            r = O::mul_add(n, O::set(-pi_over_2_3), r);
+            const auto z = O::mul(r, r);
+
+            auto sine = O::mul_add(z, O::set(1.58969099521155010221e-10), O::set(-2.50507602534068634195e-08));
+            sine = O::mul_add(z, sine, O::set(2.75573137070700676789e-06));
+            sine = O::mul_add(z, sine, O::set(-1.98412698298579493134e-04));
+            sine = O::mul_add(z, sine, O::set(8.33333333332248946124e-03));
+            sine = O::mul_add(z, sine, O::set(-1.66666666666666324348e-01));
+            sine = O::mul_add(O::mul(z, r), sine, r);
+
+            auto cosine = O::mul_add(z, O::set(-1.13596475577881948265e-11), O::set(2.08757232129817482790e-09));
+            cosine = O::mul_add(z, cosine, O::set(-2.75573143513906633035e-07));
+            cosine = O::mul_add(z, cosine, O::set(2.48015872894767294178e-05));
+            cosine = O::mul_add(z, cosine, O::set(-1.38888888888741095749e-03));
+            cosine = O::mul_add(z, cosine, O::set(4.16666666666666019037e-02));
+            const auto half_z = O::mul(z, O::set(0.5));
+            const auto w = O::sub(O::set(1.0), half_z);
+            const auto correction = O::sub(O::sub(O::set(1.0), w), half_z);
+            cosine = O::add(w, O::mul_add(O::mul(z, z), cosine, correction));
+
+            // The quadrant decides whether the sine or the cosine polynomial
+            // is used, and whether the result is negated.
+            const auto shifted = O::add(n, O::set(double(QuadrantOffset)));
+            const auto quadrant = O::sub(
+                shifted,
+                O::mul(O::set(4.0), O::floor(O::mul(shifted, O::set(0.25))))
+            );
+            const auto half = O::floor(O::mul(quadrant, O::set(0.5)));
+            const auto odd = O::equal(
+                O::sub(quadrant, O::mul(half, O::set(2.0))),
+                O::set(1.0)
+            );
+            const auto negative = O::less_equal(O::set(2.0), quadrant);
+            const auto result = O::select(odd, cosine, sine);
+            return O::select(negative, O::sub(O::set(0.0), result), result);
+        }
+    };
+
+    // Logarithms are computed from the decomposition x = 2^k * (1 + f), where
+    // 1 + f is in [sqrt(2)/2, sqrt(2)), using the minimax polynomial of
+    // fdlibm's __ieee754_log for ln(1 + f).
+    struct logarithm_parts {
+        static constexpr double sqrt_2 = 1.41421356237309514547e+00;
+
+        template <typename Ops>
+        static typename Ops::vector evaluate(
+            typename Ops::vector x,
+            typename Ops::mask& special,
+            typename Ops::vector& k,
+            typename Ops::vector& f,
+            typename Ops::vector& half_f_squared,
+            typename Ops::vector& tail
+        ) {
+            using O = Ops;
+            special = O::negation(
+                O::both(
+                    O::less_equal(O::set(DBL_MIN), x),
+                    O::less_equal(x, O::set(DBL_MAX))
+                )
+            );
+
+            typename O::vector mantissa;
+            k = O::sub(O::split_exponent(x, mantissa), O::set(1023.0));
+            const auto large = O::less(O::set(sqrt_2), mantissa);
+            mantissa = O::select(large, O::mul(mantissa, O::set(0.5)), mantissa);
+            k = O::select(large, O::add(k, O::set(1.0)), k);
+
+            f = O::sub(mantissa, O::set(1.0));
+            const auto s = O::div(f, O::add(O::set(2.0), f));
+            const auto z = O::mul(s, s);
+            const auto w = O::mul(z, z);
+            auto t1 = O::mul_add(w, O::set(1.531383769920937332e-01), O::set(2.222219843214978396e-01));
+            t1 = O::mul(w, O::mul_add(w, t1, O::set(3.999999999940941908e-01)));
+            auto t2 = O::mul_add(w, O::set(1.479819860511658591e-01), O::set(1.818357216161805012e-01));
+            t2 = O::mul_add(w, t2, O::set(2.857142874366239149e-01));
+            t2 = O::mul(z, O::mul_add(w, t2, O::set(6.666666666666735130e-01)));
+            half_f_squared = O::mul(O::mul(O::set(0.5), f), f);
+            tail = O::mul(s, O::add(half_f_squared, O::add(t1, t2)));
+            return x;
+        }
+    };
+
+    struct ln_kernel {
+        static constexpr double ln2_hi = 6.93147180369123816490e-01;
+        static constexpr double ln2_lo = 1.90821492927058770002e-10;
+
+        static double fallback(double x) {
+            return std::log(x);
+        }
+
+        template <typename Ops>
+        static typename Ops::vector evaluate(
+            typename Ops::vector x,
+            typename Ops::mask& special
+        ) {
+            using O = Ops;
+            typename O::vector k, f, hfsq, tail;
+            logarithm_parts::evaluate<O>(x, special, k, f, hfsq, tail);
+            const auto low = O::mul_add(k, O::set(ln2_lo), tail);
+            return O::mul_add(k, O::set(ln2_hi), O::sub(f, O::sub(hfsq, low)));
+        }
+    };
+
+    struct log2_kernel {
+        static constexpr double inverse_ln2 = 1.44269504088896338700e+00;
+
+        static double fallback(double x) {
+            return std::log2(x);
+        }
+
+        template <typename Ops>
+        static typename Ops::vector evaluate(
+            typename Ops::vector x,
+            typename Ops::mask& special
+        ) {
+            using O = Ops;
+            typename O::vector k, f, hfsq, tail;
+            logarithm_parts::evaluate<O>(x, special, k, f, hfsq, tail);
+            const auto fraction = O::sub(f, O::sub(hfsq, tail));
+            return O::mul_add(fraction, O::set(inverse_ln2), k);
+        }
+    };
+
+    struct log10_kernel {
+        static constexpr double log10_2_hi = 3.01029995663611771306e-01;
+        static constexpr double log10_2_lo = 3.69423907715893078616e-13;
+        static constexpr double inverse_ln10 = 4.34294481903251816668e-01;
+
+        static double fallback(double x) {
+            return std::log10(x);
+        }
+
+        template <typename Ops>
+        static typename Ops::vector evaluate(
+            typename Ops::vector x,
+            typename Ops::mask& special
+        ) {
+            using O = Ops;
+            typename O::vector k, f, hfsq, tail;
+            logarithm_parts::evaluate<O>(x, special, k, f, hfsq, tail);
+            const auto fraction = O::sub(f, O::sub(hfsq, tail));
+            const auto low = O::mul_add(fraction, O::set(inverse_ln10), O::mul(k, O::set(log10_2_lo)));
+            return O::mul_add(k, O::set(log10_2_hi), low);
+        }
+    };
+
+    // Rounding half away from zero, as std::round does.
+    struct round_kernel {
+        static double fallback(double x) {
+            return std::round(x);
+        }
+
+        template <typename Ops>
+        static typename Ops::vector evaluate(
+            typename Ops::vector x,
+            typename Ops::mask& special
+        ) {
+            using O = Ops;
+            special = O::none();
+            const auto magnitude = O::abs(x);
+            const auto truncated = O::trunc(magnitude);
+            const auto up = O::less_equal(O::set(0.5), O::sub(magnitude, truncated));
+            const auto rounded = O::select(up, O::add(truncated, O::set(1.0)), truncated);
+            return O::copy_sign(rounded, x);
+        }
+    };
+
+    struct floor_kernel {
+        static double fallback(double x) {
+            return std::floor(x);
+        }
+
+        template <typename Ops>
+        static typename Ops::vector evaluate(
+            typename Ops::vector x,
+            typename Ops::mask& special
+        ) {
+            special = Ops::none();
+            return Ops::floor(x);
+        }
+    };
+
+    struct ceil_kernel {
+        static double fallback(double x) {
+            return std::ceil(x);
+        }
+
+        template <typename Ops>
+        static typename Ops::vector evaluate(
+            typename Ops::vector x,
+            typename Ops::mask& special
+        ) {
+            special = Ops::none();
+            return Ops::ceil(x);
+        }
+    };
+
+    struct abs_kernel {
+        static double fallback(double x) {
+            return std::fabs(x);
+        }
+
+        template <typename Ops>
+        static typename Ops::vector evaluate(
+            typename Ops::vector x,
+            typename Ops::mask& special
+        ) {
+            special = Ops::none();
+            return Ops::abs(x);
+        }
+    };
+
+    // Mirrors the scalar sgn(), including treating values within DBL_EPSILON
+    // of zero as zero and NaN as positive.
+    struct sgn_kernel {
+        static double fallback(double x) {
+            if (std::fabs(x) < DBL_EPSILON)
+                return 0;
+            return x < 0 ? -1 : 1;
+        }
+
+        template <typename Ops>
+        static typename Ops::vector evaluate(
+            typename Ops::vector x,
+            typename Ops::mask& special
+        ) {
+            using O = Ops;
+            special = O::none();
+            const auto sign = O::select(O::less(x, O::set(0.0)), O::set(-1.0), O::set(1.0));
+            return O::select(O::less(O::abs(x), O::set(DBL_EPSILON)), O::set(0.0), sign);
+        }
+    };
+
+    template <typename Kernel, typename Ops>
+    std::size_t run_unary(
+        const double *input,
+        double *output,
+        std::size_t begin,
+        std::size_t count
+    ) {
+        std::size_t i = begin;
+        for (; i + Ops::width <= count; i += Ops::width) {
+            typename Ops::mask special;
+            const auto result = Kernel::template evaluate<Ops>(
+                Ops::load(input + i),
+                special
+            );
+            Ops::store(output + i, result);
+
+            // Inputs the polynomial approximations are not accurate for are
+            // forwarded to the C library one by one.
+            if (const auto lanes = Ops::lanes(special)) {
+                for (std::size_t lane = 0; lane < Ops::width; ++lane) {
+                    if (lanes & (1u << lane))
+                        output[i + lane] = Kernel::fallback(input[i + lane]);
+                }
+            }
+        }
+        return i;
+    }
+
+    template <typename Kernel>
+    void unary(
+        const double * const *arguments,
+        double *output,
+        std::size_t count
+    ) {
+        const auto tail = run_unary<Kernel, vector_ops>(
+            arguments[0],
+            output,
+            0,
+            count
+        );
+        run_unary<Kernel, scalar_ops>(arguments[0], output, tail, count);
+    }
+
+    template <typename Ops>
+    std::size_t run_log_any(
+        const double *values,
+        const double *bases,
+        double *output,
+        std::size_t begin,
+        std::size_t count
+    ) {
+        std::size_t i = begin;
+        for (; i + Ops::width <= count; i += Ops::width) {
+            typename Ops::mask value_special;
+            typename Ops::mask base_special;
+            const auto value = ln_kernel::evaluate<Ops>(
+                Ops::load(values + i),
+                value_special
+            );
+            const auto base = ln_kernel::evaluate<Ops>(
+                Ops::load(bases + i),
+                base_special
+            );
+            Ops::store(output + i, Ops::div(value, base));
+
+            const auto special = Ops::either(value_special, base_special);
+            if (const auto lanes = Ops::lanes(special)) {
+                for (std::size_t lane = 0; lane < Ops::width; ++lane) {
+                    if (lanes & (1u << lane)) {
+                        output[i + lane] = std::log10(values[i + lane]) /
+                                           std::log10(bases[i + lane]);
+                    }
+                }
+            }
+        }
+        return i;
+    }
+}
+
+void expr::kernels::sin(
+    const double * const *arguments,
+    double *output,
+    std::size_t count
+) {
+    unary<sine_kernel<0>>(arguments, output, count);
+}
+
+void expr::kernels::cos(
+    const double * const *arguments,
+    double *output,
+    std::size_t count
+) {
+    unary<sine_kernel<1>>(arguments, output, count);
+}
+
+void expr::kernels::round(
+    const double * const *arguments,
+    double *output,
+    std::size_t count
+) {
+    unary<round_kernel>(arguments, output, count);
+}
+
+void expr::kernels::floor(
+    const double * const *arguments,
+    double *output,
+    std::size_t count
+) {
+    unary<floor_kernel>(arguments, output, count);
+}
+
+void expr::kernels::ceil(
+    const double * const *arguments,
+    double *output,
+    std::size_t count
+) {
+    unary<ceil_kernel>(arguments, output, count);
+}
+
+void expr::kernels::abs(
+    const double * const *arguments,
+    double *output,
+    std::size_t count
+) {
+    unary<abs_kernel>(arguments, output, count);
+}
+
+void expr::kernels::ln(
+    const double * const *arguments,
+    double *output,
+    std::size_t count
+) {
+    unary<ln_kernel>(arguments, output, count);
+}
+
+void expr::kernels::log2(
+    const double * const *arguments,
+    double *output,
+    std::size_t count
+) {
+    unary<log2_kernel>(arguments, output, count);
+}
+
+void expr::kernels::log10(
+    const double * const *arguments,
+    double *output,
+    std::size_t count
+) {
+    unary<log10_kernel>(arguments, output, count);
+}
+
+void expr::kernels::log(
+    const double * const *arguments,
+    double *output,
+    std::size_t count
+) {
+    const auto tail = run_log_any<vector_ops>(
+        arguments[0],
+        arguments[1],
+        output,
+        0,
+        count
+    );
+    run_log_any<scalar_ops>(arguments[0], arguments[1], output, tail, count);
+}
+
+void expr::kernels::sgn(
+    const double * const *arguments,
+    double *output,
+    std::size_t count
+) {
+    unary<sgn_kernel>(arguments, output, count);
+}
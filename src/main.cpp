@@ -1,14 +1,21 @@
+#include "array.h"
 #include "derivator.h"
 #include "evaluator.h"
 #include "functions.h"
 #include "optimizer.h"
 #include "parser.h"
+#include "plugin.h"
 #include "tokenizer.h"
 #include "version.h"
+#include "worksheet.h"
 
+#include <algorithm>        // std::min
 #include <cfloat>           // DBL_EPSILON
+#include <cstdint>          // SIZE_MAX
+#include <cstdlib>          // std::getenv
 #include <cstring>          // strdup, std::strlen, std::strncmp
 #include <iostream>         // std::cout
+#include <optional>         // std::optional
 
 #include <readline/readline.h>  // readline, rl_bind_key
 #include <readline/history.h>   // add_history, using_history
@@ -47,10 +54,17 @@ auto process_and_print(
     return std::move(result);
 }
 
+static expr::quantity printable(expr::quantity quantity) {
+    if (std::abs(quantity.value) < DBL_EPSILON)
+        quantity.value = 0;
+    return quantity;
+}
+
 void evaluate_and_print(
     const expr::parser_result& root,
     std::string_view tree_kind,
-    expr::symbol_table& symbols
+    const expr::worksheet& worksheet,
+    const expr::function_table& functions
 ) {
     if (!root)
         return;
@@ -59,16 +73,29 @@ void evaluate_and_print(
               << tree_kind << " syntax tree: '"
               << expr::to_expression_string(*root) << "'.\n";
 
-    auto evaluated = expr::evaluate(*root, symbols, expr::functions());
+    // Assignments are applied to the worksheet only once all trees of the
+    // expression are printed.
+    auto symbols = worksheet.symbols();
+    auto evaluated = expr::evaluate(*root, symbols, functions);
     if (evaluated.has_value()) {
-        auto formatted = *evaluated;
-        if (std::abs(formatted.value) < DBL_EPSILON)
-            formatted.value = 0;
-        std::cout << "Evaluation result: " << formatted << "\n\n";
-    } else {
+        std::cout << "Evaluation result: " << printable(*evaluated) << "\n\n";
+        return;
+    }
+
+    // Arrays are evaluated by the array evaluator only, which also reports
+    // the errors of the operands instead of wrapping them.
+    symbols = worksheet.symbols();
+    const auto array = expr::evaluate_array(*root, symbols, {}, functions);
+    if (!array) {
         std::cout << "Failed to evaluate: "
-                  << evaluated.error().description << "\n\n";
+                  << array.error().description << "\n\n";
+        return;
     }
+
+    std::cout << "Evaluation result: [";
+    for (std::size_t i = 0; i < array->size(); ++i)
+        std::cout << (i == 0 ? "" : ", ") << printable((*array)[i]);
+    std::cout << "]\n\n";
 }
 
 static std::optional<std::string> find_first_variable(
@@ -89,12 +116,71 @@ static std::optional<std::string> find_first_variable(
     return std::nullopt;
 }
 
-static bool process_expression(std::string_view expression) {
-    static auto symbols = expr::symbol_table{
+static expr::symbol_table make_session_symbols() {
+    return expr::symbol_table{
         {"pi", expr::make_scalar(3.141592653589793238)},
         {"e", expr::make_scalar(2.718281828459045235)}
     };
+}
+
+static void print_update(
+    const expr::worksheet_result& update,
+    const expr::worksheet& worksheet
+) {
+    if (!update) {
+        std::cout << "Failed to update worksheet: "
+                  << update.error().description << "\n\n";
+        return;
+    }
+
+    for (const auto& name : update->changed) {
+        const auto& symbols = worksheet.symbols();
+        const auto where = symbols.find(name);
+        if (where != symbols.end())
+            std::cout << name << " = " << where->second << '\n';
+    }
+
+    for (const auto& [name, error] : update->failures)
+        std::cout << "Failed to recompute '" << name << "': "
+                  << error.description << '\n';
+    std::cout << '\n';
+}
+
+static void update_and_print(
+    expr::node_ptr&& assignment,
+    expr::worksheet& worksheet
+) {
+    separator("Worksheet");
+    print_update(worksheet.assign(std::move(assignment)), worksheet);
+}
+
+static void define_and_print(
+    expr::node_ptr&& definition,
+    expr::function_table& functions,
+    expr::worksheet& worksheet
+) {
+    separator("Definition");
+    const auto name = definition->content;
+    if (auto error = expr::define_function(functions, std::move(definition))) {
+        std::cout << "Failed to define function: "
+                  << error->description << "\n\n";
+        return;
+    }
+    std::cout << "Defined " << functions.at(name).signature << "\n\n";
+
+    // Formulas calling the function are evaluated with its new body.
+    const auto update = worksheet.redefine(name);
+    if (update && update->changed.empty() && update->failures.empty())
+        return;
+    separator("Worksheet");
+    print_update(update, worksheet);
+}
 
+static bool process_expression(
+    std::string_view expression,
+    expr::worksheet& worksheet,
+    expr::function_table& functions
+) {
     separator("Tokenization");
     using tokenize_fn = expr::tokenizer_result (*)(std::string_view);
     auto tokens = process_and_print<tokenize_fn>(
@@ -108,72 +194,115 @@ static bool process_expression(std::string_view expression) {
         return false;
 
     separator("Parsing");
-    const auto parsed = process_and_print(
+    auto parsed = process_and_print(
         expression,
         "parse tokens",
         expr::parse,
         std::move(*tokens)
     );
-    evaluate_and_print(parsed, "parsed", symbols);
-
     if (!parsed)
         return false;
 
+    // Function definitions have no value, they are added to the functions of
+    // the session.
+    if ((*parsed)->type == expr::node_t::type_t::FUNCTION_DEFINITION) {
+        define_and_print(std::move(*parsed), functions, worksheet);
+        return true;
+    }
+
+    evaluate_and_print(parsed, "parsed", worksheet, functions);
+
     separator("Optimization");
-    const auto optimized = process_and_print(
+    using optimize_fn = expr::optimizer_result (*)(
+        const expr::node_ptr&,
+        const expr::function_table&
+    );
+    auto optimized = process_and_print<optimize_fn>(
         expression,
         "optimize expression tree",
         expr::optimize,
-        *parsed
+        *parsed,
+        functions
     );
-    evaluate_and_print(optimized, "optimized", symbols);
+    evaluate_and_print(optimized, "optimized", worksheet, functions);
 
     separator("Derivation");
+    const auto& symbols = worksheet.symbols();
     const auto variable = find_first_variable(*parsed, symbols).value_or("x");
     std::cout << "Derivative is with respect to '" << variable << "'.\n\n";
     const auto derived = process_and_print(
         expression,
         "derive expression",
         expr::derive,
-        std::move(*parsed),
+        expr::inline_functions(*parsed, functions, SIZE_MAX),
         variable
     );
-    evaluate_and_print(derived, "derived", symbols);
+    evaluate_and_print(derived, "derived", worksheet, functions);
+
+    // Formulas are optimized without inlining, so they keep their calls and
+    // follow later redefinitions of the functions.
+    if (optimized && (*optimized)->type == expr::node_t::type_t::ASSIGNMENT) {
+        if (auto formula = expr::optimize(*parsed))
+            update_and_print(std::move(*formula), worksheet);
+    }
 
     return true;
 }
 
-static void print_builtins() {
+// Plugins are listed in the EXPRPARSER_PLUGINS environment variable, separated
+// by colons, and are loaded before anything is evaluated.
+static void load_plugins(expr::function_table& functions) {
+    const char *plugins = std::getenv("EXPRPARSER_PLUGINS");
+    if (plugins == nullptr)
+        return;
+
+    auto paths = std::string_view(plugins);
+    while (!paths.empty()) {
+        const auto end = std::min(paths.find(':'), paths.size());
+        const auto path = std::string(paths.substr(0, end));
+        paths.remove_prefix(std::min(end + 1, paths.size()));
+        if (path.empty())
+            continue;
+
+        if (auto error = expr::load_plugin(functions, path))
+            std::cout << error->description << "\n\n";
+    }
+}
+
+static void print_builtins(const expr::function_table& functions) {
     std::cout << "Available built-in functions:\n";
-    for (const auto& [_, definition] : expr::functions()) {
+    for (const auto& [_, definition] : functions) {
         std::cout << "  " << definition.signature << '\n';
     }
     std::cout << '\n';
 }
 
-static void initialize_gnu_readline() {
+// The functions completed by readline, which has no way to pass them to the
+// completion callback.
+static const expr::function_table *completed_functions = nullptr;
+
+static void initialize_gnu_readline(const expr::function_table& functions) {
+    completed_functions = &functions;
+
     auto completion = [](const char *text, int, int) {
+        // The names are collected anew for every completion, as the session
+        // defines functions between them.
         auto generator = [](const char *text, int state) {
-            static bool initialized = false;
             static std::vector<std::string> symbols;
-            if (!initialized) {
-                const auto& functions = expr::functions();
-                symbols.reserve(functions.size());
-                for (const auto& [name, _] : functions) {
-                    symbols.push_back(name);
-                }
-                initialized = true;
-            }
-
             static size_t index;
             static size_t length;
             if (state == 0) {
+                symbols.clear();
+                symbols.reserve(completed_functions->size());
+                for (const auto& [name, _] : *completed_functions) {
+                    symbols.push_back(name);
+                }
                 index = 0;
                 length = std::strlen(text);
             }
 
-            const char *name;
-            while ((name = symbols[index++].c_str())) {
+            while (index < symbols.size()) {
+                const char *name = symbols[index++].c_str();
                 if (std::strncmp(name, text, length) == 0) {
                     return strdup(name);
                 }
@@ -193,7 +322,6 @@ static void initialize_gnu_readline() {
 }
 
 int main(int argc, char **argv) {
-    initialize_gnu_readline();
 
     std::cout << expr::program_name << ' ' << expr::program_version
               << " (Built with "
@@ -202,8 +330,15 @@ int main(int argc, char **argv) {
 
     --argc, ++argv;
 
+    // Functions of plugins and functions defined in the session are added to
+    // a copy of the builtins.
+    auto functions = expr::functions();
+    load_plugins(functions);
+    auto worksheet = expr::worksheet(functions, make_session_symbols());
+
     if (argc == 0) {
-        print_builtins();
+        initialize_gnu_readline(functions);
+        print_builtins(functions);
 
         while (true) {
             char *input = readline("exprparser> ");
@@ -212,7 +347,7 @@ int main(int argc, char **argv) {
 
             std::cout << std::endl;
             add_history(input);
-            process_expression(input);
+            process_expression(input, worksheet, functions);
             std::free(input);
         }
 
@@ -222,7 +357,7 @@ int main(int argc, char **argv) {
     int status = EXIT_SUCCESS;
     for (int i = 0; i < argc; ++i) {
         std::cout << '"' << argv[i] << "\"\n\n";
-        if (!process_expression(std::string_view(argv[i])))
+        if (!process_expression(std::string_view(argv[i]), worksheet, functions))
             status = EXIT_FAILURE;
         std::cout << "\n\n";
     }
@@ -0,0 +1,572 @@
+#include "memo.h"
+#include "array.h"
+
+#include <algorithm>        // std::any_of, std::equal, std::set_union
+#include <cmath>            // std::isnan
+#include <functional>       // std::hash
+#include <iterator>         // std::back_inserter
+
+static std::size_t combine(std::size_t seed, std::size_t value) noexcept {
+    return seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+}
+
+static std::size_t hash_quantity(const expr::quantity& value) noexcept {
+    auto hash = std::hash<double>{}(value.value);
+    return combine(hash, std::size_t(value.unit.exponents));
+}
+
+static bool is_same_quantity(
+    const expr::quantity& lhs,
+    const expr::quantity& rhs
+) noexcept {
+    return lhs.unit == rhs.unit && lhs.value == rhs.value;
+}
+
+std::size_t expr::memo_cache::subtree_key_hash::operator()(
+    const subtree_key& key
+) const noexcept {
+    auto hash = std::hash<std::string>{}(key.content);
+    hash = combine(hash, std::size_t(key.type));
+    for (const auto child : key.children)
+        hash = combine(hash, child);
+    return hash;
+}
+
+bool expr::memo_cache::call_key::operator==(
+    const call_key& other
+) const noexcept {
+    return definition == other.definition && std::equal(
+        arguments.begin(),
+        arguments.end(),
+        other.arguments.begin(),
+        other.arguments.end(),
+        is_same_quantity
+    );
+}
+
+std::size_t expr::memo_cache::call_key_hash::operator()(
+    const call_key& key
+) const noexcept {
+    auto hash = std::hash<const void *>{}(key.definition);
+    for (const auto& argument : key.arguments)
+        hash = combine(hash, hash_quantity(argument));
+    return hash;
+}
+
+expr::memo_cache::memo_cache(std::size_t call_capacity) :
+    _call_capacity(call_capacity)
+{}
+
+expr::memo_cache::subtree_id expr::memo_cache::intern(
+    const expr::node_t& node,
+    std::span<const subtree_id> children
+) {
+    auto key = subtree_key{
+        .type = node.type,
+        .content = node.content,
+        .children = std::vector<subtree_id>(children.begin(), children.end())
+    };
+
+    const auto [where, inserted] = _ids.try_emplace(
+        std::move(key),
+        subtree_id(_subtrees.size())
+    );
+    if (!inserted)
+        return where->second;
+
+    // The variables of a subtree are kept sorted, so those of the parent are
+    // the union of those of its children.
+    auto subtree = subtree_t{};
+    if (node.type == expr::node_t::type_t::VARIABLE)
+        subtree.variables.push_back(node.content);
+
+    for (const auto child : children) {
+        const auto& variables = _subtrees[child].variables;
+        auto merged = std::vector<std::string>{};
+        std::set_union(
+            subtree.variables.begin(),
+            subtree.variables.end(),
+            variables.begin(),
+            variables.end(),
+            std::back_inserter(merged)
+        );
+        subtree.variables = std::move(merged);
+    }
+
+    _subtrees.push_back(std::move(subtree));
+    return where->second;
+}
+
+std::optional<expr::quantity> expr::memo_cache::find(
+    subtree_id id,
+    const expr::symbol_table& symbols
+) {
+    const auto& subtree = _subtrees[id];
+    auto is_unchanged = [&] {
+        for (std::size_t i = 0; i < subtree.variables.size(); ++i) {
+            const auto where = symbols.find(subtree.variables[i]);
+            if (where == symbols.end())
+                return false;
+            if (!is_same_quantity(where->second, subtree.inputs[i]))
+                return false;
+        }
+        return true;
+    };
+
+    if (!subtree.value || !is_unchanged()) {
+        ++_statistics.subtree_misses;
+        return std::nullopt;
+    }
+
+    ++_statistics.subtree_hits;
+    return subtree.value;
+}
+
+void expr::memo_cache::insert(
+    subtree_id id,
+    expr::quantity value,
+    const expr::symbol_table& symbols
+) {
+    auto& subtree = _subtrees[id];
+    subtree.inputs.clear();
+    for (const auto& variable : subtree.variables) {
+        const auto where = symbols.find(variable);
+        if (where == symbols.end()) {
+            subtree.value.reset();
+            return;
+        }
+        subtree.inputs.push_back(where->second);
+    }
+    subtree.value = value;
+}
+
+static bool has_nan(std::span<const expr::quantity> arguments) noexcept {
+    return std::any_of(arguments.begin(), arguments.end(), [](const auto& argument) {
+        return std::isnan(argument.value);
+    });
+}
+
+std::optional<expr::quantity> expr::memo_cache::find_call(
+    const expr::function_definition_t& definition,
+    std::span<const expr::quantity> arguments
+) {
+    const auto where = _call_index.find(call_key{&definition, arguments});
+    if (where == _call_index.end()) {
+        ++_statistics.call_misses;
+        return std::nullopt;
+    }
+
+    ++_statistics.call_hits;
+    _calls.splice(_calls.begin(), _calls, where->second);
+    return where->second->value;
+}
+
+// Calls with NaN arguments would never be found, as NaN is not equal to
+// itself, so they are not inserted at all.
+void expr::memo_cache::insert_call(
+    const expr::function_definition_t& definition,
+    std::span<const expr::quantity> arguments,
+    expr::quantity value
+) {
+    if (_call_capacity == 0 || has_nan(arguments))
+        return;
+
+    if (const auto where = _call_index.find(call_key{&definition, arguments});
+        where != _call_index.end()) {
+        where->second->value = value;
+        _calls.splice(_calls.begin(), _calls, where->second);
+        return;
+    }
+
+    if (_calls.size() == _call_capacity) {
+        const auto& oldest = _calls.back();
+        _call_index.erase(call_key{oldest.definition, oldest.arguments});
+        _calls.pop_back();
+        ++_statistics.call_evictions;
+    }
+
+    _calls.push_front(call_t{
+        .definition = &definition,
+        .arguments = std::vector<expr::quantity>(arguments.begin(), arguments.end()),
+        .value = value
+    });
+    const auto& call = _calls.front();
+    _call_index.emplace(call_key{call.definition, call.arguments}, _calls.begin());
+}
+
+const expr::memo_statistics& expr::memo_cache::statistics() const noexcept {
+    return _statistics;
+}
+
+void expr::memo_cache::clear() {
+    _ids.clear();
+    _subtrees.clear();
+    _call_index.clear();
+    _calls.clear();
+    _statistics = expr::memo_statistics{};
+}
+
+struct memo_subtree_t {
+    expr::memo_cache::subtree_id id;
+    std::uint32_t size;
+
+    // Subtrees without assignments and calls of impure functions always
+    // evaluate to the same value for the same variables.
+    bool is_pure;
+};
+
+static memo_subtree_t memoize_node(
+    const expr::node_t& node,
+    const expr::function_table& functions,
+    expr::memo_cache& cache,
+    std::vector<expr::memoized_expression::node_info_t>& nodes
+) {
+    const auto index = nodes.size();
+    nodes.emplace_back();
+
+    bool is_pure = true;
+    bool is_leaf = false;
+    switch (node.type) {
+        case expr::node_t::type_t::ASSIGNMENT:
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+            is_pure = false;
+            break;
+        case expr::node_t::type_t::FUNCTION_CALL: {
+            const auto where = functions.find(node.content);
+            is_pure = where != functions.end() ? where->second.is_pure
+                                               : expr::is_reduction(node.content);
+            break;
+        }
+        // Leaves are cheaper to evaluate than to look up.
+        case expr::node_t::type_t::NUMBER:
+        case expr::node_t::type_t::VARIABLE:
+        case expr::node_t::type_t::UNIT:
+            is_leaf = true;
+            break;
+        case expr::node_t::type_t::BINARY_OP:
+        case expr::node_t::type_t::UNARY_OP:
+        case expr::node_t::type_t::UNIT_APPLICATION:
+        case expr::node_t::type_t::ARRAY:
+        case expr::node_t::type_t::CONDITIONAL:
+            break;
+    }
+
+    std::vector<expr::memo_cache::subtree_id> children;
+    children.reserve(node.children.size());
+    std::uint32_t size = 1;
+    for (const auto& child : node.children) {
+        const auto subtree = memoize_node(*child, functions, cache, nodes);
+        children.push_back(subtree.id);
+        size += subtree.size;
+        is_pure = is_pure && subtree.is_pure;
+    }
+
+    const auto id = cache.intern(node, children);
+    nodes[index] = expr::memoized_expression::node_info_t{
+        .id = id,
+        .size = size,
+        .is_cacheable = is_pure && !is_leaf
+    };
+    return memo_subtree_t{.id = id, .size = size, .is_pure = is_pure};
+}
+
+class memo_evaluator_impl final {
+public:
+    memo_evaluator_impl(
+        const expr::memoized_expression& expression,
+        expr::symbol_table& symbols,
+        expr::memo_cache& cache
+    );
+
+    expr::evaluator_result evaluate();
+
+private:
+    // Nodes are passed along with their index in the pre-order of the tree.
+    expr::evaluator_result evaluate_node(
+        const expr::node_ptr& node,
+        std::size_t index
+    );
+    expr::evaluator_result evaluate_node_contents(
+        const expr::node_ptr& node,
+        std::size_t index
+    );
+    expr::evaluator_result evaluate_binary_operator(
+        const expr::node_ptr& node,
+        std::size_t index
+    );
+    expr::evaluator_result evaluate_unary_operator(
+        const expr::node_ptr& node,
+        std::size_t index
+    );
+    expr::evaluator_result evaluate_unit_application(
+        const expr::node_ptr& node,
+        std::size_t index
+    );
+    expr::evaluator_result evaluate_function_call(
+        const expr::node_ptr& node,
+        std::size_t index
+    );
+    expr::evaluator_result evaluate_assignment(
+        const expr::node_ptr& node,
+        std::size_t index
+    );
+    expr::evaluator_result evaluate_conditional(
+        const expr::node_ptr& node,
+        std::size_t index
+    );
+
+private:
+    std::size_t next_sibling(std::size_t index) const {
+        return index + _expression.nodes[index].size;
+    }
+
+private:
+    const expr::memoized_expression& _expression;
+    expr::symbol_table& _symbols;
+    const expr::function_table& _functions;
+    expr::memo_cache& _cache;
+};
+
+memo_evaluator_impl::memo_evaluator_impl(
+    const expr::memoized_expression& expression,
+    expr::symbol_table& symbols,
+    expr::memo_cache& cache
+) :
+    _expression(expression),
+    _symbols(symbols),
+    _functions(*expression.functions),
+    _cache(cache)
+{}
+
+expr::evaluator_result memo_evaluator_impl::evaluate_binary_operator(
+    const expr::node_ptr& node,
+    std::size_t index
+) {
+    const auto left = index + 1;
+    const auto right = next_sibling(left);
+    return expr::apply_binary_operator(
+        *node,
+        evaluate_node(node->children[0], left),
+        evaluate_node(node->children[1], right)
+    );
+}
+
+expr::evaluator_result memo_evaluator_impl::evaluate_unary_operator(
+    const expr::node_ptr& node,
+    std::size_t index
+) {
+    const auto operand = evaluate_node(node->children[0], index + 1);
+    if (!operand) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+            .location = node->location,
+            .description = "Failed to evaluate operand."
+        };
+    }
+
+    if (node->content == "-")
+        return expr::negate(*operand);
+    return expr::identity(*operand);
+}
+
+expr::evaluator_result memo_evaluator_impl::evaluate_unit_application(
+    const expr::node_ptr& node,
+    std::size_t index
+) {
+    const auto subexpression = evaluate_node(node->children[0], index + 1);
+    if (!subexpression)
+        return subexpression.error();
+
+    const auto factor = expr::make_unit(node->children[1]->content);
+    if (!factor)
+        return factor.error();
+
+    return expr::multiply(*subexpression, *factor);
+}
+
+expr::evaluator_result memo_evaluator_impl::evaluate_function_call(
+    const expr::node_ptr& node,
+    std::size_t index
+) {
+    auto where = _functions.find(node->content);
+    if (where == _functions.end()) {
+        // Reductions are evaluated by the tree evaluator, which evaluates
+        // their arguments as arrays, and so are series.
+        if (expr::is_reduction(node->content))
+            return expr::evaluate(node, _symbols, _functions);
+
+        const auto& location = node->location.begin;
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_UNDEFINED_FUNCTION,
+            .location = expr::location_t{
+                .begin = location,
+                .end = location + node->content.length() - 1
+            },
+            .description = {"Undefined function '{0}'.", node->content}
+        };
+    }
+
+    // User functions are evaluated by the tree evaluator, which binds their
+    // parameters.
+    const auto& definition = where->second;
+    if (definition.user_function != nullptr)
+        return expr::evaluate(node, _symbols, _functions);
+
+    const auto count = node->children.size();
+    if (auto error = expr::validate_argument_count(definition, count, node->location))
+        return std::move(*error);
+
+    std::vector<expr::quantity> arguments;
+    arguments.reserve(count);
+    auto child = index + 1;
+    for (const auto& argument_node : node->children) {
+        auto argument = evaluate_node(argument_node, child);
+        if (!argument) {
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+                .location = node->location,
+                .description = {
+                    "Failed to evaluate function arguments for '{0}()'.",
+                    node->content
+                }
+            };
+        }
+        arguments.push_back(*argument);
+        child = next_sibling(child);
+    }
+
+    if (!definition.is_pure)
+        return expr::invoke(definition, arguments, node->location);
+
+    if (auto cached = _cache.find_call(definition, arguments))
+        return *cached;
+
+    auto result = expr::invoke(definition, arguments, node->location);
+    if (result)
+        _cache.insert_call(definition, arguments, *result);
+    return result;
+}
+
+expr::evaluator_result memo_evaluator_impl::evaluate_assignment(
+    const expr::node_ptr& node,
+    std::size_t index
+) {
+    auto result = evaluate_node(node->children[1], next_sibling(index + 1));
+    if (!result) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+            .location = node->location,
+            .description = "Failed to evaluate function right-hand side for "
+                           "variable assignment."
+        };
+    }
+    _symbols[node->children[0]->content] = *result;
+    return result;
+}
+
+expr::evaluator_result memo_evaluator_impl::evaluate_conditional(
+    const expr::node_ptr& node,
+    std::size_t index
+) {
+    const auto condition = index + 1;
+    const auto then = next_sibling(condition);
+    const auto otherwise = next_sibling(then);
+
+    const auto failure = expr::error{
+        .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+        .location = node->location,
+        .description = "Failed to evaluate operand."
+    };
+
+    const auto truth = evaluate_node(node->children[0], condition);
+    if (!truth)
+        return failure;
+
+    auto result = truth->value != 0
+                ? evaluate_node(node->children[1], then)
+                : evaluate_node(node->children[2], otherwise);
+    if (!result)
+        return failure;
+    return result;
+}
+
+expr::evaluator_result memo_evaluator_impl::evaluate_node_contents(
+    const expr::node_ptr& node,
+    std::size_t index
+) {
+    switch (node->type) {
+        case expr::node_t::type_t::BINARY_OP:
+            return evaluate_binary_operator(node, index);
+        case expr::node_t::type_t::UNARY_OP:
+            return evaluate_unary_operator(node, index);
+        case expr::node_t::type_t::FUNCTION_CALL:
+            return evaluate_function_call(node, index);
+        case expr::node_t::type_t::ASSIGNMENT:
+            return evaluate_assignment(node, index);
+        case expr::node_t::type_t::UNIT_APPLICATION:
+            return evaluate_unit_application(node, index);
+        case expr::node_t::type_t::CONDITIONAL:
+            return evaluate_conditional(node, index);
+        case expr::node_t::type_t::NUMBER:
+        case expr::node_t::type_t::VARIABLE:
+        case expr::node_t::type_t::UNIT:
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+        case expr::node_t::type_t::ARRAY:
+            break;
+    }
+
+    return expr::evaluate(node, _symbols, _functions);
+}
+
+expr::evaluator_result memo_evaluator_impl::evaluate_node(
+    const expr::node_ptr& node,
+    std::size_t index
+) {
+    const auto& info = _expression.nodes[index];
+    if (info.is_cacheable) {
+        if (auto cached = _cache.find(info.id, _symbols))
+            return *cached;
+    }
+
+    // Errors are not cached, as they refer to the location of the subtree.
+    auto result = evaluate_node_contents(node, index);
+    if (info.is_cacheable && result)
+        _cache.insert(info.id, *result, _symbols);
+    return result;
+}
+
+expr::evaluator_result memo_evaluator_impl::evaluate() {
+    return evaluate_node(*_expression.root, 0);
+}
+
+expr::memoized_expression expr::memoize(
+    const expr::node_ptr& root,
+    const expr::function_table& functions,
+    expr::memo_cache& cache
+) {
+    auto expression = expr::memoized_expression{
+        .root = &root,
+        .functions = &functions,
+        .nodes = {}
+    };
+    memoize_node(*root, functions, cache, expression.nodes);
+    return expression;
+}
+
+expr::evaluator_result expr::evaluate(
+    const expr::memoized_expression& expression,
+    expr::symbol_table& symbols,
+    expr::memo_cache& cache
+) {
+    auto evaluator = memo_evaluator_impl(expression, symbols, cache);
+    return evaluator.evaluate();
+}
+
+expr::evaluator_result expr::evaluate(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    expr::memo_cache& cache
+) {
+    return expr::evaluate(expr::memoize(node, functions, cache), symbols, cache);
+}
@@ -5,18 +5,22 @@
 enum precedence_t {
     INVALID_PRECEDENCE = 0,
     ASSIGNMENT_PRECEDENCE = 1,
-    TERM_PRECEDENCE = 2,
-    FACTOR_PRECEDENCE = 3,
-    POWER_PRECEDENCE = 4,
-    UNARY_PRECEDENCE = 5,
-    PRIMARY_PRECEDENCE = 6
+    COMPARISON_PRECEDENCE = 2,
+    TERM_PRECEDENCE = 3,
+    FACTOR_PRECEDENCE = 4,
+    POWER_PRECEDENCE = 5,
+    UNARY_PRECEDENCE = 6,
+    PRIMARY_PRECEDENCE = 7
 };
 
 static precedence_t get_precedence_score(const expr::node_ptr& node) noexcept {
     switch (node->type) {
         case expr::node_t::type_t::ASSIGNMENT:
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
             return ASSIGNMENT_PRECEDENCE;
         case expr::node_t::type_t::BINARY_OP: {
+            if (expr::is_comparison(node->content))
+                return COMPARISON_PRECEDENCE;
             if (node->content == "+" || node->content == "-")
                 return TERM_PRECEDENCE;
             if (node->content == "*" || node->content == "/")
@@ -30,6 +34,8 @@ static precedence_t get_precedence_score(const expr::node_ptr& node) noexcept {
         case expr::node_t::type_t::VARIABLE:
         case expr::node_t::type_t::UNIT:
         case expr::node_t::type_t::UNIT_APPLICATION:
+        case expr::node_t::type_t::ARRAY:
+        case expr::node_t::type_t::CONDITIONAL:
             return PRIMARY_PRECEDENCE;
     }
 
@@ -88,6 +94,27 @@ static std::string assignment_to_expression_string(const expr::node_ptr& node) {
     return lhs + " = " + rhs;
 }
 
+static std::string function_definition_to_expression_string(
+    const expr::node_ptr& node
+) {
+    std::string result = node->content + "(";
+    const auto parameters = node->children.size() - 1;
+    for (size_t i = 0; i < parameters; ++i) {
+        result += node->children[i]->content;
+        result += (i + 1 == parameters) ? ")" : ", ";
+    }
+    return result + " = " + expr::to_expression_string(node->children.back());
+}
+
+static std::string array_to_expression_string(const expr::node_ptr& node) {
+    std::string result = "[";
+    for (size_t i = 0; i < node->children.size(); ++i) {
+        result += (i == 0) ? "" : ", ";
+        result += expr::to_expression_string(node->children[i]);
+    }
+    return result + "]";
+}
+
 bool expr::operator==(
     const expr::node_t& lhs,
     const expr::node_t& rhs
@@ -254,6 +281,67 @@ expr::node_ptr expr::make_unit_application_node(
     return result;
 }
 
+expr::node_ptr expr::make_function_definition_node(
+    std::string name,
+    std::vector<expr::node_ptr>&& parameters,
+    expr::node_ptr&& body,
+    const expr::location_t& location
+) {
+    expr::node_ptr result = std::unique_ptr<expr::node_t>(
+        new expr::node_t{
+            .type = expr::node_t::type_t::FUNCTION_DEFINITION,
+            .content = std::move(name),
+            .children = std::move(parameters),
+            .location = location
+        }
+    );
+
+    result->children.push_back(std::move(body));
+
+    return result;
+}
+
+expr::node_ptr expr::make_array_node(
+    std::vector<expr::node_ptr>&& elements,
+    const expr::location_t& location
+) {
+    return std::unique_ptr<expr::node_t>(
+        new expr::node_t{
+            .type = expr::node_t::type_t::ARRAY,
+            .content = "[]",
+            .children = std::move(elements),
+            .location = location
+        }
+    );
+}
+
+expr::node_ptr expr::make_conditional_node(
+    expr::node_ptr&& condition,
+    expr::node_ptr&& then_branch,
+    expr::node_ptr&& else_branch,
+    const expr::location_t& location
+) {
+    expr::node_ptr result = std::unique_ptr<expr::node_t>(
+        new expr::node_t{
+            .type = expr::node_t::type_t::CONDITIONAL,
+            .content = "if",
+            .children = {},
+            .location = location
+        }
+    );
+
+    result->children.push_back(std::move(condition));
+    result->children.push_back(std::move(then_branch));
+    result->children.push_back(std::move(else_branch));
+
+    return result;
+}
+
+bool expr::is_comparison(std::string_view operation) {
+    return operation == "<" || operation == "<=" || operation == ">"
+        || operation == ">=" || operation == "==" || operation == "!=";
+}
+
 std::ostream& operator<<(std::ostream& stream, expr::node_t::type_t type) {
     switch (type) {
         case expr::node_t::type_t::BINARY_OP:
@@ -272,6 +360,12 @@ std::ostream& operator<<(std::ostream& stream, expr::node_t::type_t type) {
             return stream << "Unit";
         case expr::node_t::type_t::UNIT_APPLICATION:
             return stream << "UnitApplication";
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+            return stream << "FunctionDefinition";
+        case expr::node_t::type_t::ARRAY:
+            return stream << "Array";
+        case expr::node_t::type_t::CONDITIONAL:
+            return stream << "Conditional";
     }
 
     // Unreachable
@@ -295,6 +389,12 @@ std::string expr::to_expression_string(const expr::node_ptr& root) {
             return root->content;
         case expr::node_t::type_t::UNIT_APPLICATION:
             return unit_application_to_expression_string(root);
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+            return function_definition_to_expression_string(root);
+        case expr::node_t::type_t::ARRAY:
+            return array_to_expression_string(root);
+        case expr::node_t::type_t::CONDITIONAL:
+            return function_call_to_expression_string(root);
     }
 
     // Unreachable
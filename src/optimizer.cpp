@@ -1,9 +1,16 @@
 #include "optimizer.h"
+#include "array.h"
 #include "evaluator.h"
+#include "series.h"
 #include "utility.h"
 
+#include <algorithm>        // std::any_of, std::find
+#include <array>            // std::array
+#include <charconv>         // std::to_chars
+#include <cmath>            // std::fabs, std::isfinite
 #include <optional>         // std::optional
-#include <sstream>          // std::stringstream, iostream, iomanip
+#include <span>             // std::span
+#include <vector>           // std::vector
 
 static bool are_all_children_numbers(
     const std::vector<expr::node_ptr>& children
@@ -21,10 +28,62 @@ static bool are_binary_operands_the_same(
     return operands.size() == 2 && *operands[0] == *operands[1];
 }
 
+// The shortest representation which reads back as the same value, so folding
+// a subexpression does not round its value.
 static std::string make_number_representation(expr::quantity value) {
-    std::stringstream converter;
-    converter << std::noshowpoint << value.value;
-    return converter.str();
+    std::array<char, 32> buffer;
+    const auto end = buffer.data() + buffer.size();
+    const auto last = std::to_chars(buffer.data(), end, value.value).ptr;
+    return std::string(buffer.data(), last);
+}
+
+// Integers from 2^53 up are only known exactly while they are evaluated, in
+// 64 bits, a number literal of them would be rounded to double. So
+// subexpressions giving one are kept as they are.
+static bool is_foldable(const expr::quantity& value) {
+    const auto magnitude = std::fabs(value.value);
+    return magnitude < expr::max_exact_integer || magnitude >= 0x1p63;
+}
+
+// Calls of pure functions with constant arguments are evaluated, if they give
+// a finite scalar. Calls the evaluator would reject are kept as they are, so
+// it reports the error.
+static std::optional<expr::node_ptr> make_folded_call(
+    const expr::node_ptr& call,
+    const expr::function_table& functions
+) {
+    const auto where = functions.find(call->content);
+    if (where == functions.end() || !where->second.is_pure)
+        return std::nullopt;
+
+    const auto& definition = where->second;
+    const auto count = call->children.size();
+    if (count > expr::max_builtin_arity)
+        return std::nullopt;
+    if (expr::validate_argument_count(definition, count, call->location))
+        return std::nullopt;
+
+    std::array<expr::quantity, expr::max_builtin_arity> buffer;
+    const auto arguments = std::span(buffer).first(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto value = expr::evaluate_parse_time(call->children[i]);
+        if (!value)
+            return std::nullopt;
+        arguments[i] = *value;
+    }
+
+    const auto constant_arguments = std::span<const expr::quantity>(arguments);
+    if (expr::validate_arguments(definition, constant_arguments, call->location))
+        return std::nullopt;
+
+    const auto result = expr::invoke(definition, constant_arguments, call->location);
+    if (!result || !result->is_scalar() || !std::isfinite(result->value))
+        return std::nullopt;
+
+    return expr::make_number_literal_node(
+        make_number_representation(*result),
+        call->location
+    );
 }
 
 static std::optional<expr::optimizer_result> make_optimized_addition(
@@ -47,12 +106,15 @@ static std::optional<expr::optimizer_result> make_optimized_addition(
     return std::nullopt;
 }
 
+// Within the arguments of reductions, operands may be arrays, whose size has
+// to be kept, so subexpressions are not replaced by a single value there.
 static std::optional<expr::optimizer_result> make_optimized_subtraction(
     expr::node_ptr& original,
-    const expr::location_t location
+    const expr::location_t location,
+    bool keeps_size
 ) {
     // Subtraction of a variable from itself results in 0.
-    if (are_binary_operands_the_same(original->children))
+    if (!keeps_size && are_binary_operands_the_same(original->children))
         return expr::make_number_literal_node("0", location);
 
     const expr::evaluator_result values[2] = {
@@ -78,7 +140,8 @@ static std::optional<expr::optimizer_result> make_optimized_subtraction(
 
 static std::optional<expr::optimizer_result> make_optimized_multiplication(
     expr::node_ptr& original,
-    const expr::location_t location
+    const expr::location_t location,
+    bool keeps_size
 ) {
     // Multiplication of a variable with itself is its 2nd power.
     if (are_binary_operands_the_same(original->children)) {
@@ -97,7 +160,7 @@ static std::optional<expr::optimizer_result> make_optimized_multiplication(
         const auto value = expr::evaluate_parse_time(original->children[i]);
 
         // Multiplication with 0 results in 0, regardless of units.
-        if (value && expr::is_near(value->value, 0))
+        if (!keeps_size && value && expr::is_near(value->value, 0))
             return expr::make_number_literal_node("0", location);
 
         // Multiplication with scalar 1 is a no-op (both ways).
@@ -119,10 +182,11 @@ static std::optional<expr::optimizer_result> make_optimized_multiplication(
 
 static std::optional<expr::optimizer_result> make_optimized_division(
     expr::node_ptr& original,
-    const expr::location_t location
+    const expr::location_t location,
+    bool keeps_size
 ) {
     // Division of a variable with itself results in 1.
-    if (are_binary_operands_the_same(original->children)) {
+    if (!keeps_size && are_binary_operands_the_same(original->children)) {
         return  expr::make_number_literal_node("1", location);
     }
 
@@ -132,7 +196,7 @@ static std::optional<expr::optimizer_result> make_optimized_division(
     };
 
     // Division of 0 is always 0.
-    if (values[0] && expr::is_near(values[0]->value, 0))
+    if (!keeps_size && values[0] && expr::is_near(values[0]->value, 0))
         return expr::make_number_literal_node("0", location);
 
     // Division with scalar 1 is a no-op.
@@ -153,7 +217,8 @@ static std::optional<expr::optimizer_result> make_optimized_division(
 
 static std::optional<expr::optimizer_result> make_optimized_exponentiation(
     expr::node_ptr& original,
-    const expr::location_t location
+    const expr::location_t location,
+    bool keeps_size
 ) {
     const auto value = expr::evaluate_parse_time(original->children[1]);
 
@@ -162,7 +227,7 @@ static std::optional<expr::optimizer_result> make_optimized_exponentiation(
         return std::nullopt;
 
     // The 0th power of every number is 1.
-    if (value && expr::is_near(value->value, 0))
+    if (!keeps_size && value && expr::is_near(value->value, 0))
         return expr::make_number_literal_node("1", location);
 
     // The 1st power of every number is itself.
@@ -175,7 +240,8 @@ static std::optional<expr::optimizer_result> make_optimized_exponentiation(
 static expr::optimizer_result make_optimized_binary_op(
     const std::string& operation,
     std::vector<expr::node_ptr> children,
-    expr::location_t location
+    expr::location_t location,
+    bool keeps_size
 ) {
     // We construct a node with the already-optimized children, that we can
     // perform optimizations on.
@@ -191,7 +257,7 @@ static expr::optimizer_result make_optimized_binary_op(
     // If every operand is a number, the expression can be evaluated parse-time.
     if (are_all_children_numbers(original->children)) {
         const auto value = expr::evaluate_parse_time(original);
-        if (value) {
+        if (value && is_foldable(*value)) {
             return expr::make_number_literal_node(
                 make_number_representation(*value),
                 location
@@ -208,22 +274,22 @@ static expr::optimizer_result make_optimized_binary_op(
     }
 
     if (operation == "-") {
-        if (auto optimized = make_optimized_subtraction(original, location))
+        if (auto optimized = make_optimized_subtraction(original, location, keeps_size))
             return std::move(*optimized);
     }
 
     if (operation == "*") {
-        if (auto optimized = make_optimized_multiplication(original, location))
+        if (auto optimized = make_optimized_multiplication(original, location, keeps_size))
             return std::move(*optimized);
     }
 
     if (operation == "/") {
-        if (auto optimized = make_optimized_division(original, location))
+        if (auto optimized = make_optimized_division(original, location, keeps_size))
             return std::move(*optimized);
     }
 
     if (operation == "^") {
-        if (auto optimized = make_optimized_exponentiation(original, location))
+        if (auto optimized = make_optimized_exponentiation(original, location, keeps_size))
             return std::move(*optimized);
     }
 
@@ -232,12 +298,31 @@ static expr::optimizer_result make_optimized_binary_op(
     return original;
 }
 
+static expr::optimizer_result optimize_node(
+    const expr::node_ptr& root,
+    const expr::function_table& functions,
+    bool keeps_size
+);
+
+static bool is_reduction_call(
+    const expr::node_ptr& node,
+    const expr::function_table& functions
+) {
+    return node->type == expr::node_t::type_t::FUNCTION_CALL
+        && !functions.contains(node->content)
+        && expr::is_reduction(node->content);
+}
+
 static std::vector<expr::node_ptr> optimize_children(
-    const expr::node_ptr& node
+    const expr::node_ptr& node,
+    const expr::function_table& functions,
+    bool keeps_size
 ) {
+    keeps_size = keeps_size || is_reduction_call(node, functions);
+
     std::vector<expr::node_ptr> result;
     for (auto& child : node->children) {
-        if (auto optimized = expr::optimize(child)) {
+        if (auto optimized = optimize_node(child, functions, keeps_size)) {
             result.push_back(std::move(*optimized));
         } else {
             return result;
@@ -246,10 +331,14 @@ static std::vector<expr::node_ptr> optimize_children(
     return result;
 }
 
-expr::optimizer_result expr::optimize(const expr::node_ptr& root) {
+static expr::optimizer_result optimize_node(
+    const expr::node_ptr& root,
+    const expr::function_table& functions,
+    bool keeps_size
+) {
     // First, we optimize all the children of the node so we can perform later
     // checks on the simplest equivalent subexpression.
-    auto children = optimize_children(root);
+    auto children = optimize_children(root, functions, keeps_size);
     if (children.size() != root->children.size()) {
         return expr::error {
             .code = expr::error_code::OPTIMIZER_FAILED_TO_OPTIMIZE_CHILD,
@@ -275,30 +364,52 @@ expr::optimizer_result expr::optimize(const expr::node_ptr& root) {
         new expr::node_t {
             .type = root->type,
             .content = root->content,
-            .children = optimize_children(root),
+            .children = std::move(children),
             .location = root->location
         }
     };
-    if (auto evaluated = expr::evaluate_parse_time(preoptimized)) {
+    // Number literals can only represent scalars, so subexpressions with a
+    // unit are kept as they are.
+    auto evaluated = expr::evaluate_parse_time(preoptimized);
+    if (evaluated && evaluated->is_scalar() && is_foldable(*evaluated)) {
         return expr::make_number_literal_node(
             make_number_representation(*evaluated),
             root->location
         );
     }
 
+    if (root->type == expr::node_t::type_t::FUNCTION_CALL) {
+        if (auto folded = make_folded_call(preoptimized, functions))
+            return std::move(*folded);
+    }
+
+    // The children are optimized only once, optimizing them again for every
+    // level of the tree would take exponential time.
+    children = std::move(preoptimized->children);
+
     if (root->type == expr::node_t::type_t::BINARY_OP) {
         return make_optimized_binary_op(
             root->content,
             std::move(children),
-            root->location
+            root->location,
+            keeps_size
         );
     }
 
+    // A conditional on a number always takes the same branch.
+    if (root->type == expr::node_t::type_t::CONDITIONAL) {
+        if (children[0]->type == expr::node_t::type_t::NUMBER) {
+            if (const auto value = expr::evaluate_parse_time(children[0]))
+                return std::move(children[value->value != 0 ? 1 : 2]);
+        }
+    }
+
     // Unary operations on simple numbers are either no-op or a sign change.
     // Both can be evaluated during parse-time.
     if (root->type == expr::node_t::type_t::UNARY_OP) {
         if (root->children[0]->type == expr::node_t::type_t::NUMBER) {
-            if (const auto value = expr::evaluate_parse_time(root)) {
+            const auto value = expr::evaluate_parse_time(root);
+            if (value && is_foldable(*value)) {
                 return expr::make_number_literal_node(
                     make_number_representation(*value),
                     root->location
@@ -318,3 +429,224 @@ expr::optimizer_result expr::optimize(const expr::node_ptr& root) {
         }
     };
 }
+
+expr::optimizer_result expr::optimize(const expr::node_ptr& root) {
+    return optimize_node(root, expr::functions(), false);
+}
+
+expr::optimizer_result expr::optimize(
+    const expr::node_ptr& root,
+    const expr::function_table& functions
+) {
+    return optimize_node(
+        expr::inline_functions(root, functions),
+        functions,
+        false
+    );
+}
+
+class function_inliner_impl final {
+public:
+    function_inliner_impl(
+        const expr::function_table& functions,
+        std::size_t max_size
+    );
+
+    expr::node_ptr inline_calls(const expr::node_ptr& node);
+
+private:
+    const expr::user_function_t *find_inlined(const expr::node_ptr& call) const;
+    expr::node_ptr substitute(
+        const expr::node_ptr& node,
+        const expr::user_function_t& function,
+        std::span<const expr::node_ptr> arguments,
+        const expr::location_t& location
+    ) const;
+    expr::node_ptr rename_index(
+        const expr::node_ptr& series,
+        const expr::user_function_t& function,
+        std::span<const expr::node_ptr> arguments
+    ) const;
+
+private:
+    const expr::function_table& _functions;
+    const std::size_t _max_size;
+
+    // The functions whose body is being inlined, calls to them are recursive.
+    std::vector<const expr::user_function_t *> _expanding;
+};
+
+static std::size_t count_nodes(const expr::node_ptr& node) {
+    std::size_t count = 1;
+    for (const auto& child : node->children)
+        count += count_nodes(child);
+    return count;
+}
+
+static expr::node_ptr clone(const expr::node_ptr& node) {
+    auto result = expr::node_ptr{
+        new expr::node_t{
+            .type = node->type,
+            .content = node->content,
+            .children = {},
+            .location = node->location
+        }
+    };
+    for (const auto& child : node->children)
+        result->children.push_back(clone(child));
+    return result;
+}
+
+static bool refers_to(const expr::node_ptr& node, const std::string& name) {
+    if (node->type == expr::node_t::type_t::VARIABLE && node->content == name)
+        return true;
+    return std::any_of(node->children.begin(), node->children.end(), [&](const auto& child) {
+        return refers_to(child, name);
+    });
+}
+
+static void rename_variable(
+    expr::node_ptr& node,
+    const std::string& from,
+    const std::string& to
+) {
+    if (node->type == expr::node_t::type_t::VARIABLE && node->content == from)
+        node->content = to;
+    for (auto& child : node->children)
+        rename_variable(child, from, to);
+}
+
+function_inliner_impl::function_inliner_impl(
+    const expr::function_table& functions,
+    std::size_t max_size
+) :
+    _functions(functions),
+    _max_size(max_size)
+{}
+
+const expr::user_function_t *function_inliner_impl::find_inlined(
+    const expr::node_ptr& call
+) const {
+    const auto where = _functions.find(call->content);
+    if (where == _functions.end())
+        return nullptr;
+
+    const auto *function = where->second.user_function.get();
+    if (function == nullptr)
+        return nullptr;
+
+    const bool is_recursive = std::find(
+        _expanding.begin(),
+        _expanding.end(),
+        function
+    ) != _expanding.end();
+    const bool is_inlined = !is_recursive
+        && _expanding.size() < expr::max_call_depth
+        && call->children.size() == function->parameters.size()
+        && count_nodes(function->body) <= _max_size;
+    return is_inlined ? function : nullptr;
+}
+
+expr::node_ptr function_inliner_impl::substitute(
+    const expr::node_ptr& node,
+    const expr::user_function_t& function,
+    std::span<const expr::node_ptr> arguments,
+    const expr::location_t& location
+) const {
+    if (node->type == expr::node_t::type_t::VARIABLE) {
+        const auto& parameters = function.parameters;
+        const auto where = std::find(parameters.begin(), parameters.end(), node->content);
+        if (where != parameters.end())
+            return clone(arguments[std::size_t(where - parameters.begin())]);
+    }
+
+    if (expr::is_series(*node) && !_functions.contains(node->content)) {
+        if (auto renamed = rename_index(node, function, arguments))
+            return substitute(renamed, function, arguments, location);
+    }
+
+    auto result = expr::node_ptr{
+        new expr::node_t{
+            .type = node->type,
+            .content = node->content,
+            .children = {},
+            .location = location
+        }
+    };
+    for (const auto& child : node->children)
+        result->children.push_back(substitute(child, function, arguments, location));
+    return result;
+}
+
+// The index of a series hides the parameter of the same name, and would
+// capture the variables of the same name in the arguments. Either way it is
+// given a name that can't be written in expressions, and no argument refers
+// to, before the parameters are replaced. Gives null if neither is the case.
+expr::node_ptr function_inliner_impl::rename_index(
+    const expr::node_ptr& series,
+    const expr::user_function_t& function,
+    std::span<const expr::node_ptr> arguments
+) const {
+    const auto& index = series->children[0];
+    if (index->type != expr::node_t::type_t::VARIABLE)
+        return nullptr;
+
+    const auto& parameters = function.parameters;
+    auto is_taken = [&](const std::string& name) {
+        return std::find(parameters.begin(), parameters.end(), name) != parameters.end()
+            || std::any_of(arguments.begin(), arguments.end(), [&](const auto& argument) {
+                   return refers_to(argument, name);
+               });
+    };
+    if (!is_taken(index->content))
+        return nullptr;
+
+    auto name = index->content + "'";
+    while (is_taken(name))
+        name += "'";
+
+    // The bounds are not in the scope of the index.
+    auto result = clone(series);
+    rename_variable(result->children[0], index->content, name);
+    rename_variable(result->children[3], index->content, name);
+    return result;
+}
+
+expr::node_ptr function_inliner_impl::inline_calls(const expr::node_ptr& node) {
+    if (node->type == expr::node_t::type_t::FUNCTION_DEFINITION)
+        return clone(node);
+
+    auto result = expr::node_ptr{
+        new expr::node_t{
+            .type = node->type,
+            .content = node->content,
+            .children = {},
+            .location = node->location
+        }
+    };
+    for (const auto& child : node->children)
+        result->children.push_back(inline_calls(child));
+
+    if (node->type != expr::node_t::type_t::FUNCTION_CALL)
+        return result;
+
+    const auto *function = find_inlined(node);
+    if (function == nullptr)
+        return result;
+
+    // Calls within the body are inlined before the parameters are replaced,
+    // so the arguments, which already are, are not visited again.
+    _expanding.push_back(function);
+    const auto body = inline_calls(function->body);
+    _expanding.pop_back();
+    return substitute(body, *function, result->children, node->location);
+}
+
+expr::node_ptr expr::inline_functions(
+    const expr::node_ptr& root,
+    const expr::function_table& functions,
+    std::size_t max_size
+) {
+    auto inliner = function_inliner_impl(functions, max_size);
+    return inliner.inline_calls(root);
+}
@@ -0,0 +1,486 @@
+#include "parallel.h"
+#include "array.h"
+#include "compiler.h"
+#include "interpreter.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "thread_pool.h"
+#include "tokenizer.h"
+
+#include <algorithm>        // std::max, std::min, std::stable_sort
+#include <atomic>           // std::atomic
+#include <numeric>          // std::iota
+#include <optional>         // std::optional
+#include <unordered_map>    // std::unordered_map
+
+static expr::evaluator_result evaluate_item(
+    const expr::expression_item& item,
+    const expr::function_table& functions,
+    expr::evaluation_context& context
+) {
+    auto tokens = expr::tokenize(item.expression);
+    if (!tokens)
+        return tokens.error();
+
+    const auto parsed = expr::parse(std::move(*tokens));
+    if (!parsed)
+        return parsed.error();
+
+    const auto optimized = expr::optimize(*parsed, functions);
+    if (!optimized)
+        return optimized.error();
+
+    const auto compiled = expr::compile(*optimized, functions);
+    if (!compiled)
+        return compiled.error();
+
+    // The context of the worker is reused for every expression it evaluates,
+    // only the variables the expression refers to are bound.
+    expr::prepare(context, *compiled);
+    expr::unbind_all(context);
+    for (std::size_t i = 0; i < compiled->variables.size(); ++i) {
+        const auto where = item.symbols.find(compiled->variables[i]);
+        if (where != item.symbols.end())
+            expr::bind(context, i, where->second);
+    }
+
+    return expr::evaluate(*compiled, context);
+}
+
+expr::expression_results expr::evaluate_all(
+    std::span<const expr::expression_item> items,
+    const expr::function_table& functions,
+    expr::thread_pool& pool,
+    const expr::parallel_settings& settings
+) {
+    auto results = expr::expression_results(
+        items.size(),
+        expr::error{
+            .code = expr::error_code::EVALUATOR_REACHED_UNREACHABLE_CODE_PATH,
+            .location = {},
+            .description = "The expression was not evaluated."
+        }
+    );
+
+    // The length of an expression is used as the estimate of its cost, and
+    // the most expensive expressions are evaluated first.
+    std::vector<std::size_t> order(items.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) {
+        return items[lhs].expression.length() > items[rhs].expression.length();
+    });
+
+    // One context for every worker, and one for the calling thread, which
+    // executes tasks while it waits for the rest. Workers don't get an arena
+    // of their own: tokens and nodes are shared pointers and vectors on the
+    // common heap, which an arena would have to replace throughout, so only
+    // the contexts, holding the buffers of the interpreter, are per worker.
+    std::vector<expr::evaluation_context> contexts(pool.size() + 1);
+    auto context_of_current_thread = [&]() -> expr::evaluation_context& {
+        const auto worker = pool.current_worker();
+        return contexts[worker == expr::thread_pool::no_worker ? pool.size()
+                                                               : worker];
+    };
+
+    // Tasks do not own a fixed chunk: whichever task starts first claims the
+    // most expensive chunk not yet claimed, so the order of the expressions
+    // is kept no matter how the tasks are scheduled or stolen.
+    const auto chunk_size = std::max<std::size_t>(1, settings.chunk_size);
+    const auto chunks = (order.size() + chunk_size - 1) / chunk_size;
+    std::atomic<std::size_t> next_chunk = 0;
+
+    auto group = expr::task_group(pool);
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+        group.run([&] {
+            auto& context = context_of_current_thread();
+            const auto begin = next_chunk.fetch_add(1) * chunk_size;
+            const auto end = std::min(order.size(), begin + chunk_size);
+            for (std::size_t i = begin; i < end; ++i) {
+                const auto index = order[i];
+                results[index] = evaluate_item(items[index], functions, context);
+            }
+        });
+    }
+    group.wait();
+
+    return results;
+}
+
+class parallel_evaluator_impl final {
+public:
+    parallel_evaluator_impl(
+        expr::symbol_table& symbols,
+        const expr::function_table& functions,
+        expr::thread_pool& pool,
+        std::size_t sequential_cutoff
+    );
+
+    expr::evaluator_result evaluate(const expr::node_ptr& root);
+
+private:
+    using operand_list = std::vector<const expr::node_ptr *>;
+    using operand_results = std::vector<std::optional<expr::evaluator_result>>;
+
+    struct subtree_t {
+        std::size_t size;
+        bool has_assignment;
+    };
+
+private:
+    subtree_t measure(const expr::node_t& node);
+    std::size_t size_of(const expr::node_ptr& node) const;
+    std::size_t weight_of(const expr::node_t& node) const;
+
+    operand_results evaluate_operands(
+        const expr::node_ptr& node,
+        const operand_list& operands,
+        bool short_circuit
+    );
+
+    expr::evaluator_result evaluate_node(const expr::node_ptr& node);
+    expr::evaluator_result evaluate_binary_operator(const expr::node_ptr& node);
+    expr::evaluator_result evaluate_unary_operator(const expr::node_ptr& node);
+    expr::evaluator_result evaluate_unit_application(const expr::node_ptr& node);
+    expr::evaluator_result evaluate_function_call(const expr::node_ptr& node);
+    expr::evaluator_result evaluate_assignment(const expr::node_ptr& node);
+    expr::evaluator_result evaluate_conditional(const expr::node_ptr& node);
+
+private:
+    bool is_large(const expr::node_ptr& node) const {
+        return _subtrees.contains(node.get());
+    }
+
+    bool has_assignment(const expr::node_ptr& node) const {
+        return _subtrees.at(node.get()).has_assignment;
+    }
+
+private:
+    expr::symbol_table& _symbols;
+    const expr::function_table& _functions;
+    expr::thread_pool& _pool;
+    const std::size_t _cutoff;
+
+    // Only subtrees at least as large as the cutoff are recorded, the rest
+    // are left to the sequential evaluator as a whole.
+    std::unordered_map<const expr::node_t *, subtree_t> _subtrees;
+};
+
+parallel_evaluator_impl::parallel_evaluator_impl(
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    expr::thread_pool& pool,
+    std::size_t sequential_cutoff
+) :
+    _symbols(symbols),
+    _functions(functions),
+    _pool(pool),
+    // Single nodes are never forked.
+    _cutoff(std::max<std::size_t>(2, sequential_cutoff))
+{}
+
+parallel_evaluator_impl::subtree_t parallel_evaluator_impl::measure(
+    const expr::node_t& node
+) {
+    // Calls to user functions bind their parameters in the symbol table, so
+    // they count as assignments. Series evaluate their bodies with a copy of
+    // it, so only assignments in their bounds count.
+    auto is_user_function_call = [this, &node] {
+        if (node.type != expr::node_t::type_t::FUNCTION_CALL)
+            return false;
+        const auto where = _functions.find(node.content);
+        return where != _functions.end() && where->second.user_function != nullptr;
+    };
+
+    auto subtree = subtree_t{
+        .size = weight_of(node),
+        .has_assignment = node.type == expr::node_t::type_t::ASSIGNMENT
+                       || is_user_function_call()
+    };
+
+    for (const auto& child : node.children) {
+        const auto measured = measure(*child);
+        subtree.size += measured.size;
+        subtree.has_assignment = subtree.has_assignment || measured.has_assignment;
+    }
+
+    if (subtree.size >= _cutoff)
+        _subtrees.emplace(&node, subtree);
+    return subtree;
+}
+
+std::size_t parallel_evaluator_impl::size_of(const expr::node_ptr& node) const {
+    if (auto where = _subtrees.find(node.get()); where != _subtrees.end())
+        return where->second.size;
+
+    std::size_t size = weight_of(*node);
+    for (const auto& child : node->children)
+        size += size_of(child);
+    return size;
+}
+
+// Sizes are counted in nodes, with calls weighing as much as their estimated
+// cost, so calls to expensive functions are forked sooner.
+std::size_t parallel_evaluator_impl::weight_of(const expr::node_t& node) const {
+    if (node.type != expr::node_t::type_t::FUNCTION_CALL)
+        return 1;
+    const auto where = _functions.find(node.content);
+    if (where == _functions.end())
+        return 1;
+    return std::max<std::size_t>(1, where->second.cost);
+}
+
+parallel_evaluator_impl::operand_results
+parallel_evaluator_impl::evaluate_operands(
+    const expr::node_ptr& node,
+    const operand_list& operands,
+    bool short_circuit
+) {
+    auto results = operand_results(operands.size());
+
+    // Assignments write the symbol table, so their subtrees are evaluated in
+    // order, just like the sequential evaluator would. When short-circuiting,
+    // the operands after the first failing one are not evaluated at all.
+    if (has_assignment(node)) {
+        for (std::size_t i = 0; i < operands.size(); ++i) {
+            results[i] = evaluate_node(*operands[i]);
+            if (short_circuit && !*results[i])
+                break;
+        }
+        return results;
+    }
+
+    // Otherwise consecutive operands are gathered into tasks of at least the
+    // cutoff size. The last task is executed by the current thread, while the
+    // forked ones run.
+    auto evaluate_range = [this, &operands, &results](
+        std::size_t begin,
+        std::size_t end
+    ) {
+        for (std::size_t i = begin; i < end; ++i)
+            results[i] = evaluate_node(*operands[i]);
+    };
+
+    auto group = expr::task_group(_pool);
+    std::size_t begin = 0;
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < operands.size(); ++i) {
+        size += size_of(*operands[i]);
+        if (size >= _cutoff && i + 1 < operands.size()) {
+            group.run([evaluate_range, begin, end = i + 1] {
+                evaluate_range(begin, end);
+            });
+            begin = i + 1;
+            size = 0;
+        }
+    }
+    evaluate_range(begin, operands.size());
+
+    group.wait();
+    return results;
+}
+
+expr::evaluator_result parallel_evaluator_impl::evaluate_binary_operator(
+    const expr::node_ptr& node
+) {
+    // Long chains of operators, like sums of many terms, are left-deep trees,
+    // where the right operand of every node is small. So instead of forking
+    // the two operands of a single node, the operands along the whole left
+    // spine are evaluated together, and then combined bottom-up in the same
+    // order as the sequential evaluator would.
+    std::vector<const expr::node_t *> spine;
+    const expr::node_ptr *bottom = &node;
+    while ((*bottom)->type == expr::node_t::type_t::BINARY_OP && is_large(*bottom)) {
+        spine.push_back(bottom->get());
+        bottom = &(*bottom)->children[0];
+    }
+
+    operand_list operands = {bottom};
+    for (auto it = spine.rbegin(); it != spine.rend(); ++it)
+        operands.push_back(&(*it)->children[1]);
+
+    auto results = evaluate_operands(node, operands, false);
+    auto accumulated = std::move(*results[0]);
+    for (std::size_t i = 1; i < results.size(); ++i) {
+        const auto& current = *spine[spine.size() - i];
+        accumulated = expr::apply_binary_operator(
+            current,
+            accumulated,
+            *results[i]
+        );
+    }
+    return accumulated;
+}
+
+expr::evaluator_result parallel_evaluator_impl::evaluate_unary_operator(
+    const expr::node_ptr& node
+) {
+    const auto operand = evaluate_node(node->children[0]);
+    if (!operand) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+            .location = node->location,
+            .description = "Failed to evaluate operand."
+        };
+    }
+
+    if (node->content == "-")
+        return expr::negate(*operand);
+    return expr::identity(*operand);
+}
+
+expr::evaluator_result parallel_evaluator_impl::evaluate_unit_application(
+    const expr::node_ptr& node
+) {
+    const auto subexpression = evaluate_node(node->children[0]);
+    if (!subexpression)
+        return subexpression.error();
+
+    const auto factor = expr::make_unit(node->children[1]->content);
+    if (!factor)
+        return factor.error();
+
+    return expr::multiply(*subexpression, *factor);
+}
+
+expr::evaluator_result parallel_evaluator_impl::evaluate_function_call(
+    const expr::node_ptr& node
+) {
+    auto where = _functions.find(node->content);
+    if (where == _functions.end()) {
+        // Reductions are evaluated by the tree evaluator, which evaluates
+        // their arguments as arrays, and so are series.
+        if (expr::is_reduction(node->content))
+            return expr::evaluate(node, _symbols, _functions);
+
+        const auto& location = node->location.begin;
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_UNDEFINED_FUNCTION,
+            .location = expr::location_t{
+                .begin = location,
+                .end = location + node->content.length() - 1
+            },
+            .description = {"Undefined function '{0}'.", node->content}
+        };
+    }
+
+    const auto& definition = where->second;
+    if (definition.user_function != nullptr)
+        return expr::evaluate(node, _symbols, _functions);
+
+    const auto count = node->children.size();
+    if (auto error = expr::validate_argument_count(definition, count, node->location))
+        return std::move(*error);
+
+    operand_list operands;
+    for (const auto& child : node->children)
+        operands.push_back(&child);
+
+    const auto results = evaluate_operands(node, operands, true);
+    std::vector<expr::quantity> arguments;
+    arguments.reserve(count);
+    for (const auto& result : results) {
+        if (!result || !*result) {
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+                .location = node->location,
+                .description = {
+                    "Failed to evaluate function arguments for '{0}()'.",
+                    node->content
+                }
+            };
+        }
+        arguments.push_back(**result);
+    }
+
+    return expr::invoke(definition, arguments, node->location);
+}
+
+expr::evaluator_result parallel_evaluator_impl::evaluate_assignment(
+    const expr::node_ptr& node
+) {
+    auto result = evaluate_node(node->children[1]);
+    if (!result) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+            .location = node->location,
+            .description = "Failed to evaluate function right-hand side for "
+                           "variable assignment."
+        };
+    }
+    _symbols[node->children[0]->content] = *result;
+    return result;
+}
+
+// Only one branch is evaluated, and only once the condition is known, so
+// there is nothing to fork, but each may fork within.
+expr::evaluator_result parallel_evaluator_impl::evaluate_conditional(
+    const expr::node_ptr& node
+) {
+    const auto failure = expr::error{
+        .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_OPERAND,
+        .location = node->location,
+        .description = "Failed to evaluate operand."
+    };
+
+    const auto condition = evaluate_node(node->children[0]);
+    if (!condition)
+        return failure;
+
+    auto result = evaluate_node(node->children[condition->value != 0 ? 1 : 2]);
+    if (!result)
+        return failure;
+    return result;
+}
+
+expr::evaluator_result parallel_evaluator_impl::evaluate_node(
+    const expr::node_ptr& node
+) {
+    if (!is_large(node))
+        return expr::evaluate(node, _symbols, _functions);
+
+    switch (node->type) {
+        case expr::node_t::type_t::BINARY_OP:
+            return evaluate_binary_operator(node);
+        case expr::node_t::type_t::UNARY_OP:
+            return evaluate_unary_operator(node);
+        case expr::node_t::type_t::FUNCTION_CALL:
+            return evaluate_function_call(node);
+        case expr::node_t::type_t::ASSIGNMENT:
+            return evaluate_assignment(node);
+        case expr::node_t::type_t::UNIT_APPLICATION:
+            return evaluate_unit_application(node);
+        case expr::node_t::type_t::CONDITIONAL:
+            return evaluate_conditional(node);
+        case expr::node_t::type_t::NUMBER:
+        case expr::node_t::type_t::VARIABLE:
+        case expr::node_t::type_t::UNIT:
+        case expr::node_t::type_t::FUNCTION_DEFINITION:
+        case expr::node_t::type_t::ARRAY:
+            break;
+    }
+
+    return expr::evaluate(node, _symbols, _functions);
+}
+
+expr::evaluator_result parallel_evaluator_impl::evaluate(
+    const expr::node_ptr& root
+) {
+    measure(*root);
+    return evaluate_node(root);
+}
+
+expr::evaluator_result expr::evaluate_parallel(
+    const expr::node_ptr& root,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions,
+    expr::thread_pool& pool,
+    std::size_t sequential_cutoff
+) {
+    auto evaluator = parallel_evaluator_impl(
+        symbols,
+        functions,
+        pool,
+        sequential_cutoff
+    );
+    return evaluator.evaluate(root);
+}
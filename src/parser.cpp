@@ -1,5 +1,6 @@
 #include "parser.h"
 
+#include <string>           // std::string
 #include <unordered_set>    // std::unordered_set
 
 class expression_parser_impl final {
@@ -10,12 +11,16 @@ public:
 
 private:
     expr::parser_result parse_function_call();
+    expr::parser_result parse_array();
     expr::parser_result parse_primary();
     expr::parser_result parse_unit();
     expr::parser_result parse_unary();
     expr::parser_result parse_power();
     expr::parser_result parse_factor();
     expr::parser_result parse_term();
+    expr::parser_result parse_comparison();
+    expr::parser_result parse_conditional();
+    expr::parser_result parse_function_definition(expr::node_ptr&& call);
     expr::parser_result parse_assignment();
 
 private:
@@ -26,6 +31,10 @@ private:
         return *(_position - 1);
     }
 
+    bool is_at(token_type_t type) const {
+        return _position != _tokens.end() && _position->type == type;
+    }
+
     bool match(const std::unordered_set<token_type_t>& types) {
         if (_position == _tokens.end()) {
             return false;
@@ -60,14 +69,21 @@ expr::parser_result expression_parser_impl::parse_function_call() {
         ++_position;
 
     while (true) {
-        auto parameter = parse_term();
+        auto parameter = parse_comparison();
         if (!parameter)
             return parameter;
         parameters.push_back(std::move(*parameter));
 
-        const auto& type = _position->type;
-        const bool is_comma = type == token_type_t::COMMA;
-        const bool is_closing = type == token_type_t::CLOSING_PARENTHESIS;
+        if (_position == _tokens.end()) {
+            return expr::error {
+                .code = expr::error_code::PARSER_UNCLOSED_PARENTHESES,
+                .location = expr::location_t{begin, begin},
+                .description = "Unclosed parenthesis."
+            };
+        }
+
+        const bool is_comma = is_at(token_type_t::COMMA);
+        const bool is_closing = is_at(token_type_t::CLOSING_PARENTHESIS);
 
         if (is_closing)
             end = _position->location.end;
@@ -93,6 +109,43 @@ expr::parser_result expression_parser_impl::parse_function_call() {
     );
 }
 
+expr::parser_result expression_parser_impl::parse_array() {
+    const auto begin = previous().location.begin;
+    std::vector<expr::node_ptr> elements;
+
+    if (!is_at(token_type_t::CLOSING_BRACKET)) {
+        do {
+            auto element = parse_comparison();
+            if (!element)
+                return element;
+            elements.push_back(std::move(*element));
+        } while (match({token_type_t::COMMA}));
+    }
+
+    if (_position == _tokens.end()) {
+        return expr::error {
+            .code = expr::error_code::PARSER_UNCLOSED_PARENTHESES,
+            .location = expr::location_t{begin, begin},
+            .description = "Unclosed bracket."
+        };
+    }
+
+    if (!is_at(token_type_t::CLOSING_BRACKET)) {
+        return expr::error{
+            .code = expr::error_code::PARSER_UNEXPECTED_TOKEN,
+            .location = _position->location,
+            .description = "Unexpected token."
+        };
+    }
+
+    const auto end = _position->location.end;
+    ++_position;
+    return expr::make_array_node(
+        std::move(elements),
+        expr::location_t{begin, end}
+    );
+}
+
 expr::parser_result expression_parser_impl::parse_primary() {
     if (match({token_type_t::NUMBER})) {
         return expr::make_number_literal_node(
@@ -102,8 +155,11 @@ expr::parser_result expression_parser_impl::parse_primary() {
     }
 
     if (match({token_type_t::IDENTIFIER})) {
-        if (_position->type == token_type_t::OPENING_PARENTHESIS)
+        if (is_at(token_type_t::OPENING_PARENTHESIS)) {
+            if (previous().content == "if")
+                return parse_conditional();
             return parse_function_call();
+        }
 
         return expr::make_variable_node(
             previous().content,
@@ -111,14 +167,17 @@ expr::parser_result expression_parser_impl::parse_primary() {
         );
     }
 
+    if (match({token_type_t::OPENING_BRACKET}))
+        return parse_array();
+
     if (match({token_type_t::OPENING_PARENTHESIS})) {
         const auto begin = previous().location.begin;
 
-        auto subexpression = parse_term();
+        auto subexpression = parse_comparison();
         if (!subexpression)
             return subexpression;
 
-        if (_position->type == token_type_t::CLOSING_PARENTHESIS) {
+        if (is_at(token_type_t::CLOSING_PARENTHESIS)) {
             if (_position != _tokens.end())
                 ++_position;
             return std::move(*subexpression);
@@ -131,10 +190,19 @@ expr::parser_result expression_parser_impl::parse_primary() {
         }
     }
 
+    if (_position == _tokens.end()) {
+        const auto end = _tokens.empty() ? 0 : _tokens.back().location.end;
+        return expr::error {
+            .code = expr::error_code::PARSER_UNEXPECTED_TOKEN,
+            .location = expr::location_t{end, end},
+            .description = "Unexpected end of expression."
+        };
+    }
+
     return expr::error {
         .code = expr::error_code::PARSER_UNEXPECTED_TOKEN,
         .location = _position->location,
-        .description = "Unexpected token '" + _position->content + "'."
+        .description = {"Unexpected token '{0}'.", _position->content}
     };
 }
 
@@ -260,25 +328,120 @@ expr::parser_result expression_parser_impl::parse_term() {
     return expression;
 }
 
-expr::parser_result expression_parser_impl::parse_assignment() {
+// Comparisons bind weaker than arithmetic, so `a + 1 < b * 2` compares the
+// sums.
+expr::parser_result expression_parser_impl::parse_comparison() {
+    static const std::unordered_set<token_type_t> tokens = {
+        token_type_t::LESS_THAN,
+        token_type_t::LESS_THAN_OR_EQUAL,
+        token_type_t::GREATER_THAN,
+        token_type_t::GREATER_THAN_OR_EQUAL,
+        token_type_t::DOUBLE_EQUAL_SIGN,
+        token_type_t::NOT_EQUAL_SIGN
+    };
+
     auto lhs = parse_term();
     if (!lhs)
         return lhs;
 
+    expr::node_ptr expression = std::move(*lhs);
+    while (match(tokens)) {
+        const auto begin = expression->location.begin;
+        auto content = previous().content;
+
+        auto rhs = parse_term();
+        if (!rhs)
+            return rhs;
+
+        expression = expr::make_binary_operator_node(
+            content,
+            std::move(expression),
+            std::move(*rhs),
+            expr::location_t{begin, previous().location.end}
+        );
+    }
+
+    return expression;
+}
+
+// A conditional is written like a call of `if()`, but only one of its branches
+// is evaluated, so it is a node of its own.
+expr::parser_result expression_parser_impl::parse_conditional() {
+    auto call = parse_function_call();
+    if (!call)
+        return call;
+
+    auto& arguments = (*call)->children;
+    if (arguments.size() != 3) {
+        return expr::error{
+            .code = expr::error_code::PARSER_INVALID_CONDITIONAL,
+            .location = (*call)->location,
+            .description = "A conditional needs a condition and two branches."
+        };
+    }
+
+    return expr::make_conditional_node(
+        std::move(arguments[0]),
+        std::move(arguments[1]),
+        std::move(arguments[2]),
+        (*call)->location
+    );
+}
+
+// The left-hand side was parsed as a call, whose arguments are the names of
+// the parameters.
+expr::parser_result expression_parser_impl::parse_function_definition(
+    expr::node_ptr&& call
+) {
+    std::unordered_set<std::string> names;
+    for (const auto& parameter : call->children) {
+        const bool is_variable = parameter->type == expr::node_t::type_t::VARIABLE;
+        if (!is_variable || !names.insert(parameter->content).second) {
+            return expr::error{
+                .code = expr::error_code::PARSER_INVALID_FUNCTION_DEFINITION,
+                .location = parameter->location,
+                .description = "Parameters of a function definition have to be "
+                               "distinct variables."
+            };
+        }
+    }
+
+    auto body = parse_comparison();
+    if (!body)
+        return body;
+
+    const auto begin = call->location.begin;
+    return expr::make_function_definition_node(
+        std::move(call->content),
+        std::move(call->children),
+        std::move(*body),
+        expr::location_t{begin, previous().location.end}
+    );
+}
+
+expr::parser_result expression_parser_impl::parse_assignment() {
+    auto lhs = parse_comparison();
+    if (!lhs)
+        return lhs;
+
     expr::node_ptr expression = std::move(*lhs);
     while (match({token_type_t::EQUAL_SIGN})) {
         const auto begin = expression->location.begin;
         auto content = previous().content;
 
+        if (expression->type == expr::node_t::type_t::FUNCTION_CALL)
+            return parse_function_definition(std::move(expression));
+
         if (expression->type != expr::node_t::type_t::VARIABLE) {
             return expr::error {
                 .code = expr::error_code::PARSER_NON_VARIABLE_ASSIGNMENT,
-                .location = _position->location,
+                .location = (_position == _tokens.end()) ? previous().location
+                                                         : _position->location,
                 .description = "Only variables can be assigned."
             };
         }
 
-        auto rhs = parse_term();
+        auto rhs = parse_comparison();
         if (!rhs)
             return rhs;
 
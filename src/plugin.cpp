@@ -0,0 +1,195 @@
+#include "plugin.h"
+
+#include <algorithm>        // std::any_of, std::max
+#include <array>            // std::array
+#include <cstdint>          // std::uint32_t
+#include <cstring>          // std::strcmp
+#include <utility>          // std::pair
+#include <vector>           // std::vector
+
+#if !defined(_WIN32)
+#include <dlfcn.h>          // dlopen, dlsym, dlerror
+#endif
+
+static std::optional<expr::parameter_t> make_parameter(const char *type) {
+    static const std::array<expr::parameter_t, 10> parameters = {
+        expr::parameter_t{"scalar", &expr::measurement_unit::is_scalar},
+        expr::parameter_t{"length", &expr::measurement_unit::is_length},
+        expr::parameter_t{"area", &expr::measurement_unit::is_area},
+        expr::parameter_t{"volume", &expr::measurement_unit::is_volume},
+        expr::parameter_t{"angle", &expr::measurement_unit::is_angle},
+        expr::parameter_t{"mass", &expr::measurement_unit::is_mass},
+        expr::parameter_t{"time", &expr::measurement_unit::is_time},
+        expr::parameter_t{"temperature", &expr::measurement_unit::is_temperature},
+        expr::parameter_t{"currency", &expr::measurement_unit::is_currency},
+        expr::parameter_t{"any", nullptr},
+    };
+
+    if (type == nullptr)
+        return std::nullopt;
+
+    for (const auto& parameter : parameters) {
+        if (std::strcmp(parameter.type, type) == 0)
+            return parameter;
+    }
+    return std::nullopt;
+}
+
+static expr::error invalid_function(
+    const std::string& path,
+    std::size_t index,
+    const char *reason
+) {
+    return expr::error{
+        .code = expr::error_code::PLUGIN_INVALID_FUNCTION,
+        .location = {},
+        .description = {"Function #{0} of plugin '{1}' {2}.", index, path, reason}
+    };
+}
+
+static expr::result<expr::function_definition_t, expr::error> make_definition(
+    const exprparser_plugin_function& function,
+    const std::string& path,
+    std::size_t index
+) {
+    if (function.name == nullptr || *function.name == '\0')
+        return invalid_function(path, index, "has no name");
+    if (function.scalar == nullptr)
+        return invalid_function(path, index, "has no scalar implementation");
+    if (function.arity > expr::max_builtin_arity)
+        return invalid_function(path, index, "has too many parameters");
+
+    auto parameters = std::vector<expr::parameter_t>{};
+    for (std::uint32_t i = 0; i < function.arity; ++i) {
+        const auto *type = function.parameter_types != nullptr
+                         ? function.parameter_types[i]
+                         : "scalar";
+        auto parameter = make_parameter(type);
+        if (!parameter)
+            return invalid_function(path, index, "has a parameter of unknown type");
+        parameters.push_back(*parameter);
+    }
+
+    auto signature = std::string{};
+    if (function.signature != nullptr) {
+        signature = function.signature;
+    } else {
+        signature = std::string(function.name) + "(";
+        for (std::size_t i = 0; i < parameters.size(); ++i) {
+            signature += (i == 0 ? "x" : ", x") + std::to_string(i) + ": ";
+            signature += parameters[i].type;
+        }
+        signature += ") -> scalar";
+    }
+
+    return expr::function_definition_t{
+        .implementation = nullptr,
+        .signature = std::move(signature),
+        .batch_implementation = function.batch,
+        .native_function = function.scalar,
+        .parameters = std::move(parameters),
+        .is_pure = function.is_pure != 0,
+        .cost = std::max<std::size_t>(1, function.cost),
+    };
+}
+
+#if defined(_WIN32)
+
+static expr::result<exprparser_plugin_entry_t, expr::error> open_plugin(
+    const std::string& path
+) {
+    return expr::error{
+        .code = expr::error_code::PLUGIN_FAILED_TO_LOAD,
+        .location = {},
+        .description = {"Plugin '{0}' can't be loaded on this platform.", path}
+    };
+}
+
+#else
+
+static expr::result<exprparser_plugin_entry_t, expr::error> open_plugin(
+    const std::string& path
+) {
+    // The handle is never closed, the function table refers to the code of
+    // the plugin.
+    auto *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        return expr::error{
+            .code = expr::error_code::PLUGIN_FAILED_TO_LOAD,
+            .location = {},
+            .description = {"Failed to load plugin: {0}", dlerror()}
+        };
+    }
+
+    auto *entry = dlsym(handle, EXPRPARSER_PLUGIN_ENTRY_POINT);
+    if (entry == nullptr) {
+        dlclose(handle);
+        return expr::error{
+            .code = expr::error_code::PLUGIN_MISSING_ENTRY_POINT,
+            .location = {},
+            .description = {
+                "Plugin '{0}' does not export '{1}()'.",
+                path,
+                EXPRPARSER_PLUGIN_ENTRY_POINT
+            }
+        };
+    }
+
+    return reinterpret_cast<exprparser_plugin_entry_t>(entry);
+}
+
+#endif
+
+std::optional<expr::error> expr::load_plugin(
+    expr::function_table& functions,
+    const std::string& path
+) {
+    const auto entry = open_plugin(path);
+    if (!entry)
+        return entry.error();
+
+    const auto *plugin = (*entry)(EXPRPARSER_PLUGIN_ABI_VERSION);
+    if (plugin == nullptr || plugin->abi_version != EXPRPARSER_PLUGIN_ABI_VERSION) {
+        return expr::error{
+            .code = expr::error_code::PLUGIN_INCOMPATIBLE_VERSION,
+            .location = {},
+            .description = {
+                "Plugin '{0}' is not built for version {1} of the plugin "
+                "interface.",
+                path,
+                EXPRPARSER_PLUGIN_ABI_VERSION
+            }
+        };
+    }
+
+    // Every function is checked before any of them is added.
+    auto definitions = std::vector<std::pair<std::string, expr::function_definition_t>>{};
+    for (std::uint32_t i = 0; i < plugin->function_count; ++i) {
+        const auto& function = plugin->functions[i];
+        auto definition = make_definition(function, path, i);
+        if (!definition)
+            return definition.error();
+
+        const auto is_defined = functions.contains(function.name)
+            || std::any_of(definitions.begin(), definitions.end(), [&](const auto& added) {
+                return added.first == function.name;
+            });
+        if (is_defined) {
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_BUILTIN_REDEFINITION,
+                .location = {},
+                .description = {
+                    "Function '{0}()' of plugin '{1}' is already defined.",
+                    function.name,
+                    path
+                }
+            };
+        }
+
+        definitions.emplace_back(function.name, std::move(*definition));
+    }
+
+    for (auto& [name, definition] : definitions)
+        functions.insert_or_assign(name, std::move(definition));
+    return std::nullopt;
+}
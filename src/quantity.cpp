@@ -4,14 +4,14 @@
 #include <cfloat>
 #include <cmath>
 #include <iostream>
+#include <numbers>          // std::numbers::pi_v
 
-using unit_result = expr::result<expr::measurement_unit, expr::error>;
-
-static bool is_integer(double number) {
+template <typename T>
+static bool is_integer(T number) {
     return number - std::floor(number) < DBL_EPSILON;
 }
 
-static unit_result add_or_subtract_unit(
+static expr::unit_result add_or_subtract_unit(
     expr::measurement_unit lhs,
     expr::measurement_unit rhs
 ) {
@@ -25,29 +25,57 @@ static unit_result add_or_subtract_unit(
     return lhs;
 }
 
-static unit_result multiply_unit(
+// Only quantities of the same unit can be compared, giving a scalar.
+static expr::unit_result compare_unit(
     expr::measurement_unit lhs,
     expr::measurement_unit rhs
 ) {
-    return expr::measurement_unit{
-        .length_dimension = lhs.length_dimension + rhs.length_dimension,
-        .angle_dimension = lhs.angle_dimension + rhs.angle_dimension,
+    if (lhs != rhs) {
+        return expr::error{
+            .code = expr::error_code::QUANTITY_EXPECTED_SAME_UNIT,
+            .location = {},
+            .description = "Expected operands with identical units."
+        };
+    }
+    return expr::measurement_unit{0, 0};
+}
+
+static expr::error make_unit_out_of_range_error() {
+    return expr::error{
+        .code = expr::error_code::QUANTITY_UNIT_OUT_OF_RANGE,
+        .location = {},
+        .description = "Exponents of units have to be within [-128, 127]."
     };
 }
 
-static unit_result divide_unit(
+expr::unit_result expr::multiply_unit(
     expr::measurement_unit lhs,
     expr::measurement_unit rhs
 ) {
-    return expr::measurement_unit{
-        .length_dimension = lhs.length_dimension - rhs.length_dimension,
-        .angle_dimension = lhs.angle_dimension - rhs.angle_dimension,
-    };
+    if (const auto unit = lhs.multiply(rhs))
+        return *unit;
+    return make_unit_out_of_range_error();
 }
 
-static unit_result exponentiate_unit(
+expr::unit_result expr::divide_unit(
     expr::measurement_unit lhs,
-    expr::quantity rhs
+    expr::measurement_unit rhs
+) {
+    if (const auto unit = lhs.divide(rhs))
+        return *unit;
+    return make_unit_out_of_range_error();
+}
+
+expr::unit_result expr::power_unit(expr::measurement_unit base, double exponent) {
+    if (const auto unit = base.power(exponent))
+        return *unit;
+    return make_unit_out_of_range_error();
+}
+
+template <typename T>
+static expr::unit_result exponentiate_unit(
+    expr::measurement_unit lhs,
+    expr::basic_quantity<T> rhs
 ) {
     if (!is_integer(rhs.value) || !rhs.is_scalar()) {
         return expr::error{
@@ -57,71 +85,156 @@ static unit_result exponentiate_unit(
         };
     }
 
-    return expr::measurement_unit{
-        .length_dimension = lhs.length_dimension * int(rhs.value),
-        .angle_dimension = lhs.angle_dimension * int(rhs.value),
-    };
+    return expr::power_unit(lhs, double(rhs.value));
 }
 
 bool expr::measurement_unit::is_scalar() const {
-    return length_dimension == 0 && angle_dimension == 0;
+    return *this == measurement_unit{0, 0};
 }
 
 bool expr::measurement_unit::is_length() const {
-    return length_dimension == 1 && angle_dimension == 0;
+    return *this == measurement_unit{1, 0};
 }
 
 bool expr::measurement_unit::is_area() const {
-    return length_dimension == 2 && angle_dimension == 0;
+    return *this == measurement_unit{2, 0};
 }
 
 bool expr::measurement_unit::is_volume() const {
-    return length_dimension == 3 && angle_dimension == 0;
+    return *this == measurement_unit{3, 0};
 }
 
 bool expr::measurement_unit::is_angle() const {
-    return length_dimension == 0 && angle_dimension == 1;
+    return *this == measurement_unit{0, 1};
+}
+
+bool expr::measurement_unit::is_mass() const {
+    return *this == measurement_unit::of(dimension_t::MASS, 1);
+}
+
+bool expr::measurement_unit::is_time() const {
+    return *this == measurement_unit::of(dimension_t::TIME, 1);
+}
+
+bool expr::measurement_unit::is_temperature() const {
+    return *this == measurement_unit::of(dimension_t::TEMPERATURE, 1);
 }
 
+bool expr::measurement_unit::is_currency() const {
+    return *this == measurement_unit::of(dimension_t::CURRENCY, 1);
+}
+
+// Positive powers of length and angle, and nothing else.
 bool expr::measurement_unit::is_mixed() const {
-    return length_dimension > 0 && angle_dimension > 0;
+    const auto others = divide(measurement_unit{length_dimension(), angle_dimension()});
+    return length_dimension() > 0 && angle_dimension() > 0 && others->is_scalar();
+}
+
+template <typename T>
+static expr::basic_quantity<T> make_base_unit(expr::dimension_t dimension, T factor) {
+    return expr::basic_quantity<T>{expr::measurement_unit::of(dimension, 1), factor};
+}
+
+// Currencies have no symbol, as none of them is the base of the others, so
+// only host code gives values that dimension.
+template <typename T>
+expr::basic_arithmetic_result<T> expr::make_unit(std::string_view symbol) {
+    if (symbol == "mm")
+        return expr::make_length<T>(T(0.001));
+
+    if (symbol == "cm")
+        return expr::make_length<T>(T(0.01));
+
+    if (symbol == "m")
+        return expr::make_length<T>(1);
+
+    if (symbol == "km")
+        return expr::make_length<T>(1000);
+
+    if (symbol == "deg")
+        return expr::make_angle<T>(std::numbers::pi_v<T> / 180);
+
+    if (symbol == "rad")
+        return expr::make_angle<T>(1);
+
+    if (symbol == "g")
+        return make_base_unit<T>(expr::dimension_t::MASS, T(0.001));
+
+    if (symbol == "kg")
+        return make_base_unit<T>(expr::dimension_t::MASS, 1);
+
+    if (symbol == "ms")
+        return make_base_unit<T>(expr::dimension_t::TIME, T(0.001));
+
+    if (symbol == "s")
+        return make_base_unit<T>(expr::dimension_t::TIME, 1);
+
+    if (symbol == "h")
+        return make_base_unit<T>(expr::dimension_t::TIME, 3600);
+
+    if (symbol == "K")
+        return make_base_unit<T>(expr::dimension_t::TEMPERATURE, 1);
+
+    return expr::error{
+        .code = expr::error_code::QUANTITY_UNKNOWN_UNIT,
+        .location = {},
+        .description = {"Unknown unit '{0}'.", symbol}
+    };
 }
 
-expr::arithmetic_result expr::identity(expr::quantity operand) {
+template <typename T>
+expr::basic_arithmetic_result<T> expr::identity(expr::basic_quantity<T> operand) {
     return operand;
 }
 
-expr::arithmetic_result expr::negate(expr::quantity operand) {
+template <typename T>
+expr::basic_arithmetic_result<T> expr::negate(expr::basic_quantity<T> operand) {
     operand.value *= -1;
     return operand;
 }
 
-expr::arithmetic_result expr::add(expr::quantity lhs, expr::quantity rhs) {
+template <typename T>
+expr::basic_arithmetic_result<T> expr::add(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
     if (auto unit = add_or_subtract_unit(lhs.unit, rhs.unit)) {
-        return expr::quantity{.unit = *unit, .value = lhs.value + rhs.value};
+        return expr::basic_quantity<T>{.unit = *unit, .value = lhs.value + rhs.value};
     } else {
         return unit.error();
     }
 }
 
-expr::arithmetic_result expr::subtract(expr::quantity lhs, expr::quantity rhs) {
+template <typename T>
+expr::basic_arithmetic_result<T> expr::subtract(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
     if (auto unit = add_or_subtract_unit(lhs.unit, rhs.unit)) {
-        return expr::quantity{.unit = *unit, .value = lhs.value - rhs.value};
+        return expr::basic_quantity<T>{.unit = *unit, .value = lhs.value - rhs.value};
     } else {
         return unit.error();
     }
 }
 
-expr::arithmetic_result expr::multiply(expr::quantity lhs, expr::quantity rhs) {
-    if (auto unit = multiply_unit(lhs.unit, rhs.unit)) {
-        return expr::quantity{.unit = *unit, .value = lhs.value * rhs.value};
+template <typename T>
+expr::basic_arithmetic_result<T> expr::multiply(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
+    if (auto unit = expr::multiply_unit(lhs.unit, rhs.unit)) {
+        return expr::basic_quantity<T>{.unit = *unit, .value = lhs.value * rhs.value};
     } else {
         return unit.error();
     }
 }
 
-expr::arithmetic_result expr::divide(expr::quantity lhs, expr::quantity rhs) {
-    if (auto unit = divide_unit(lhs.unit, rhs.unit)) {
+template <typename T>
+expr::basic_arithmetic_result<T> expr::divide(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
+    if (auto unit = expr::divide_unit(lhs.unit, rhs.unit)) {
         if (expr::is_near(rhs.value, 0)) {
              return expr::error{
                 .code = expr::error_code::QUANTITY_DIVISION_BY_ZERO,
@@ -129,15 +242,19 @@ expr::arithmetic_result expr::divide(expr::quantity lhs, expr::quantity rhs) {
                 .description = "Division by zero."
             };
         }
-        return expr::quantity{.unit = *unit, .value = lhs.value / rhs.value};
+        return expr::basic_quantity<T>{.unit = *unit, .value = lhs.value / rhs.value};
     } else {
         return unit.error();
     }
 }
 
-expr::arithmetic_result expr::modulo(expr::quantity lhs, expr::quantity rhs) {
+template <typename T>
+expr::basic_arithmetic_result<T> expr::modulo(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
     if (lhs.unit == rhs.unit) {
-        return expr::quantity{
+        return expr::basic_quantity<T>{
             .unit = lhs.unit,
             .value = std::fmod(lhs.value, rhs.value)
         };
@@ -151,31 +268,205 @@ expr::arithmetic_result expr::modulo(expr::quantity lhs, expr::quantity rhs) {
     }
 }
 
-expr::arithmetic_result expr::power(expr::quantity lhs, expr::quantity rhs) {
+template <typename T>
+expr::basic_arithmetic_result<T> expr::power(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
     if (auto unit = exponentiate_unit(lhs.unit, rhs)) {
-        return expr::quantity{
+        return expr::basic_quantity<T>{
             .unit = *unit,
-            .value = std::pow(lhs.value, rhs.value)
+            .value = expr::raise(lhs.value, rhs.value)
         };
     } else {
         return unit.error();
     }
 }
 
-std::ostream& operator<<(std::ostream& stream, const expr::quantity& quantity) {
-    stream << quantity.value;
+template <typename T>
+expr::basic_arithmetic_result<T> expr::less(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
+    if (auto unit = compare_unit(lhs.unit, rhs.unit))
+        return expr::make_scalar<T>(lhs.value < rhs.value ? 1 : 0);
+    else
+        return unit.error();
+}
+
+template <typename T>
+expr::basic_arithmetic_result<T> expr::less_equal(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
+    if (auto unit = compare_unit(lhs.unit, rhs.unit))
+        return expr::make_scalar<T>(lhs.value <= rhs.value ? 1 : 0);
+    else
+        return unit.error();
+}
+
+template <typename T>
+expr::basic_arithmetic_result<T> expr::greater(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
+    if (auto unit = compare_unit(lhs.unit, rhs.unit))
+        return expr::make_scalar<T>(lhs.value > rhs.value ? 1 : 0);
+    else
+        return unit.error();
+}
+
+template <typename T>
+expr::basic_arithmetic_result<T> expr::greater_equal(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
+    if (auto unit = compare_unit(lhs.unit, rhs.unit))
+        return expr::make_scalar<T>(lhs.value >= rhs.value ? 1 : 0);
+    else
+        return unit.error();
+}
 
-    if (quantity.unit.length_dimension > 0) {
-        stream << " m";
-        if (quantity.unit.length_dimension > 1)
-            stream << '^' << quantity.unit.length_dimension;
+template <typename T>
+expr::basic_arithmetic_result<T> expr::equal(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
+    if (auto unit = compare_unit(lhs.unit, rhs.unit))
+        return expr::make_scalar<T>(lhs.value == rhs.value ? 1 : 0);
+    else
+        return unit.error();
+}
+
+template <typename T>
+expr::basic_arithmetic_result<T> expr::not_equal(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
+    if (auto unit = compare_unit(lhs.unit, rhs.unit))
+        return expr::make_scalar<T>(lhs.value != rhs.value ? 1 : 0);
+    else
+        return unit.error();
+}
+
+template <typename T>
+expr::basic_arithmetic_result<T> expr::ieee_divide(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
+    if (auto unit = expr::divide_unit(lhs.unit, rhs.unit)) {
+        return expr::basic_quantity<T>{.unit = *unit, .value = lhs.value / rhs.value};
+    } else {
+        return unit.error();
     }
+}
+
+template <typename T>
+expr::basic_arithmetic_result<T> expr::ieee_power(
+    expr::basic_quantity<T> lhs,
+    expr::basic_quantity<T> rhs
+) {
+    if (lhs.is_scalar() && rhs.is_scalar())
+        return expr::make_scalar<T>(expr::raise(lhs.value, rhs.value));
+    return expr::power(lhs, rhs);
+}
+
+// The symbols of the base units, by dimension. Currency has the generic
+// currency sign, and the two unnamed dimensions their index.
+static constexpr const char* base_units[expr::max_dimensions] = {
+    "m", "rad", "kg", "s", "K", "\u00a4", "d6", "d7"
+};
 
-    if (quantity.unit.angle_dimension > 0) {
-        stream << " rad";
-        if (quantity.unit.angle_dimension > 1)
-            stream << '^' << quantity.unit.angle_dimension;
+template <typename T>
+std::ostream& operator<<(std::ostream& stream, const expr::basic_quantity<T>& quantity) {
+    stream << quantity.value;
+
+    for (unsigned i = 0; i < expr::max_dimensions; ++i) {
+        const auto exponent = quantity.unit.exponent(expr::dimension_t(i));
+        if (exponent == 0)
+            continue;
+
+        stream << ' ' << base_units[i];
+        if (exponent != 1)
+            stream << '^' << exponent;
     }
 
     return stream;
 }
+
+#define EXPR_INSTANTIATE_QUANTITY(T)                                           \
+    template expr::basic_arithmetic_result<T> expr::make_unit<T>(              \
+        std::string_view                                                       \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::identity(                  \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::negate(                    \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::add(                       \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::subtract(                  \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::multiply(                  \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::divide(                    \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::modulo(                    \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::power(                     \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::less(                      \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::less_equal(                \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::greater(                   \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::greater_equal(             \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::equal(                     \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::not_equal(                 \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::ieee_divide(               \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template expr::basic_arithmetic_result<T> expr::ieee_power(                \
+        expr::basic_quantity<T>,                                               \
+        expr::basic_quantity<T>                                                \
+    );                                                                         \
+    template std::ostream& operator<<(                                         \
+        std::ostream&,                                                         \
+        const expr::basic_quantity<T>&                                         \
+    )
+
+EXPR_INSTANTIATE_QUANTITY(float);
+EXPR_INSTANTIATE_QUANTITY(double);
+EXPR_INSTANTIATE_QUANTITY(long double);
+
+#undef EXPR_INSTANTIATE_QUANTITY
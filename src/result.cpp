@@ -0,0 +1,87 @@
+#include "result.h"
+
+#include <algorithm>        // std::copy_n
+#include <iostream>         // std::ostream
+#include <memory>           // std::make_shared_for_overwrite
+#include <utility>          // std::move
+
+expr::description_t::argument_t::argument_t(std::string_view text) noexcept :
+    _text(text),
+    _is_text(true)
+{}
+
+expr::description_t::argument_t::argument_t(std::size_t number) noexcept :
+    _number(number),
+    _is_text(false)
+{}
+
+void expr::description_t::store(
+    const argument_t *arguments,
+    std::size_t count
+) {
+    std::size_t length = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (arguments[i]._is_text)
+            length += arguments[i]._text.length();
+    }
+
+    char *texts = _texts;
+    if (length > max_text_length) {
+        auto long_texts = std::make_shared_for_overwrite<char[]>(length);
+        texts = long_texts.get();
+        _long_texts = std::move(long_texts);
+    }
+
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto& argument = arguments[i];
+        auto& slot = _arguments[i];
+        if (!argument._is_text) {
+            slot.number = argument._number;
+            continue;
+        }
+
+        const auto& text = argument._text;
+        std::copy_n(text.data(), text.length(), texts + offset);
+        slot.text.offset = std::uint32_t(offset);
+        slot.text.length = std::uint32_t(text.length());
+        offset += text.length();
+        _text_arguments |= std::uint8_t(1u << i);
+    }
+    _argument_count = std::uint8_t(count);
+}
+
+std::string expr::description_t::str() const {
+    if (_argument_count == 0)
+        return _format;
+
+    auto formatted = std::string{};
+    for (const char *c = _format; *c != '\0'; ++c) {
+        const bool is_placeholder = c[0] == '{' &&
+                                    c[1] >= '0' &&
+                                    std::size_t(c[1] - '0') < _argument_count &&
+                                    c[2] == '}';
+        if (!is_placeholder) {
+            formatted += *c;
+            continue;
+        }
+
+        const auto index = std::size_t(c[1] - '0');
+        if (_text_arguments & (1u << index)) {
+            const auto& text = _arguments[index].text;
+            const char *texts = _long_texts ? _long_texts.get() : _texts;
+            formatted.append(texts + text.offset, text.length);
+        } else {
+            formatted += std::to_string(_arguments[index].number);
+        }
+        c += 2;
+    }
+    return formatted;
+}
+
+std::ostream& operator<<(
+    std::ostream& stream,
+    const expr::description_t& description
+) {
+    return stream << description.str();
+}
@@ -0,0 +1,450 @@
+#include "series.h"
+#include "compiler.h"
+#include "context.h"
+#include "interpreter.h"
+#include "optimizer.h"
+#include "thread_pool.h"
+#include "utility.h"
+
+#include <algorithm>        // std::all_of, std::find, std::min
+#include <array>            // std::array
+#include <atomic>           // std::atomic
+#include <cstdint>          // std::int64_t, SIZE_MAX
+#include <optional>         // std::optional
+#include <string>           // std::string, std::to_string
+#include <vector>           // std::vector
+
+bool expr::is_series(const expr::node_t& node) {
+    return node.type == expr::node_t::type_t::FUNCTION_CALL
+        && (node.content == "sum" || node.content == "prod")
+        && node.children.size() == 4;
+}
+
+expr::error expr::make_unsupported_series_error(const expr::node_ptr& node) {
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_UNSUPPORTED_SERIES,
+        .location = node->location,
+        .description = "Series are only supported by the tree evaluators."
+    };
+}
+
+static expr::error make_invalid_bound_error(
+    const expr::node_ptr& node,
+    const expr::node_ptr& bound
+) {
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_INVALID_SERIES,
+        .location = bound->location,
+        .description = {
+            "The bounds of '{0}()' have to be scalar integers.",
+            node->content
+        }
+    };
+}
+
+expr::series_range_result expr::evaluate_series_range(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions
+) {
+    const auto& index = node->children[0];
+    if (index->type != expr::node_t::type_t::VARIABLE) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_INVALID_SERIES,
+            .location = index->location,
+            .description = {
+                "The index of '{0}()' has to be a variable.",
+                node->content
+            }
+        };
+    }
+
+    std::array<std::int64_t, 2> bounds{};
+    for (std::size_t i = 0; i < 2; ++i) {
+        const auto& bound = node->children[i + 1];
+        const auto value = expr::evaluate(bound, symbols, functions);
+        if (!value) {
+            return expr::error{
+                .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+                .location = node->location,
+                .description = {
+                    "Failed to evaluate function arguments for '{0}()'.",
+                    node->content
+                }
+            };
+        }
+        if (!value->unit.is_scalar())
+            return make_invalid_bound_error(node, bound);
+        const auto integer = expr::exact_integer(value->value);
+        if (!integer)
+            return make_invalid_bound_error(node, bound);
+        bounds[i] = *integer;
+    }
+
+    if (bounds[1] - bounds[0] >= expr::series_max_length) {
+        return expr::error{
+            .code = expr::error_code::EVALUATOR_INVALID_SERIES,
+            .location = node->location,
+            .description = {
+                "The range of '{0}()' has more than {1} indices.",
+                node->content,
+                std::size_t(expr::series_max_length)
+            }
+        };
+    }
+    return expr::series_range{.first = bounds[0], .last = bounds[1]};
+}
+
+// Shared by every series evaluated in parallel, and only started by the first
+// one.
+static expr::thread_pool& series_pool() {
+    static expr::thread_pool pool;
+    return pool;
+}
+
+// Every series hoisting values gets names of its own for them, as the body of
+// a nested series refers to the values hoisted by the outer ones as well.
+static std::string make_hoisting_prefix() {
+    static std::atomic<std::size_t> next_series = 0;
+    const auto series = next_series.fetch_add(1, std::memory_order_relaxed);
+    return "#" + std::to_string(series) + ".";
+}
+
+class series_evaluator_impl final {
+public:
+    series_evaluator_impl(
+        const expr::node_ptr& node,
+        expr::symbol_table& symbols,
+        const expr::function_table& functions
+    );
+
+    expr::evaluator_result evaluate();
+
+private:
+    using partial_result = std::optional<expr::evaluator_result>;
+
+private:
+    bool hoist(expr::node_ptr& node, std::vector<std::string>& varying);
+    void hoist_child(expr::node_ptr& child);
+    expr::evaluator_result accumulate(
+        const expr::quantity& partial,
+        const expr::quantity& term
+    ) const;
+    expr::evaluator_result combine(
+        const partial_result& result,
+        expr::evaluator_result&& partial
+    ) const;
+    expr::evaluator_result evaluate_compiled(const expr::compiled_expression& body);
+    expr::evaluator_result evaluate_tree(const expr::node_ptr& body) const;
+
+    template <typename Term>
+    expr::evaluator_result evaluate_chunk(std::size_t chunk, Term&& term) const;
+    expr::error make_term_failure() const;
+
+private:
+    const expr::node_ptr& _node;
+    expr::symbol_table& _symbols;
+    const expr::function_table& _functions;
+    const bool _is_product;
+    std::string _index;
+    std::int64_t _first;
+    std::int64_t _count;
+    std::string _prefix;
+    std::vector<expr::quantity> _hoisted;
+};
+
+series_evaluator_impl::series_evaluator_impl(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions
+)
+    : _node(node)
+    , _symbols(symbols)
+    , _functions(functions)
+    , _is_product(node->content == "prod")
+    , _index()
+    , _first(0)
+    , _count(0)
+    , _prefix()
+    , _hoisted()
+{
+}
+
+expr::evaluator_result series_evaluator_impl::evaluate() {
+    const auto range = expr::evaluate_series_range(_node, _symbols, _functions);
+    if (!range)
+        return range.error();
+    if (range->last < range->first)
+        return expr::make_scalar(_is_product ? 1 : 0);
+
+    _index = _node->children[0]->content;
+    _first = range->first;
+    _count = range->last - range->first + 1;
+
+    auto body = expr::inline_functions(_node->children[3], _functions, SIZE_MAX);
+    std::vector<std::string> varying{_index};
+    if (hoist(body, varying))
+        hoist_child(body);
+
+    // Bodies the interpreter can't evaluate, like those with nested series,
+    // are evaluated by the tree evaluator instead.
+    const auto compiled = expr::compile(body, _functions);
+    if (compiled)
+        return evaluate_compiled(*compiled);
+    return evaluate_tree(body);
+}
+
+// Tells whether the subtree does not depend on the varying variables, which
+// are the index and the indices of the series nested in the body. The largest
+// subtrees that do not are evaluated once, and replaced by a variable bound to
+// their value.
+bool series_evaluator_impl::hoist(
+    expr::node_ptr& node,
+    std::vector<std::string>& varying
+) {
+    using type_t = expr::node_t::type_t;
+
+    bool invariant = true;
+    switch (node->type) {
+        case type_t::VARIABLE:
+            invariant = std::find(varying.begin(), varying.end(), node->content)
+                     == varying.end();
+            break;
+        case type_t::FUNCTION_CALL:
+            if (auto where = _functions.find(node->content); where != _functions.end())
+                invariant = where->second.is_pure;
+            break;
+        case type_t::ASSIGNMENT:
+        case type_t::FUNCTION_DEFINITION:
+            invariant = false;
+            break;
+        default:
+            break;
+    }
+
+    const bool is_nested = expr::is_series(*node) && !_functions.contains(node->content);
+    std::vector<bool> invariant_children(node->children.size());
+    for (std::size_t i = 0; i < node->children.size(); ++i) {
+        // The index of a nested series varies in its body only.
+        const bool is_body = is_nested && i == 3;
+        if (is_body)
+            varying.push_back(node->children[0]->content);
+        invariant_children[i] = hoist(node->children[i], varying);
+        if (is_body)
+            varying.pop_back();
+        invariant = invariant && invariant_children[i];
+    }
+
+    if (invariant)
+        return true;
+
+    for (std::size_t i = 0; i < node->children.size(); ++i) {
+        if (invariant_children[i] && !(is_nested && i == 0))
+            hoist_child(node->children[i]);
+    }
+    return false;
+}
+
+// Leaves are as cheap to evaluate as the variable they would be replaced by,
+// and subtrees that fail are kept, so the terms report the failure.
+void series_evaluator_impl::hoist_child(expr::node_ptr& child) {
+    using type_t = expr::node_t::type_t;
+    if (child->type == type_t::NUMBER || child->type == type_t::VARIABLE
+        || child->type == type_t::UNIT)
+        return;
+
+    const auto value = expr::evaluate(child, _symbols, _functions);
+    if (!value)
+        return;
+
+    // Names of hoisted values can't be written in expressions, so they never
+    // hide a variable.
+    if (_prefix.empty())
+        _prefix = make_hoisting_prefix();
+    auto name = _prefix + std::to_string(_hoisted.size());
+    _hoisted.push_back(*value);
+    child = expr::make_variable_node(std::move(name), child->location);
+}
+
+expr::evaluator_result series_evaluator_impl::accumulate(
+    const expr::quantity& partial,
+    const expr::quantity& term
+) const {
+    auto result = _is_product ? expr::multiply(partial, term)
+                              : expr::add(partial, term);
+    if (!result) {
+        // HACK: The quantity class dictates the error, but the evaluator has
+        //       source location.
+        auto& error = result.error();
+        error.code = expr::operator_error_code(error.code);
+        error.location = _node->children[3]->location;
+    }
+    return result;
+}
+
+// Chunks are combined in the order of their indices as they are done,
+// whichever thread evaluated them, so only the result so far is kept.
+expr::evaluator_result series_evaluator_impl::combine(
+    const partial_result& result,
+    expr::evaluator_result&& partial
+) const {
+    if (!result || !partial)
+        return std::move(partial);
+    return accumulate(**result, *partial);
+}
+
+expr::evaluator_result series_evaluator_impl::evaluate_compiled(
+    const expr::compiled_expression& body
+) {
+    auto context = expr::make_context(body);
+    for (std::size_t i = 0; i < body.variables.size(); ++i) {
+        const auto& name = body.variables[i];
+        if (!_prefix.empty() && name.starts_with(_prefix)) {
+            const auto hoisted = std::stoul(name.substr(_prefix.length()));
+            expr::bind(context, i, _hoisted[hoisted]);
+        } else if (name != _index) {
+            if (auto value = expr::find_variable(name, _symbols))
+                expr::bind(context, i, *value);
+        }
+    }
+
+    const auto slot = expr::find_slot(body, _index);
+    auto evaluate_chunk_in = [&](expr::evaluation_context& context, std::size_t chunk) {
+        return evaluate_chunk(chunk, [&](std::int64_t index) {
+            if (slot)
+                expr::bind(context, *slot, expr::make_scalar(double(index)));
+            return expr::evaluate(body, context);
+        });
+    };
+
+    const auto chunks = (std::size_t(_count) + expr::series_chunk_size - 1)
+                      / expr::series_chunk_size;
+    auto result = partial_result();
+
+    const bool is_pure = std::all_of(body.calls.begin(), body.calls.end(),
+        [](const expr::call_site_t& call) { return call.definition->is_pure; });
+    auto& pool = series_pool();
+    if (!is_pure || std::size_t(_count) < expr::series_parallel_threshold
+        || pool.size() < 2) {
+        for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+            result = combine(result, evaluate_chunk_in(context, chunk));
+            if (!*result)
+                break;
+        }
+        return std::move(*result);
+    }
+
+    // One context for every worker, and one for the calling thread, which
+    // executes tasks while it waits for the rest.
+    std::vector<expr::evaluation_context> contexts(pool.size() + 1, context);
+    auto context_of_current_thread = [&]() -> expr::evaluation_context& {
+        const auto worker = pool.current_worker();
+        return contexts[worker == expr::thread_pool::no_worker ? pool.size()
+                                                               : worker];
+    };
+
+    // Chunks are evaluated a window of a few chunks per thread at a time, so
+    // only the partial results of a window are kept. Tasks claim the chunks
+    // of the window in order, and after a chunk fails, the chunks not yet
+    // claimed are skipped: they all come after it.
+    const auto window = std::min(chunks, 4 * contexts.size());
+    std::vector<partial_result> partials(window);
+    for (std::size_t first = 0; first < chunks; first += window) {
+        const auto count = std::min(window, chunks - first);
+        std::atomic<std::size_t> next_chunk = 0;
+        std::atomic<bool> failed = false;
+        auto group = expr::task_group(pool);
+        for (std::size_t i = 0; i < count; ++i) {
+            group.run([&] {
+                if (failed.load(std::memory_order_relaxed))
+                    return;
+                const auto offset = next_chunk.fetch_add(1);
+                auto& partial = partials[offset];
+                partial = evaluate_chunk_in(context_of_current_thread(), first + offset);
+                if (!*partial)
+                    failed.store(true, std::memory_order_relaxed);
+            });
+        }
+        group.wait();
+
+        for (std::size_t i = 0; i < count && partials[i]; ++i) {
+            result = combine(result, std::move(*partials[i]));
+            partials[i].reset();
+            if (!*result)
+                return std::move(*result);
+        }
+    }
+    return std::move(*result);
+}
+
+template <typename Term>
+expr::evaluator_result series_evaluator_impl::evaluate_chunk(
+    std::size_t chunk,
+    Term&& term
+) const {
+    const auto begin = chunk * expr::series_chunk_size;
+    const auto end = std::min(std::size_t(_count), begin + expr::series_chunk_size);
+
+    auto partial = std::optional<expr::quantity>();
+    for (auto i = begin; i < end; ++i) {
+        const auto value = term(_first + std::int64_t(i));
+        if (!value)
+            return make_term_failure();
+        if (!partial) {
+            partial = *value;
+            continue;
+        }
+        auto result = accumulate(*partial, *value);
+        if (!result)
+            return result;
+        partial = *result;
+    }
+    return *partial;
+}
+
+// The body is evaluated with a copy of the symbol table, in which the index
+// and the hoisted values hide the variables of the same name, like the
+// parameters of a user function. The table of the caller is only read, and
+// only resolved variables are added to it, by the tree evaluator given the
+// resolver, so evaluators sharing it between threads may evaluate series in
+// parallel.
+expr::evaluator_result series_evaluator_impl::evaluate_tree(
+    const expr::node_ptr& body
+) const {
+    auto symbols = _symbols;
+    for (std::size_t i = 0; i < _hoisted.size(); ++i)
+        symbols.insert_or_assign(_prefix + std::to_string(i), _hoisted[i]);
+
+    const auto chunks = (std::size_t(_count) + expr::series_chunk_size - 1)
+                      / expr::series_chunk_size;
+    auto result = partial_result();
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+        result = combine(result, evaluate_chunk(chunk, [&](std::int64_t index) {
+            symbols.insert_or_assign(_index, expr::make_scalar(double(index)));
+            return expr::evaluate(body, symbols, _functions);
+        }));
+        if (!*result)
+            break;
+    }
+    return std::move(*result);
+}
+
+expr::error series_evaluator_impl::make_term_failure() const {
+    return expr::error{
+        .code = expr::error_code::EVALUATOR_FAILED_TO_EVALUATE_ARGUMENTS,
+        .location = _node->location,
+        .description = {
+            "Failed to evaluate function arguments for '{0}()'.",
+            _node->content
+        }
+    };
+}
+
+expr::evaluator_result expr::evaluate_series(
+    const expr::node_ptr& node,
+    expr::symbol_table& symbols,
+    const expr::function_table& functions
+) {
+    auto evaluator = series_evaluator_impl(node, symbols, functions);
+    return evaluator.evaluate();
+}
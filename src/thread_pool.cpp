@@ -0,0 +1,151 @@
+#include "thread_pool.h"
+
+#include <algorithm>        // std::max
+
+// The index of the worker of the pool the current thread belongs to.
+static thread_local const expr::thread_pool *current_pool = nullptr;
+static thread_local std::size_t current_index = expr::thread_pool::no_worker;
+
+expr::thread_pool::thread_pool(std::size_t threads) :
+    _queued(0),
+    _next_queue(0),
+    _stopping(false)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (std::size_t i = 0; i < threads; ++i)
+        _queues.push_back(std::make_unique<worker_queue>());
+
+    for (std::size_t i = 0; i < threads; ++i)
+        _threads.emplace_back([this, i] { work(i); });
+}
+
+expr::thread_pool::~thread_pool() {
+    {
+        std::lock_guard lock(_sleep_mutex);
+        _stopping = true;
+    }
+    _wakeup.notify_all();
+
+    for (auto& thread : _threads)
+        thread.join();
+}
+
+std::size_t expr::thread_pool::size() const noexcept {
+    return _threads.size();
+}
+
+std::size_t expr::thread_pool::current_worker() const noexcept {
+    return (current_pool == this) ? current_index : no_worker;
+}
+
+void expr::thread_pool::submit(task_t task) {
+    // Tasks submitted from outside of the pool are spread evenly.
+    auto index = current_worker();
+    if (index == no_worker)
+        index = _next_queue.fetch_add(1) % _queues.size();
+
+    // The task is counted before it is queued, so the counter never drops
+    // below the number of tasks actually in the queues.
+    {
+        std::lock_guard lock(_sleep_mutex);
+        _queued.fetch_add(1);
+    }
+
+    {
+        auto& queue = *_queues[index];
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    _wakeup.notify_one();
+}
+
+bool expr::thread_pool::run_pending_task() {
+    task_t task;
+    const auto index = current_worker();
+    if (index != no_worker && take(index, task)) {
+        task();
+        return true;
+    }
+
+    if (steal(index, task)) {
+        task();
+        return true;
+    }
+
+    return false;
+}
+
+bool expr::thread_pool::take(std::size_t index, task_t& task) {
+    auto& queue = *_queues[index];
+    std::lock_guard lock(queue.mutex);
+    if (queue.tasks.empty())
+        return false;
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    _queued.fetch_sub(1);
+    return true;
+}
+
+bool expr::thread_pool::steal(std::size_t thief, task_t& task) {
+    const auto count = _queues.size();
+    const auto start = (thief == no_worker) ? 0 : thief + 1;
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto victim = (start + i) % count;
+        if (victim == thief)
+            continue;
+
+        auto& queue = *_queues[victim];
+        std::lock_guard lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        _queued.fetch_sub(1);
+        return true;
+    }
+
+    return false;
+}
+
+void expr::thread_pool::work(std::size_t index) {
+    current_pool = this;
+    current_index = index;
+
+    while (true) {
+        if (run_pending_task())
+            continue;
+
+        std::unique_lock lock(_sleep_mutex);
+        _wakeup.wait(lock, [this] { return _stopping || _queued.load() > 0; });
+        if (_stopping && _queued.load() == 0)
+            return;
+    }
+}
+
+expr::task_group::task_group(expr::thread_pool& pool) :
+    _pool(pool),
+    _pending(0)
+{}
+
+expr::task_group::~task_group() {
+    wait();
+}
+
+void expr::task_group::run(expr::thread_pool::task_t task) {
+    _pending.fetch_add(1);
+    _pool.submit([this, task = std::move(task)] {
+        task();
+        _pending.fetch_sub(1);
+    });
+}
+
+void expr::task_group::wait() {
+    while (_pending.load() > 0) {
+        if (!_pool.run_pending_task())
+            std::this_thread::yield();
+    }
+}
@@ -24,10 +24,26 @@ std::ostream& operator<<(std::ostream& stream, expr::token_t::type_t type) {
             return stream << "OpeningParenthesis";
         case expr::token_t::type_t::CLOSING_PARENTHESIS:
             return stream << "ClosingParenthesis";
+        case expr::token_t::type_t::OPENING_BRACKET:
+            return stream << "OpeningBracket";
+        case expr::token_t::type_t::CLOSING_BRACKET:
+            return stream << "ClosingBracket";
         case expr::token_t::type_t::COMMA:
             return stream << "Comma";
         case expr::token_t::type_t::EQUAL_SIGN:
             return stream << "EqualSign";
+        case expr::token_t::type_t::LESS_THAN:
+            return stream << "LessThan";
+        case expr::token_t::type_t::LESS_THAN_OR_EQUAL:
+            return stream << "LessThanOrEqual";
+        case expr::token_t::type_t::GREATER_THAN:
+            return stream << "GreaterThan";
+        case expr::token_t::type_t::GREATER_THAN_OR_EQUAL:
+            return stream << "GreaterThanOrEqual";
+        case expr::token_t::type_t::DOUBLE_EQUAL_SIGN:
+            return stream << "DoubleEqualSign";
+        case expr::token_t::type_t::NOT_EQUAL_SIGN:
+            return stream << "NotEqualSign";
         case expr::token_t::type_t::UNIT:
             return stream << "Unit";
     }
@@ -67,12 +67,24 @@ static std::optional<expr::token_t> extract_single(
         case ')':
             type = expr::token_t::type_t::CLOSING_PARENTHESIS;
             break;
+        case '[':
+            type = expr::token_t::type_t::OPENING_BRACKET;
+            break;
+        case ']':
+            type = expr::token_t::type_t::CLOSING_BRACKET;
+            break;
         case ',':
             type = expr::token_t::type_t::COMMA;
             break;
         case '=':
             type = expr::token_t::type_t::EQUAL_SIGN;
             break;
+        case '<':
+            type = expr::token_t::type_t::LESS_THAN;
+            break;
+        case '>':
+            type = expr::token_t::type_t::GREATER_THAN;
+            break;
         default:
             return std::nullopt;
     }
@@ -80,12 +92,43 @@ static std::optional<expr::token_t> extract_single(
     return expr::token_t{type, std::string{current}, {location, location + 1}};
 }
 
+// Operators of two characters, which are all comparisons ending with an equal
+// sign.
+static std::optional<expr::token_t> extract_double(
+    char current,
+    char next,
+    size_t location
+) {
+    if (next != '=')
+        return std::nullopt;
+
+    expr::token_t::type_t type;
+    switch (current) {
+        case '<':
+            type = expr::token_t::type_t::LESS_THAN_OR_EQUAL;
+            break;
+        case '>':
+            type = expr::token_t::type_t::GREATER_THAN_OR_EQUAL;
+            break;
+        case '=':
+            type = expr::token_t::type_t::DOUBLE_EQUAL_SIGN;
+            break;
+        case '!':
+            type = expr::token_t::type_t::NOT_EQUAL_SIGN;
+            break;
+        default:
+            return std::nullopt;
+    }
+
+    return expr::token_t{type, std::string{current, next}, {location, location + 2}};
+}
+
 static expr::token_t extract_word(
     std::string&& content,
     size_t location
 ) {
     static const std::unordered_set<std::string_view> units = {
-        "mm", "cm", "m", "km", "rad", "deg"
+        "mm", "cm", "m", "km", "rad", "deg", "g", "kg", "ms", "s", "h", "K"
     };
 
     auto type = units.contains(content) ? expr::token_t::type_t::UNIT
@@ -114,7 +157,11 @@ static expr::tokenizer_result tokenize(const char *expression, size_t length) {
         const char current = expression[i];
         switch (state) {
             case state_t::NORMAL: {
-                if (auto token = extract_single(current, i + 1)) {
+                const char next = (i + 1 < length) ? expression[i + 1] : '\0';
+                if (auto token = extract_double(current, next, i + 1)) {
+                    result.push_back(*token);
+                    ++i;
+                } else if (auto token = extract_single(current, i + 1)) {
                     result.push_back(*token);
                 } else if (isalpha(current) || current == '_') {
                     state = state_t::IN_WORD;
@@ -0,0 +1,579 @@
+#include "typecheck.h"
+#include "utility.h"
+
+#include <array>            // std::array
+#include <cmath>            // std::fmod, std::pow
+
+// Units are inferred by running the instructions on their units instead of
+// their values. The values of constant operands are kept along, as the unit of
+// a power depends on the value of its exponent.
+
+struct abstract_value_t {
+    expr::measurement_unit unit;
+    std::optional<double> constant;
+};
+
+static expr::error report(
+    const expr::compiled_expression& expression,
+    std::size_t instruction,
+    expr::error&& error
+) {
+    if (instruction >= expression.root || !expression.failure)
+        return std::move(error);
+    return *expression.failure;
+}
+
+static std::optional<expr::quantity> as_quantity(const abstract_value_t& value) {
+    if (!value.constant)
+        return std::nullopt;
+    return expr::quantity{.unit = value.unit, .value = *value.constant};
+}
+
+template <expr::evaluation_policy Policy>
+class typecheck_impl final {
+public:
+    typecheck_impl(
+        const expr::compiled_expression& expression,
+        const expr::dimension_table& dimensions
+    ) :
+        _expression(expression),
+        _dimensions(dimensions)
+    {}
+
+    expr::typecheck_result check() {
+        using opcode_t = expr::instruction_t::opcode_t;
+
+        auto typed = expr::typed_expression{
+            .instructions = _expression.instructions,
+            .constants = {},
+            .variables = _expression.variables,
+            .units = {},
+            .calls = {},
+            .stack_size = _expression.stack_size,
+            .root = _expression.root,
+            .failure = _expression.failure,
+            .unit = {},
+        };
+
+        typed.constants.reserve(_expression.constants.size());
+        for (const auto& constant : _expression.constants)
+            typed.constants.push_back(constant.value);
+
+        auto is_known = std::vector<bool>(_expression.variables.size());
+        typed.units.resize(_expression.variables.size());
+        for (std::size_t slot = 0; slot < typed.variables.size(); ++slot) {
+            const auto where = _dimensions.find(typed.variables[slot]);
+            if (where != _dimensions.end()) {
+                typed.units[slot] = where->second;
+                is_known[slot] = true;
+            }
+        }
+
+        auto stack = std::vector<abstract_value_t>{};
+        stack.reserve(_expression.stack_size);
+
+        // Both branches of a conditional are checked, one after the other.
+        // The value of the first one is put aside until the second one ends,
+        // and both have to be of the same unit.
+        struct branch_t {
+            std::size_t end;
+            abstract_value_t value;
+            expr::location_t location;
+        };
+        auto branches = std::vector<branch_t>{};
+        auto merge_branches = [&](std::size_t i) -> std::optional<expr::error> {
+            while (!branches.empty() && branches.back().end == i) {
+                const auto then = branches.back();
+                branches.pop_back();
+
+                auto& otherwise = stack.back();
+                if (otherwise.unit != then.value.unit) {
+                    return expr::error{
+                        .code = expr::error_code::QUANTITY_NON_UNIFORM_UNIT,
+                        .location = then.location,
+                        .description = "The branches of a conditional have "
+                                       "different units."
+                    };
+                }
+                if (otherwise.constant != then.value.constant)
+                    otherwise.constant = std::nullopt;
+            }
+            return std::nullopt;
+        };
+
+        const auto& instructions = _expression.instructions;
+        for (std::size_t i = 0; i < instructions.size(); ++i) {
+            if (auto error = merge_branches(i))
+                return std::move(*error);
+
+            const auto& instruction = instructions[i];
+            switch (instruction.opcode) {
+                case opcode_t::CONSTANT: {
+                    const auto& constant = _expression.constants[instruction.operand];
+                    stack.push_back({constant.unit, constant.value});
+                    break;
+                }
+
+                case opcode_t::LOAD:
+                    if (!is_known[instruction.operand]) {
+                        const auto& name = typed.variables[instruction.operand];
+                        return report(_expression, i, expr::error{
+                            .code = expr::error_code::EVALUATOR_UNDEFINED_VARIABLE,
+                            .location = instruction.location,
+                            .description = {"Undefined variable '{0}'.", name}
+                        });
+                    }
+                    stack.push_back({typed.units[instruction.operand], std::nullopt});
+                    break;
+
+                case opcode_t::STORE:
+                    typed.units[instruction.operand] = stack.back().unit;
+                    is_known[instruction.operand] = true;
+                    break;
+
+                case opcode_t::NEGATE:
+                    if (stack.back().constant)
+                        stack.back().constant = -*stack.back().constant;
+                    break;
+
+                case opcode_t::ADD:
+                case opcode_t::SUBTRACT:
+                case opcode_t::MULTIPLY:
+                case opcode_t::DIVIDE:
+                case opcode_t::MODULO:
+                case opcode_t::POWER:
+                case opcode_t::LESS:
+                case opcode_t::LESS_EQUAL:
+                case opcode_t::GREATER:
+                case opcode_t::GREATER_EQUAL:
+                case opcode_t::EQUAL:
+                case opcode_t::NOT_EQUAL: {
+                    const auto rhs = stack.back();
+                    stack.pop_back();
+                    auto unit = check_binary(instruction, i, stack.back(), rhs);
+                    if (!unit)
+                        return std::move(unit.error());
+                    stack.back() = *unit;
+                    break;
+                }
+
+                case opcode_t::APPLY_UNIT: {
+                    const auto& factor = _expression.constants[instruction.operand];
+                    auto& operand = stack.back();
+                    auto applied = expr::multiply(
+                        expr::quantity{
+                            .unit = operand.unit,
+                            .value = operand.constant.value_or(1)
+                        },
+                        factor
+                    );
+                    if (!applied) {
+                        auto& error = applied.error();
+                        error.location = instruction.location;
+                        return report(_expression, i, std::move(error));
+                    }
+                    operand.unit = applied->unit;
+                    if (operand.constant)
+                        operand.constant = applied->value;
+                    break;
+                }
+
+                case opcode_t::CALL: {
+                    const auto& call = _expression.calls[instruction.operand];
+                    auto units = std::vector<expr::measurement_unit>{};
+                    units.reserve(call.arity);
+                    for (std::size_t j = stack.size() - call.arity; j < stack.size(); ++j)
+                        units.push_back(stack[j].unit);
+
+                    auto unit = check_call(instruction, i, *call.definition, units);
+                    if (!unit)
+                        return std::move(unit.error());
+
+                    stack.resize(stack.size() - call.arity);
+                    stack.push_back({*unit, std::nullopt});
+
+                    typed.instructions[i].operand = std::uint32_t(typed.calls.size());
+                    typed.calls.push_back(expr::typed_call_t{
+                        .definition = call.definition,
+                        .arity = call.arity,
+                        .units = std::move(units),
+                    });
+                    break;
+                }
+
+                case opcode_t::JUMP:
+                    branches.push_back(branch_t{
+                        .end = instruction.operand,
+                        .value = stack.back(),
+                        .location = instruction.location
+                    });
+                    stack.pop_back();
+                    break;
+
+                case opcode_t::JUMP_IF_FALSE:
+                    stack.pop_back();
+                    break;
+            }
+        }
+        if (auto error = merge_branches(instructions.size()))
+            return std::move(*error);
+
+        typed.unit = stack.back().unit;
+        return typed;
+    }
+
+private:
+    using abstract_result = expr::result<abstract_value_t, expr::error>;
+    using unit_result = expr::result<expr::measurement_unit, expr::error>;
+
+    abstract_result check_binary(
+        const expr::instruction_t& instruction,
+        std::size_t index,
+        const abstract_value_t& lhs,
+        const abstract_value_t& rhs
+    ) const {
+        using opcode_t = expr::instruction_t::opcode_t;
+
+        static constexpr expr::arithmetic_result (*binary[])(
+            expr::quantity,
+            expr::quantity
+        ) = {
+            expr::add,
+            expr::subtract,
+            expr::multiply,
+            Policy::is_checked ? expr::divide<double> : expr::ieee_divide<double>,
+            expr::modulo,
+            Policy::is_checked ? expr::power<double> : expr::ieee_power<double>,
+            expr::less,
+            expr::less_equal,
+            expr::greater,
+            expr::greater_equal,
+            expr::equal,
+            expr::not_equal,
+        };
+
+        const auto operation = binary[
+            std::size_t(instruction.opcode) - std::size_t(opcode_t::ADD)
+        ];
+
+        // The unit of the result does not depend on the values of the
+        // operands, except for the exponent of a power, so any value that can
+        // not be zero stands in for an unknown one.
+        auto probe = [](const abstract_value_t& value) {
+            return expr::quantity{
+                .unit = value.unit,
+                .value = value.constant.value_or(1)
+            };
+        };
+
+        const auto constant_rhs = as_quantity(rhs);
+        if (instruction.opcode == opcode_t::POWER &&
+            !constant_rhs &&
+            !lhs.unit.is_scalar() &&
+            rhs.unit.is_scalar()) {
+            return expr::error{
+                .code = expr::error_code::TYPECHECKER_NON_CONSTANT_POWER,
+                .location = instruction.location,
+                .description = "The power of a quantity with a unit has to be "
+                               "a constant."
+            };
+        }
+
+        // Division by zero is left to the evaluation, only units are checked.
+        if (instruction.opcode == opcode_t::DIVIDE && constant_rhs &&
+            expr::is_near(constant_rhs->value, 0)) {
+            auto unit = expr::divide(
+                expr::quantity{.unit = lhs.unit, .value = 1},
+                expr::quantity{.unit = rhs.unit, .value = 1}
+            );
+            if (!unit) {
+                auto& error = unit.error();
+                error.code = expr::operator_error_code(error.code);
+                error.location = instruction.location;
+                return report(_expression, index, std::move(error));
+            }
+            return abstract_value_t{unit->unit, std::nullopt};
+        }
+
+        auto result = operation(probe(lhs), probe(rhs));
+        if (!result) {
+            // HACK: The quantity class dictates the error, but the
+            //       evaluator has source location.
+            auto& error = result.error();
+            error.code = expr::operator_error_code(error.code);
+            error.location = instruction.location;
+            return report(_expression, index, std::move(error));
+        }
+
+        if (!lhs.constant || !rhs.constant)
+            return abstract_value_t{result->unit, std::nullopt};
+        return abstract_value_t{result->unit, result->value};
+    }
+
+    unit_result check_call(
+        const expr::instruction_t& instruction,
+        std::size_t index,
+        const expr::function_definition_t& definition,
+        std::span<const expr::measurement_unit> units
+    ) const {
+        // The unit of the result of a function is found by calling it with
+        // arguments of the right units.
+        auto arguments = std::vector<expr::quantity>{};
+        arguments.reserve(units.size());
+        for (const auto& unit : units)
+            arguments.push_back(expr::quantity{.unit = unit, .value = 1});
+
+        auto result = [&]() -> expr::function_result {
+            if (definition.builtin == nullptr)
+                return expr::invoke(definition, arguments, instruction.location);
+
+            auto error = expr::validate_arguments(
+                definition,
+                arguments,
+                instruction.location
+            );
+            if (error)
+                return std::move(*error);
+
+            return definition.builtin(arguments, instruction.location);
+        }();
+
+        if (!result)
+            return report(_expression, index, std::move(result.error()));
+        return result->unit;
+    }
+
+private:
+    const expr::compiled_expression& _expression;
+    const expr::dimension_table& _dimensions;
+};
+
+expr::dimension_table expr::dimensions_of(const expr::symbol_table& symbols) {
+    auto dimensions = expr::dimension_table{};
+    for (const auto& [name, value] : symbols)
+        dimensions.emplace(name, value.unit);
+    return dimensions;
+}
+
+template <expr::evaluation_policy Policy>
+expr::typecheck_result expr::typecheck(
+    const expr::compiled_expression& expression,
+    const expr::dimension_table& dimensions
+) {
+    return typecheck_impl<Policy>(expression, dimensions).check();
+}
+
+template expr::typecheck_result expr::typecheck<expr::checked_policy>(
+    const expr::compiled_expression&,
+    const expr::dimension_table&
+);
+
+template expr::typecheck_result expr::typecheck<expr::ieee_policy>(
+    const expr::compiled_expression&,
+    const expr::dimension_table&
+);
+
+// Most expressions fit into this many stack slots, so evaluating them does not
+// allocate at all.
+static constexpr std::size_t inline_stack_size = 32;
+
+static expr::error report(
+    const expr::typed_expression& expression,
+    std::size_t instruction,
+    expr::error&& error
+) {
+    if (instruction >= expression.root || !expression.failure)
+        return std::move(error);
+    return *expression.failure;
+}
+
+template <expr::evaluation_policy Policy>
+static expr::evaluator_result run(
+    const expr::typed_expression& expression,
+    std::span<double> variables,
+    double *stack
+) {
+    using opcode_t = expr::instruction_t::opcode_t;
+
+    std::size_t top = 0;
+    const auto& instructions = expression.instructions;
+    for (std::size_t i = 0; i < instructions.size(); ++i) {
+        const auto& instruction = instructions[i];
+        switch (instruction.opcode) {
+            case opcode_t::CONSTANT:
+                stack[top++] = expression.constants[instruction.operand];
+                break;
+
+            case opcode_t::LOAD:
+                stack[top++] = variables[instruction.operand];
+                break;
+
+            case opcode_t::STORE:
+                variables[instruction.operand] = stack[top - 1];
+                break;
+
+            case opcode_t::NEGATE:
+                stack[top - 1] = -stack[top - 1];
+                break;
+
+            case opcode_t::ADD:
+                stack[top - 2] += stack[top - 1];
+                --top;
+                break;
+
+            case opcode_t::SUBTRACT:
+                stack[top - 2] -= stack[top - 1];
+                --top;
+                break;
+
+            case opcode_t::MULTIPLY:
+                stack[top - 2] *= stack[top - 1];
+                --top;
+                break;
+
+            case opcode_t::MODULO:
+                stack[top - 2] = std::fmod(stack[top - 2], stack[top - 1]);
+                --top;
+                break;
+
+            case opcode_t::DIVIDE:
+                if constexpr (!Policy::is_checked) {
+                    stack[top - 2] /= stack[top - 1];
+                    --top;
+                    break;
+                }
+                [[fallthrough]];
+
+            case opcode_t::POWER: {
+                if constexpr (!Policy::is_checked) {
+                    stack[top - 2] = std::pow(stack[top - 2], stack[top - 1]);
+                    --top;
+                    break;
+                }
+
+                // Both can still fail because of the values of their operands,
+                // which the quantity class checks.
+                auto operation = instruction.opcode == opcode_t::DIVIDE
+                               ? expr::divide<double>
+                               : expr::power<double>;
+
+                auto result = operation(
+                    expr::make_scalar(stack[top - 2]),
+                    expr::make_scalar(stack[top - 1])
+                );
+                if (!result) {
+                    // HACK: The quantity class dictates the error, but the
+                    //       evaluator has source location.
+                    auto& error = result.error();
+                    error.code = expr::operator_error_code(error.code);
+                    error.location = instruction.location;
+                    return report(expression, i, std::move(error));
+                }
+                stack[--top - 1] = result->value;
+                break;
+            }
+
+            case opcode_t::LESS:
+                stack[top - 2] = stack[top - 2] < stack[top - 1];
+                --top;
+                break;
+
+            case opcode_t::LESS_EQUAL:
+                stack[top - 2] = stack[top - 2] <= stack[top - 1];
+                --top;
+                break;
+
+            case opcode_t::GREATER:
+                stack[top - 2] = stack[top - 2] > stack[top - 1];
+                --top;
+                break;
+
+            case opcode_t::GREATER_EQUAL:
+                stack[top - 2] = stack[top - 2] >= stack[top - 1];
+                --top;
+                break;
+
+            case opcode_t::EQUAL:
+                stack[top - 2] = stack[top - 2] == stack[top - 1];
+                --top;
+                break;
+
+            case opcode_t::NOT_EQUAL:
+                stack[top - 2] = stack[top - 2] != stack[top - 1];
+                --top;
+                break;
+
+            case opcode_t::APPLY_UNIT:
+                stack[top - 1] *= expression.constants[instruction.operand];
+                break;
+
+            case opcode_t::CALL: {
+                const auto& call = expression.calls[instruction.operand];
+                const auto& definition = *call.definition;
+
+                std::array<expr::quantity, expr::max_builtin_arity> inline_arguments;
+                std::vector<expr::quantity> heap_arguments;
+                auto *arguments = inline_arguments.data();
+                if (call.arity > inline_arguments.size()) {
+                    heap_arguments.resize(call.arity);
+                    arguments = heap_arguments.data();
+                }
+
+                top -= call.arity;
+                for (std::size_t j = 0; j < call.arity; ++j) {
+                    arguments[j] = expr::quantity{
+                        .unit = call.units[j],
+                        .value = stack[top + j]
+                    };
+                }
+
+                const auto span = std::span<const expr::quantity>(arguments, call.arity);
+                auto result = definition.builtin == nullptr
+                            ? expr::invoke(definition, span, instruction.location)
+                            : definition.builtin(span, instruction.location);
+                if (!result)
+                    return report(expression, i, std::move(result.error()));
+
+                stack[top++] = result->value;
+                break;
+            }
+
+            case opcode_t::JUMP:
+                i = instruction.operand - 1;
+                break;
+
+            case opcode_t::JUMP_IF_FALSE:
+                if (stack[--top] == 0)
+                    i = instruction.operand - 1;
+                break;
+        }
+    }
+
+    return expr::quantity{.unit = expression.unit, .value = stack[top - 1]};
+}
+
+template <expr::evaluation_policy Policy>
+expr::evaluator_result expr::evaluate(
+    const expr::typed_expression& expression,
+    std::span<double> variables
+) {
+    std::array<double, inline_stack_size> inline_stack;
+    std::vector<double> heap_stack;
+    auto *stack = inline_stack.data();
+    if (expression.stack_size > inline_stack.size()) {
+        heap_stack.resize(expression.stack_size);
+        stack = heap_stack.data();
+    }
+
+    return run<Policy>(expression, variables, stack);
+}
+
+template expr::evaluator_result expr::evaluate<expr::checked_policy>(
+    const expr::typed_expression&,
+    std::span<double>
+);
+
+template expr::evaluator_result expr::evaluate<expr::ieee_policy>(
+    const expr::typed_expression&,
+    std::span<double>
+);
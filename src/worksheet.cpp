@@ -0,0 +1,362 @@
+#include "worksheet.h"
+#include "array.h"
+#include "series.h"
+
+#include <algorithm>        // std::any_of, std::find, std::reverse
+#include <cmath>            // std::isnan
+#include <unordered_set>    // std::unordered_set
+
+// Formulas calling a user function depend on it as well, through a name no
+// variable can have, so that its redefinition updates them like a change of
+// a variable would. Calls to functions not defined yet count too.
+static std::string function_dependency(const std::string& name) {
+    return name + "()";
+}
+
+static void add_dependency(
+    const std::string& name,
+    std::vector<std::string>& dependencies
+) {
+    if (std::find(dependencies.begin(), dependencies.end(), name) == dependencies.end())
+        dependencies.push_back(name);
+}
+
+// The indices of the series and the parameters of the calls being visited
+// hide the variables of the same name, they are not dependencies. User
+// functions read the other variables of their caller, so the variables of
+// their bodies are dependencies of the formula calling them. The bodies of
+// recursive calls are only visited once.
+static void collect_dependencies(
+    const expr::node_ptr& node,
+    const expr::function_table& functions,
+    std::vector<std::string>& hidden,
+    std::vector<const expr::user_function_t *>& calls,
+    std::vector<std::string>& dependencies
+) {
+    if (node->type == expr::node_t::type_t::VARIABLE) {
+        const auto& name = node->content;
+        if (std::find(hidden.begin(), hidden.end(), name) == hidden.end())
+            add_dependency(name, dependencies);
+    }
+
+    if (node->type == expr::node_t::type_t::FUNCTION_CALL) {
+        const auto where = functions.find(node->content);
+        const auto *function = where != functions.end()
+            ? where->second.user_function.get()
+            : nullptr;
+
+        const bool is_builtin = where != functions.end()
+            ? function == nullptr
+            : expr::is_reduction(node->content);
+        if (!is_builtin)
+            add_dependency(function_dependency(node->content), dependencies);
+
+        const bool is_visited = std::find(calls.begin(), calls.end(), function)
+                             != calls.end();
+        if (function != nullptr && !is_visited) {
+            for (const auto& child : node->children)
+                collect_dependencies(child, functions, hidden, calls, dependencies);
+
+            const auto& parameters = function->parameters;
+            hidden.insert(hidden.end(), parameters.begin(), parameters.end());
+            calls.push_back(function);
+            collect_dependencies(function->body, functions, hidden, calls, dependencies);
+            calls.pop_back();
+            hidden.resize(hidden.size() - parameters.size());
+            return;
+        }
+    }
+
+    if (expr::is_series(*node) && !functions.contains(node->content)) {
+        collect_dependencies(node->children[1], functions, hidden, calls, dependencies);
+        collect_dependencies(node->children[2], functions, hidden, calls, dependencies);
+        hidden.push_back(node->children[0]->content);
+        collect_dependencies(node->children[3], functions, hidden, calls, dependencies);
+        hidden.pop_back();
+        return;
+    }
+
+    for (const auto& child : node->children)
+        collect_dependencies(child, functions, hidden, calls, dependencies);
+}
+
+static bool is_same_value(const expr::quantity& lhs, const expr::quantity& rhs) {
+    if (lhs.unit != rhs.unit)
+        return false;
+    if (std::isnan(lhs.value) && std::isnan(rhs.value))
+        return true;
+    return lhs.value == rhs.value;
+}
+
+expr::worksheet::worksheet(
+    const expr::function_table& functions,
+    expr::symbol_table inputs,
+    expr::variable_resolver resolver
+) :
+    _functions(functions),
+    _resolver(std::move(resolver)),
+    _values(std::move(inputs))
+{}
+
+expr::worksheet_result expr::worksheet::set(
+    const std::string& name,
+    expr::quantity value
+) {
+    unlink(name);
+    _formulas.erase(name);
+
+    auto update = expr::worksheet_update{};
+    if (store(name, value, update))
+        propagate(name, update);
+    return update;
+}
+
+expr::worksheet_result expr::worksheet::define(
+    const std::string& name,
+    expr::node_ptr&& expression
+) {
+    auto dependencies = dependencies_of(expression);
+    if (is_self_referencing(name, dependencies)) {
+        auto value = expr::evaluate(expression, _values, _functions, _resolver);
+        if (!value)
+            return std::move(value.error());
+        return set(name, *value);
+    }
+
+    if (auto error = find_cycle(name, dependencies, expression->location))
+        return std::move(*error);
+
+    unlink(name);
+    link(name, dependencies);
+    auto& formula = _formulas[name];
+    formula = formula_t{
+        .expression = std::move(expression),
+        .dependencies = std::move(dependencies)
+    };
+
+    auto update = expr::worksheet_update{};
+    auto value = expr::evaluate(formula.expression, _values, _functions, _resolver);
+    if (store(name, std::move(value), update))
+        propagate(name, update);
+    return update;
+}
+
+expr::worksheet_result expr::worksheet::assign(expr::node_ptr&& assignment) {
+    if (assignment->type != expr::node_t::type_t::ASSIGNMENT) {
+        return expr::error{
+            .code = expr::error_code::WORKSHEET_NOT_AN_ASSIGNMENT,
+            .location = assignment->location,
+            .description = "Only assignments can be kept as formulas."
+        };
+    }
+
+    const auto name = assignment->children[0]->content;
+    return define(name, std::move(assignment->children[1]));
+}
+
+expr::worksheet_result expr::worksheet::redefine(const std::string& function) {
+    const auto origin = function_dependency(function);
+    auto update = expr::worksheet_update{};
+    const auto where = _dependents.find(origin);
+    if (where == _dependents.end())
+        return update;
+
+    // The new body may read other variables, so the dependencies of the
+    // formulas calling the function are collected again. Formulas which now
+    // refer to their own variable are evaluated once, like when they are
+    // defined, and formulas which would be part of a cycle are dropped.
+    auto dropped = std::vector<std::string>{};
+    const auto callers = where->second;
+    for (const auto& name : callers) {
+        auto& formula = _formulas.at(name);
+        auto dependencies = dependencies_of(formula.expression);
+        if (is_self_referencing(name, dependencies)) {
+            auto value = expr::evaluate(formula.expression, _values, _functions, _resolver);
+            unlink(name);
+            _formulas.erase(name);
+            if (store(name, std::move(value), update))
+                dropped.push_back(name);
+            continue;
+        }
+
+        const auto& location = formula.expression->location;
+        if (auto error = find_cycle(name, dependencies, location)) {
+            unlink(name);
+            _formulas.erase(name);
+            if (store(name, std::move(*error), update))
+                dropped.push_back(name);
+            continue;
+        }
+
+        unlink(name);
+        link(name, dependencies);
+        formula.dependencies = std::move(dependencies);
+    }
+
+    propagate(origin, update);
+    for (const auto& name : dropped)
+        propagate(name, update);
+    return update;
+}
+
+const expr::symbol_table& expr::worksheet::symbols() const noexcept {
+    return _values;
+}
+
+bool expr::worksheet::is_formula(const std::string& name) const {
+    return _formulas.contains(name);
+}
+
+std::vector<std::string> expr::worksheet::dependencies_of(
+    const expr::node_ptr& expression
+) const {
+    auto dependencies = std::vector<std::string>{};
+    auto hidden = std::vector<std::string>{};
+    auto calls = std::vector<const expr::user_function_t *>{};
+    collect_dependencies(expression, _functions, hidden, calls, dependencies);
+    return dependencies;
+}
+
+bool expr::worksheet::is_self_referencing(
+    const std::string& name,
+    const std::vector<std::string>& dependencies
+) const {
+    return std::find(dependencies.begin(), dependencies.end(), name)
+        != dependencies.end();
+}
+
+std::optional<expr::error> expr::worksheet::find_cycle(
+    const std::string& name,
+    const std::vector<std::string>& dependencies,
+    const expr::location_t& location
+) const {
+    for (const auto& dependency : dependencies) {
+        if (depends_on(dependency, name)) {
+            return expr::error{
+                .code = expr::error_code::WORKSHEET_CIRCULAR_DEPENDENCY,
+                .location = location,
+                .description = {
+                    "Variable '{0}' can not depend on '{1}', which depends "
+                    "on '{0}'.",
+                    name,
+                    dependency
+                }
+            };
+        }
+    }
+    return std::nullopt;
+}
+
+void expr::worksheet::link(
+    const std::string& name,
+    const std::vector<std::string>& dependencies
+) {
+    for (const auto& dependency : dependencies)
+        _dependents[dependency].push_back(name);
+}
+
+void expr::worksheet::unlink(const std::string& name) {
+    const auto where = _formulas.find(name);
+    if (where == _formulas.end())
+        return;
+
+    for (const auto& dependency : where->second.dependencies)
+        std::erase(_dependents[dependency], name);
+}
+
+bool expr::worksheet::depends_on(
+    const std::string& name,
+    const std::string& dependency
+) const {
+    auto pending = std::vector<std::string>{name};
+    auto visited = std::unordered_set<std::string>{};
+    while (!pending.empty()) {
+        const auto current = std::move(pending.back());
+        pending.pop_back();
+        if (current == dependency)
+            return true;
+        if (!visited.insert(current).second)
+            continue;
+
+        const auto where = _formulas.find(current);
+        if (where != _formulas.end()) {
+            const auto& dependencies = where->second.dependencies;
+            pending.insert(pending.end(), dependencies.begin(), dependencies.end());
+        }
+    }
+    return false;
+}
+
+bool expr::worksheet::store(
+    const std::string& name,
+    expr::evaluator_result&& value,
+    expr::worksheet_update& update
+) {
+    const auto where = _values.find(name);
+    const bool existed = where != _values.end();
+
+    if (!value) {
+        update.failures.emplace_back(name, std::move(value.error()));
+        if (!existed)
+            return false;
+        _values.erase(where);
+    } else {
+        if (existed && is_same_value(where->second, *value))
+            return false;
+        _values[name] = *value;
+    }
+
+    update.changed.push_back(name);
+    return true;
+}
+
+void expr::worksheet::propagate(
+    const std::string& origin,
+    expr::worksheet_update& update
+) {
+    // The formulas depending on the origin are visited in topological order,
+    // which is the reverse of the depth-first post-order of the dependents.
+    struct frame_t {
+        const std::string *name;
+        std::size_t next;
+    };
+
+    auto order = std::vector<const std::string *>{};
+    auto visited = std::unordered_set<std::string>{origin};
+    auto stack = std::vector<frame_t>{{&origin, 0}};
+    while (!stack.empty()) {
+        auto& frame = stack.back();
+        const auto where = _dependents.find(*frame.name);
+        if (where == _dependents.end() || frame.next == where->second.size()) {
+            order.push_back(frame.name);
+            stack.pop_back();
+            continue;
+        }
+
+        const auto& dependent = where->second[frame.next++];
+        if (visited.insert(dependent).second)
+            stack.push_back(frame_t{&dependent, 0});
+    }
+    order.pop_back();
+    std::reverse(order.begin(), order.end());
+
+    // A formula is only evaluated again if one of its dependencies changed.
+    auto changed = std::unordered_set<std::string>{origin};
+    for (const auto *name : order) {
+        const auto& formula = _formulas.at(*name);
+        const bool is_dirty = std::any_of(
+            formula.dependencies.begin(),
+            formula.dependencies.end(),
+            [&](const std::string& dependency) {
+                return changed.contains(dependency);
+            }
+        );
+
+        if (!is_dirty)
+            continue;
+
+        auto value = expr::evaluate(formula.expression, _values, _functions, _resolver);
+        if (store(*name, std::move(value), update))
+            changed.insert(*name);
+    }
+}
@@ -0,0 +1,111 @@
+// Shares one compiled expression between threads, each evaluating it with its
+// own evaluation context, and checks every result against the one computed
+// by a single thread beforehand. Takes the number of threads (8 by default)
+// and of evaluations per thread (200000 by default), and exits with failure
+// on the first mismatch.
+
+#include "compiler.h"
+#include "context.h"
+#include "functions.h"
+#include "interpreter.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "tokenizer.h"
+
+#include <atomic>           // std::atomic
+#include <cstddef>          // std::size_t
+#include <cstdlib>          // std::strtoul, EXIT_SUCCESS, EXIT_FAILURE
+#include <iostream>         // std::cout, std::cerr
+#include <thread>           // std::thread
+#include <utility>          // std::move
+#include <vector>           // std::vector
+
+// Reads every variable, assigns one, and calls builtins, so threads racing on
+// the slots, the stack or the call sites give different results.
+static constexpr const char *expression =
+    "r = x ^ 2 + sin(y rad) * cos(y rad) - ln(z) + abs(x - y) * round(z)";
+
+static constexpr std::size_t input_count = 4096;
+
+static expr::quantity input(std::size_t index, std::size_t variable) {
+    const auto value = double(index % input_count) / 64.0 + double(variable) + 1.0;
+    return expr::make_scalar(value);
+}
+
+static expr::compiler_result compile(
+    const char *text,
+    const expr::function_table& functions
+) {
+    auto tokens = expr::tokenize(text);
+    if (!tokens)
+        return std::move(tokens.error());
+    auto parsed = expr::parse(std::move(*tokens));
+    if (!parsed)
+        return std::move(parsed.error());
+    auto optimized = expr::optimize(*parsed, functions);
+    if (!optimized)
+        return std::move(optimized.error());
+    return expr::compile(*optimized, functions);
+}
+
+static bool same(const expr::evaluator_result& lhs, const expr::evaluator_result& rhs) {
+    if (lhs.has_value() != rhs.has_value())
+        return false;
+    if (!lhs)
+        return lhs.error().code == rhs.error().code;
+    return lhs->unit == rhs->unit && lhs->value == rhs->value;
+}
+
+int main(int argc, char **argv) {
+    const auto threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+    const auto evaluations = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200000;
+
+    const auto& functions = expr::functions();
+    const auto compiled = compile(expression, functions);
+    if (!compiled) {
+        std::cerr << "Failed to compile: " << compiled.error().description << '\n';
+        return EXIT_FAILURE;
+    }
+
+    const char *names[] = {"x", "y", "z"};
+    auto evaluate = [&](expr::evaluation_context& context, std::size_t index) {
+        for (std::size_t variable = 0; variable < 3; ++variable)
+            expr::bind(context, *compiled, names[variable], input(index, variable));
+        return expr::evaluate(*compiled, context);
+    };
+
+    auto expected = std::vector<expr::evaluator_result>{};
+    expected.reserve(input_count);
+    auto reference = expr::make_context(*compiled);
+    for (std::size_t i = 0; i < input_count; ++i) {
+        expected.push_back(evaluate(reference, i));
+        if (!expected.back()) {
+            std::cerr << "Failed to evaluate: "
+                      << expected.back().error().description << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Threads start at different inputs and walk them at different strides,
+    // so they never evaluate in lockstep.
+    std::atomic<std::size_t> mismatches = 0;
+    auto workers = std::vector<std::thread>{};
+    for (std::size_t thread = 0; thread < threads; ++thread) {
+        workers.emplace_back([&, thread] {
+            auto context = expr::make_context(*compiled);
+            const auto stride = 2 * thread + 1;
+            for (std::size_t i = 0; i < evaluations; ++i) {
+                const auto index = (thread * 977 + i * stride) % input_count;
+                if (!same(evaluate(context, index), expected[index]))
+                    ++mismatches;
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    std::cout << threads << " thread(s), " << evaluations
+              << " evaluation(s) each, " << mismatches.load()
+              << " mismatch(es)\n";
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}